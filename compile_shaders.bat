@@ -4,7 +4,10 @@ echo Compiling shaders...
 REM Create shaders directory if it doesn't exist
 if not exist "shaders" mkdir shaders
 
-REM Compile compute shader
-%VULKAN_SDK%\Bin\glslc.exe shaders/mesh_generator.comp -o shaders/mesh_generator.comp.spv
+REM Compile every shader next to its source, the same set CMake builds
+for %%f in (shaders\*.vert shaders\*.frag shaders\*.comp) do (
+    echo %%f
+    "%VULKAN_SDK%\Bin\glslc.exe" %%f -o %%f.spv || exit /b 1
+)
 
-echo Done. 
\ No newline at end of file
+echo Done.
@@ -1,16 +1,24 @@
 #version 450
 
-// Vertex attributes
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec3 inNormal;
-layout(location = 2) in vec2 inTexCoord;
-layout(location = 3) in float inLodBlend;
-
-// Uniform buffer for camera matrices
-layout(binding = 0) uniform UniformBufferObject {
-    mat4 view;
-    mat4 proj;
-} ubo;
+// Packed vertex attributes (see MeshVertex): position/normal/occlusion word and the voxel
+layout(location = 0) in uvec2 inPacked;
+
+// Camera and node origin per draw, positions are relative to the origin.
+// origin.w scales local units into world voxels, 0 takes the origin from the draw record.
+layout(push_constant) uniform PushConstants {
+    mat4 viewProjection;
+    vec4 origin;
+} pc;
+
+// Draw records of GPU-culled draws, firstInstance is the draw's record
+struct DrawRecord {
+    vec4 bounds;  // xyz node origin, w node size
+    uvec4 draw;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer DrawRecordBuffer {
+    DrawRecord data[];
+} draws;
 
 // Output to fragment shader
 layout(location = 0) out vec3 fragColor;
@@ -18,20 +26,47 @@ layout(location = 1) out vec3 fragNormal;
 layout(location = 2) out vec2 fragTexCoord;
 layout(location = 3) out float fragLodBlend;
 
+const uint VERTEX_POSITION_BITS = 7;
+const uint VERTEX_POSITION_MASK = 0x7F;
+const uint VERTEX_NORMAL_SHIFT = 21;
+const uint VERTEX_OCCLUSION_SHIFT = 24;
+
+// Normals in the order +X, -X, +Y, -Y, +Z, -Z
+const vec3 FACE_NORMALS[6] = vec3[6](
+    vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1)
+);
+
+// Axes the u and v texture coordinates run along per face
+const ivec2 FACE_UV_AXES[6] = ivec2[6](
+    ivec2(2, 1), ivec2(2, 1), ivec2(0, 2), ivec2(0, 2), ivec2(0, 1), ivec2(0, 1)
+);
+
 void main() {
-    // Transform position to clip space
-    gl_Position = ubo.proj * ubo.view * vec4(inPosition, 1.0);
+    // Unpack the brick-local corner and place it relative to the node origin
+    uint word = inPacked.x;
+    vec3 local = vec3(uvec3(word, word >> VERTEX_POSITION_BITS, word >> (2 * VERTEX_POSITION_BITS)) & VERTEX_POSITION_MASK);
+    uint face = min((word >> VERTEX_NORMAL_SHIFT) & 0x7u, 5u);
+    float occlusion = float((word >> VERTEX_OCCLUSION_SHIFT) & 0x3u) / 3.0;
+    vec3 normal = FACE_NORMALS[face];
+
+    vec4 origin = pc.origin.w > 0.0 ? pc.origin : vec4(draws.data[gl_InstanceIndex].bounds.xyz, 1.0);
+    vec3 position = origin.xyz + local * origin.w;
+    gl_Position = pc.viewProjection * vec4(position, 1.0);
+
+    // Voxel color from the high 24 bits, red in the top byte
+    uint voxel = inPacked.y;
+    vec3 voxelColor = vec3((voxel >> 24) & 0xFFu, (voxel >> 16) & 0xFFu, (voxel >> 8) & 0xFFu) / 255.0;
 
     // Basic lighting calculation
     vec3 lightDir = normalize(vec3(1.0, 1.0, 0.0));
-    float diffuse = max(dot(inNormal, lightDir), 0.2); // 0.2 is ambient light
+    float diffuse = max(dot(normal, lightDir), 0.2); // 0.2 is ambient light
     
-    // Simple color based on normal direction
-    vec3 baseColor = vec3(0.7) + inNormal * 0.3;
-    fragColor = baseColor * diffuse;
-
-    // Pass other attributes to fragment shader
-    fragNormal = inNormal;
-    fragTexCoord = inTexCoord;
-    fragLodBlend = inLodBlend;
-}
\ No newline at end of file
+    // Voxel color tinted by normal direction, darkened in occluded corners
+    vec3 baseColor = voxelColor * (vec3(0.7) + normal * 0.3);
+    fragColor = baseColor * diffuse * mix(0.5, 1.0, occlusion);
+
+    // Textures tile once per voxel along the face
+    fragNormal = normal;
+    fragTexCoord = vec2(local[FACE_UV_AXES[face].x], local[FACE_UV_AXES[face].y]);
+    fragLodBlend = 0.0;
+}
@@ -0,0 +1,97 @@
+#version 450
+
+// Vertex pulling for QUADS meshes: no vertex attributes, every group of four vertices is one
+// MeshQuad record. Drawn with the renderer's shared quad index buffer, gl_VertexIndex / 4 picks
+// the record and gl_VertexIndex % 4 the corner.
+layout(std430, set = 1, binding = 0) readonly buffer QuadBuffer {
+    uint data[];
+} quads;
+
+// Camera and node origin per draw, quads are relative to the origin.
+// origin.w scales local units into world voxels, 0 takes the origin from the draw record.
+layout(push_constant) uniform PushConstants {
+    mat4 viewProjection;
+    vec4 origin;
+} pc;
+
+// Draw records of GPU-culled draws as in basic.vert
+struct DrawRecord {
+    vec4 bounds;
+    uvec4 draw;
+};
+
+layout(std430, set = 0, binding = 0) readonly buffer DrawRecordBuffer {
+    DrawRecord data[];
+} draws;
+
+// Output to fragment shader
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec3 fragNormal;
+layout(location = 2) out vec2 fragTexCoord;
+layout(location = 3) out float fragLodBlend;
+
+const uint QUAD_STRIDE = 3;
+const uint QUAD_CELL_BITS = 6;
+const uint QUAD_CELL_MASK = 0x3F;
+const uint QUAD_FACE_SHIFT = 18;
+const uint QUAD_OCCLUSION_SHIFT = 12;
+
+// Face tables in the order +X, -X, +Y, -Y, +Z, -Z, corners match the mesh generators
+const vec3 FACE_NORMALS[6] = vec3[6](
+    vec3(1, 0, 0), vec3(-1, 0, 0), vec3(0, 1, 0), vec3(0, -1, 0), vec3(0, 0, 1), vec3(0, 0, -1)
+);
+
+const vec3 FACE_CORNERS[24] = vec3[24](
+    vec3(1, 0, 0), vec3(1, 1, 0), vec3(1, 1, 1), vec3(1, 0, 1),
+    vec3(0, 0, 0), vec3(0, 0, 1), vec3(0, 1, 1), vec3(0, 1, 0),
+    vec3(0, 1, 0), vec3(0, 1, 1), vec3(1, 1, 1), vec3(1, 1, 0),
+    vec3(0, 0, 0), vec3(1, 0, 0), vec3(1, 0, 1), vec3(0, 0, 1),
+    vec3(0, 0, 1), vec3(1, 0, 1), vec3(1, 1, 1), vec3(0, 1, 1),
+    vec3(0, 0, 0), vec3(0, 1, 0), vec3(1, 1, 0), vec3(1, 0, 0)
+);
+
+// Axes the u and v texture coordinates run along per face
+const ivec2 FACE_UV_AXES[6] = ivec2[6](
+    ivec2(2, 1), ivec2(2, 1), ivec2(0, 2), ivec2(0, 2), ivec2(0, 1), ivec2(0, 1)
+);
+
+void main() {
+    uint offset = (uint(gl_VertexIndex) >> 2) * QUAD_STRIDE;
+    uint cellWord = quads.data[offset + 0];
+    uint shapeWord = quads.data[offset + 1];
+    uint voxel = quads.data[offset + 2];
+
+    uint face = min((cellWord >> QUAD_FACE_SHIFT) & 0x7u, 5u);
+    vec3 cell = vec3(uvec3(cellWord, cellWord >> QUAD_CELL_BITS, cellWord >> (2 * QUAD_CELL_BITS)) & QUAD_CELL_MASK);
+    int axis = int(face) / 2;
+    vec3 extent = vec3(1.0);
+    extent[(axis + 1) % 3] = float((shapeWord & QUAD_CELL_MASK) + 1);
+    extent[(axis + 2) % 3] = float(((shapeWord >> QUAD_CELL_BITS) & QUAD_CELL_MASK) + 1);
+
+    // The index buffer splits every quad along corners 0-2. Rotating the corners by one
+    // splits along the brighter diagonal instead, as the indexed meshes do.
+    uint corners = shapeWord >> QUAD_OCCLUSION_SHIFT;
+    uint occlusion0 = corners & 0x3u;
+    uint occlusion1 = (corners >> 2) & 0x3u;
+    uint occlusion2 = (corners >> 4) & 0x3u;
+    uint occlusion3 = (corners >> 6) & 0x3u;
+    uint first = occlusion0 + occlusion2 < occlusion1 + occlusion3 ? 1u : 0u;
+    uint corner = (uint(gl_VertexIndex) + first) & 3u;
+    float occlusion = float((corners >> (2 * corner)) & 0x3u) / 3.0;
+
+    vec3 local = cell + FACE_CORNERS[face * 4 + corner] * extent;
+    vec3 normal = FACE_NORMALS[face];
+    vec4 origin = pc.origin.w > 0.0 ? pc.origin : vec4(draws.data[gl_InstanceIndex].bounds.xyz, 1.0);
+    gl_Position = pc.viewProjection * vec4(origin.xyz + local * origin.w, 1.0);
+
+    // Shading matches basic.vert
+    vec3 voxelColor = vec3((voxel >> 24) & 0xFFu, (voxel >> 16) & 0xFFu, (voxel >> 8) & 0xFFu) / 255.0;
+    vec3 lightDir = normalize(vec3(1.0, 1.0, 0.0));
+    float diffuse = max(dot(normal, lightDir), 0.2); // 0.2 is ambient light
+    vec3 baseColor = voxelColor * (vec3(0.7) + normal * 0.3);
+    fragColor = baseColor * diffuse * mix(0.5, 1.0, occlusion);
+
+    fragNormal = normal;
+    fragTexCoord = vec2(local[FACE_UV_AXES[face].x], local[FACE_UV_AXES[face].y]);
+    fragLodBlend = 0.0;
+}
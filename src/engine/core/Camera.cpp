@@ -173,9 +173,13 @@ glm::mat4 Camera::getProjectionMatrix(float aspectRatio) const {
     return glm::perspective(glm::radians(settings.fov), aspectRatio, settings.nearPlane, settings.farPlane);
 }
 
+glm::mat4 Camera::getViewProjectionMatrix() const {
+    return getProjectionMatrix(window->getAspectRatio()) * getViewMatrix();
+}
+
 Camera::Frustum Camera::getFrustum() const {
     Frustum frustum;
-    glm::mat4 viewProj = getProjectionMatrix(window->getAspectRatio()) * getViewMatrix();
+    glm::mat4 viewProj = getViewProjectionMatrix();
 
     // Extract frustum planes from view-projection matrix
     // Left plane
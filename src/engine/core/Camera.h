@@ -69,6 +69,7 @@ public:
     // Matrices
     glm::mat4 getViewMatrix() const;
     glm::mat4 getProjectionMatrix(float aspectRatio) const;
+    glm::mat4 getViewProjectionMatrix() const;  // Projection at the window's aspect ratio
 
     // Frustum planes for culling
     struct Frustum {
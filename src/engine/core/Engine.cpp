@@ -6,6 +6,7 @@
 #include "../vulkan/core/SwapChain.h"
 #include "../vulkan/pipeline/Pipeline.h"
 #include "../voxel/World.h"
+#include "../voxel/WorldRenderer.h"
 #include <iostream>
 
 namespace voxceleron {
@@ -110,9 +111,15 @@ void Engine::run() {
         // Update world and camera
         camera->update(deltaTime);
         world->update();
-
-        // Record commands
-        world->render(pipeline->getCurrentCommandBuffer());
+        world->prepareFrame(*camera);
+
+        // Culling dispatches go before the render pass, the draws inside it
+        world->recordCulling(pipeline->getCurrentCommandBuffer());
+        pipeline->beginRenderPass(world->usesSecondaryCommandBuffers() ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS
+                                                                       : VK_SUBPASS_CONTENTS_INLINE);
+        const RenderTarget target{pipeline->getRenderPass(), pipeline->getCurrentFramebuffer(),
+                                  swapChain->getExtent(), pipeline->getCurrentFrameIndex()};
+        world->render(pipeline->getCurrentCommandBuffer(), target);
 
         // End frame
         if (!pipeline->endFrame()) {
@@ -0,0 +1,70 @@
+#include "ThreadPool.h"
+#include <algorithm>
+
+namespace voxceleron {
+
+ThreadPool::ThreadPool(uint32_t threadCount) {
+    if (threadCount == 0) {
+        const uint32_t hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = std::max(1u, hardwareThreads > 1 ? hardwareThreads - 1 : 1u);
+    }
+
+    workers.reserve(threadCount);
+    for (uint32_t i = 0; i < threadCount; ++i) {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    // Workers finish everything already queued before they exit
+    for (std::thread& worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::submit(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        jobs.push_back(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void ThreadPool::waitIdle() {
+    std::unique_lock<std::mutex> lock(mutex);
+    jobsDone.wait(lock, [this] { return jobs.empty() && runningJobs == 0; });
+}
+
+size_t ThreadPool::getPendingCount() {
+    std::lock_guard<std::mutex> lock(mutex);
+    return jobs.size() + runningJobs;
+}
+
+void ThreadPool::workerLoop() {
+    std::unique_lock<std::mutex> lock(mutex);
+    for (;;) {
+        jobAvailable.wait(lock, [this] { return stopping || !jobs.empty(); });
+        if (jobs.empty()) return;  // Stopping and drained
+
+        Job job = std::move(jobs.front());
+        jobs.pop_front();
+        runningJobs++;
+
+        lock.unlock();
+        job();
+        lock.lock();
+
+        runningJobs--;
+        if (jobs.empty() && runningJobs == 0) {
+            jobsDone.notify_all();
+        }
+    }
+}
+
+} // namespace voxceleron
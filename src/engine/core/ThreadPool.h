@@ -0,0 +1,44 @@
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace voxceleron {
+
+// Fixed set of worker threads draining a FIFO job queue.
+// Jobs must not throw; the pool only guarantees they all ran once waitIdle() returns.
+class ThreadPool {
+public:
+    using Job = std::function<void()>;
+
+    // threadCount 0 picks one worker per hardware thread, minus one for the main thread
+    explicit ThreadPool(uint32_t threadCount = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    void submit(Job job);
+    void waitIdle();  // Blocks until the queue is empty and no job is running
+
+    uint32_t getThreadCount() const { return static_cast<uint32_t>(workers.size()); }
+    size_t getPendingCount();  // Queued plus running jobs
+
+private:
+    std::vector<std::thread> workers;
+    std::deque<Job> jobs;
+    std::mutex mutex;
+    std::condition_variable jobAvailable;
+    std::condition_variable jobsDone;
+    size_t runningJobs{0};
+    bool stopping{false};
+
+    void workerLoop();
+};
+
+} // namespace voxceleron
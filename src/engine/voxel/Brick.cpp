@@ -0,0 +1,250 @@
+#include "Brick.h"
+#include <algorithm>
+
+namespace voxceleron {
+
+void Brick::reset(const glm::ivec3& brickOrigin, uint32_t sizeLog2, uint32_t fillValue) {
+    origin = brickOrigin;
+    voxelCount = 1u << (3 * sizeLog2);
+    bitsPerIndex = 1;
+    solidCount = (fillValue & 0xFF) != 0 ? voxelCount : 0;
+
+    // Every voxel points at entry 0
+    palette.assign(1, fillValue);
+    paletteRefs.assign(1, voxelCount);
+    liveEntries = 1;
+    indices.assign((voxelCount * bitsPerIndex + 63) / 64, 0);
+}
+
+bool Brick::set(uint32_t index, uint32_t value) {
+    const uint32_t oldEntry = readIndex(index);
+    const uint32_t oldValue = palette[oldEntry];
+    if (oldValue == value) return false;
+
+    const bool wasSolid = (oldValue & 0xFF) != 0;
+    const bool isSolid = (value & 0xFF) != 0;
+    if (wasSolid != isSolid) {
+        solidCount += isSolid ? 1 : -1;
+    }
+
+    // Add the new reference before dropping the old one so the entry we overwrite
+    // is never reused for the value being written
+    const uint32_t newEntry = findOrAddEntry(value);
+    writeIndex(index, newEntry);
+    if (paletteRefs[newEntry]++ == 0) liveEntries++;
+    if (--paletteRefs[oldEntry] == 0) liveEntries--;
+
+    shrinkIfSparse();
+    return true;
+}
+
+bool Brick::fillRun(uint32_t first, uint32_t count, uint32_t value) {
+    // One palette lookup for the whole run, then only index rewrites
+    const uint32_t entry = findOrAddEntry(value);
+    uint32_t written = 0;
+    uint32_t solidRemoved = 0;
+    for (uint32_t i = first; i < first + count; ++i) {
+        const uint32_t oldEntry = readIndex(i);
+        if (oldEntry == entry) continue;
+
+        if (--paletteRefs[oldEntry] == 0) liveEntries--;
+        solidRemoved += (palette[oldEntry] & 0xFF) != 0 ? 1 : 0;
+        writeIndex(i, entry);
+        written++;
+    }
+    if (written == 0) return false;
+
+    if (paletteRefs[entry] == 0) liveEntries++;
+    paletteRefs[entry] += written;
+    solidCount = solidCount - solidRemoved + ((value & 0xFF) != 0 ? written : 0);
+
+    shrinkIfSparse();
+    return true;
+}
+
+void Brick::decode(uint32_t* out) const {
+    if (liveEntries == 1) {
+        std::fill(out, out + voxelCount, palette[readIndex(0)]);
+        return;
+    }
+
+    // Walk whole words so each one is loaded once
+    const uint32_t perWord = 64 / bitsPerIndex;
+    const uint32_t mask = indexMask();
+    uint32_t i = 0;
+    for (uint64_t word : indices) {
+        const uint32_t end = std::min(i + perWord, voxelCount);
+        for (; i < end; ++i) {
+            out[i] = palette[static_cast<uint32_t>(word) & mask];
+            word >>= bitsPerIndex;
+        }
+    }
+}
+
+void Brick::encode(const uint32_t* voxels) {
+    palette.clear();
+    paletteRefs.clear();
+    solidCount = 0;
+
+    // First pass builds the palette, runs of equal voxels skip the search
+    std::vector<uint32_t> entries(voxelCount);
+    uint32_t lastValue = 0;
+    uint32_t lastEntry = UINT32_MAX;
+    for (uint32_t i = 0; i < voxelCount; ++i) {
+        const uint32_t value = voxels[i];
+        if (lastEntry == UINT32_MAX || value != lastValue) {
+            lastEntry = static_cast<uint32_t>(std::find(palette.begin(), palette.end(), value) - palette.begin());
+            if (lastEntry == palette.size()) {
+                palette.push_back(value);
+                paletteRefs.push_back(0);
+            }
+            lastValue = value;
+        }
+        entries[i] = lastEntry;
+        paletteRefs[lastEntry]++;
+        solidCount += (value & 0xFF) != 0 ? 1 : 0;
+    }
+    liveEntries = static_cast<uint32_t>(palette.size());
+
+    bitsPerIndex = 1;
+    while ((uint64_t(1) << bitsPerIndex) < palette.size()) {
+        bitsPerIndex *= 2;
+    }
+
+    indices.assign((uint64_t(voxelCount) * bitsPerIndex + 63) / 64, 0);
+    for (uint32_t i = 0; i < voxelCount; ++i) {
+        const uint64_t bit = uint64_t(i) * bitsPerIndex;
+        indices[bit >> 6] |= uint64_t(entries[i]) << (bit & 63);
+    }
+}
+
+bool Brick::isUniform(uint32_t& value) const {
+    if (liveEntries != 1) return false;
+    value = palette[readIndex(0)];
+    return true;
+}
+
+size_t Brick::getMemoryUsage() const {
+    return sizeof(Brick) +
+           palette.capacity() * sizeof(uint32_t) +
+           paletteRefs.capacity() * sizeof(uint32_t) +
+           indices.capacity() * sizeof(uint64_t);
+}
+
+void Brick::writeIndex(uint32_t index, uint32_t entry) {
+    const uint32_t bit = index * bitsPerIndex;
+    uint64_t& word = indices[bit >> 6];
+    const uint32_t shift = bit & 63;
+    word = (word & ~(uint64_t(indexMask()) << shift)) | (uint64_t(entry) << shift);
+}
+
+uint32_t Brick::findOrAddEntry(uint32_t value) {
+    // Palettes are small for typical terrain, a linear scan beats hashing here
+    uint32_t freeEntry = UINT32_MAX;
+    for (uint32_t i = 0; i < palette.size(); ++i) {
+        if (palette[i] == value) return i;
+        if (freeEntry == UINT32_MAX && paletteRefs[i] == 0) freeEntry = i;
+    }
+
+    if (freeEntry != UINT32_MAX) {
+        palette[freeEntry] = value;
+        return freeEntry;
+    }
+
+    if (palette.size() > indexMask()) {
+        repack(bitsPerIndex * 2);
+    }
+    palette.push_back(value);
+    paletteRefs.push_back(0);
+    return static_cast<uint32_t>(palette.size() - 1);
+}
+
+void Brick::shrinkIfSparse() {
+    // Shrink once the live entries fit in half of a narrower index width,
+    // the slack avoids repacking back and forth on alternating edits
+    uint32_t newBits = bitsPerIndex;
+    while (newBits > 1 && liveEntries <= ((1u << (newBits / 2)) >> 1)) {
+        newBits /= 2;
+    }
+    if (newBits != bitsPerIndex) {
+        repack(newBits);
+    }
+}
+
+void Brick::repack(uint32_t newBits) {
+    // Drop unused entries and remap the survivors to the front of the palette
+    std::vector<uint32_t> remap(palette.size(), 0);
+    std::vector<uint32_t> newPalette;
+    std::vector<uint32_t> newRefs;
+    newPalette.reserve(liveEntries);
+    newRefs.reserve(liveEntries);
+    for (uint32_t i = 0; i < palette.size(); ++i) {
+        if (paletteRefs[i] == 0) continue;
+        remap[i] = static_cast<uint32_t>(newPalette.size());
+        newPalette.push_back(palette[i]);
+        newRefs.push_back(paletteRefs[i]);
+    }
+
+    std::vector<uint64_t> newIndices((uint64_t(voxelCount) * newBits + 63) / 64, 0);
+    for (uint32_t i = 0; i < voxelCount; ++i) {
+        const uint64_t bit = uint64_t(i) * newBits;
+        newIndices[bit >> 6] |= uint64_t(remap[readIndex(i)]) << (bit & 63);
+    }
+
+    palette.swap(newPalette);
+    paletteRefs.swap(newRefs);
+    indices.swap(newIndices);
+    bitsPerIndex = newBits;
+}
+
+BrickPool::BrickPool(uint32_t sizeLog2)
+    : sizeLog2(sizeLog2) {
+}
+
+BrickPool::~BrickPool() {
+    clear();
+}
+
+uint32_t BrickPool::allocate(const glm::ivec3& origin, uint32_t fillValue) {
+    Brick* brick = storage.create();
+    brick->reset(origin, sizeLog2, fillValue);
+
+    uint32_t id;
+    if (!freeIds.empty()) {
+        id = freeIds.back();
+        freeIds.pop_back();
+        bricks[id] = brick;
+    } else {
+        id = static_cast<uint32_t>(bricks.size());
+        bricks.push_back(brick);
+    }
+    return id;
+}
+
+void BrickPool::release(uint32_t id) {
+    storage.destroy(bricks[id]);
+    bricks[id] = nullptr;
+    freeIds.push_back(id);
+}
+
+void BrickPool::clear() {
+    for (Brick* brick : bricks) {
+        storage.destroy(brick);
+    }
+    bricks.clear();
+    freeIds.clear();
+}
+
+size_t BrickPool::getMemoryUsage() const {
+    size_t total = storage.getMemoryUsage() +
+                   bricks.capacity() * sizeof(Brick*) +
+                   freeIds.capacity() * sizeof(uint32_t);
+    for (const Brick* brick : bricks) {
+        if (brick) {
+            total += brick->getMemoryUsage() - sizeof(Brick);  // Object itself is counted by storage
+        }
+    }
+    return total;
+}
+
+} // namespace voxceleron
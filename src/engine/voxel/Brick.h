@@ -0,0 +1,125 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+#include <glm/glm.hpp>
+#include "MemoryPool.h"
+
+namespace voxceleron {
+
+// Default brick edge length as a power of two (32^3 voxels)
+static constexpr uint32_t DEFAULT_BRICK_SIZE_LOG2 = 5;
+
+// Cube of voxels referenced by an octree leaf at brick level.
+//
+// Voxels are palette compressed: each brick keeps the unique packed voxels it holds in a
+// palette, and stores per-voxel palette indices bit-packed into 64-bit words. Index width
+// is 1, 2, 4, 8 or 16 bits, so an index never straddles two words. The width grows when
+// the palette runs out of slots and shrinks again once enough entries are unused.
+// Bricks larger than 32^3 can exceed 16-bit palettes and fall back to 32-bit indices.
+class Brick {
+public:
+    Brick() = default;
+    ~Brick() = default;
+
+    // Reinitialize as a brick filled with a single value
+    void reset(const glm::ivec3& origin, uint32_t sizeLog2, uint32_t fillValue);
+
+    // Voxel access, index is x + y * n + z * n * n
+    uint32_t get(uint32_t index) const { return palette[readIndex(index)]; }
+    bool set(uint32_t index, uint32_t value);  // Returns true if the voxel changed
+    bool fillRun(uint32_t first, uint32_t count, uint32_t value);  // Consecutive indices, true if any changed
+
+    // Expand every voxel into out (voxelCount entries) in index order
+    void decode(uint32_t* out) const;
+
+    // Rebuild palette and indices from voxelCount voxels in index order.
+    // Cheaper than set() per voxel when most of the brick changes at once.
+    void encode(const uint32_t* voxels);
+
+    // Returns true and the shared value if every voxel in the brick is identical
+    bool isUniform(uint32_t& value) const;
+
+    const glm::ivec3& getOrigin() const { return origin; }
+    uint32_t getSolidCount() const { return solidCount; }
+    uint32_t getBitsPerIndex() const { return bitsPerIndex; }
+    uint32_t getPaletteSize() const { return liveEntries; }
+
+    size_t getMemoryUsage() const;
+
+private:
+    glm::ivec3 origin{0};           // World position of the brick's minimum corner
+    uint32_t voxelCount{0};
+    uint32_t bitsPerIndex{1};
+    uint32_t solidCount{0};         // Number of non-air voxels
+    uint32_t liveEntries{0};        // Palette entries with a non-zero reference count
+
+    std::vector<uint32_t> palette;      // Packed voxels
+    std::vector<uint32_t> paletteRefs;  // Number of voxels using each palette entry
+    std::vector<uint64_t> indices;      // Bit-packed palette indices
+
+    uint32_t indexMask() const { return static_cast<uint32_t>((uint64_t(1) << bitsPerIndex) - 1); }
+    uint32_t readIndex(uint32_t index) const {
+        const uint32_t bit = index * bitsPerIndex;
+        return static_cast<uint32_t>(indices[bit >> 6] >> (bit & 63)) & indexMask();
+    }
+    void writeIndex(uint32_t index, uint32_t entry);
+
+    uint32_t findOrAddEntry(uint32_t value);
+    void shrinkIfSparse();
+    void repack(uint32_t newBits);
+};
+
+// Owns all bricks and hands out stable 32-bit ids the octree stores in leaf payloads.
+// Brick objects come from a MemoryPool so churn during edits never hits the heap for them.
+class BrickPool {
+public:
+    static constexpr size_t BRICKS_PER_BLOCK = 256;
+
+    explicit BrickPool(uint32_t sizeLog2 = DEFAULT_BRICK_SIZE_LOG2);
+    ~BrickPool();
+
+    BrickPool(const BrickPool&) = delete;
+    BrickPool& operator=(const BrickPool&) = delete;
+
+    // Brick dimensions
+    uint32_t getSizeLog2() const { return sizeLog2; }
+    uint32_t getBrickSize() const { return 1u << sizeLog2; }
+    uint32_t getVoxelsPerBrick() const { return 1u << (3 * sizeLog2); }
+
+    // Allocation
+    uint32_t allocate(const glm::ivec3& origin, uint32_t fillValue);
+    void release(uint32_t id);
+    void clear();
+
+    // Access
+    Brick& get(uint32_t id) { return *bricks[id]; }
+    const Brick& get(uint32_t id) const { return *bricks[id]; }
+
+    // Local coordinates must lie in [0, brickSize)
+    uint32_t localIndex(const glm::ivec3& local) const {
+        return static_cast<uint32_t>(local.x) |
+               (static_cast<uint32_t>(local.y) << sizeLog2) |
+               (static_cast<uint32_t>(local.z) << (2 * sizeLog2));
+    }
+    uint32_t getVoxel(uint32_t id, const glm::ivec3& local) const {
+        return bricks[id]->get(localIndex(local));
+    }
+    bool setVoxel(uint32_t id, const glm::ivec3& local, uint32_t value) {
+        return bricks[id]->set(localIndex(local), value);
+    }
+    void decode(uint32_t id, uint32_t* out) const { bricks[id]->decode(out); }
+    bool isUniform(uint32_t id, uint32_t& value) const { return bricks[id]->isUniform(value); }
+
+    // Statistics
+    size_t getBrickCount() const { return bricks.size() - freeIds.size(); }
+    size_t getMemoryUsage() const;
+
+private:
+    uint32_t sizeLog2;
+    MemoryPool<Brick, BRICKS_PER_BLOCK> storage;
+    std::vector<Brick*> bricks;         // Indexed by id, nullptr for released ids
+    std::vector<uint32_t> freeIds;
+};
+
+} // namespace voxceleron
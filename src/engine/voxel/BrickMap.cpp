@@ -0,0 +1,75 @@
+#include "BrickMap.h"
+
+namespace voxceleron {
+
+BrickMap::BrickMap() {
+    clear();
+}
+
+void BrickMap::insert(uint64_t key, uint32_t value) {
+    // Keep the load factor at or below 1/2 so probe chains stay short
+    if ((count + 1) * 2 > slots.size()) {
+        rehash(slots.size() * 2);
+    }
+
+    size_t slot = hash(key) & mask;
+    while (slots[slot].key != EMPTY_KEY) {
+        if (slots[slot].key == key) {
+            slots[slot].value = value;
+            return;
+        }
+        slot = (slot + 1) & mask;
+    }
+    slots[slot] = {key, value};
+    count++;
+}
+
+bool BrickMap::erase(uint64_t key) {
+    size_t slot = hash(key) & mask;
+    while (slots[slot].key != key) {
+        if (slots[slot].key == EMPTY_KEY) return false;
+        slot = (slot + 1) & mask;
+    }
+
+    // Shift later entries of the probe chain back into the hole
+    size_t hole = slot;
+    size_t next = (hole + 1) & mask;
+    while (slots[next].key != EMPTY_KEY) {
+        const size_t home = hash(slots[next].key) & mask;
+        // Move the entry unless its home lies cyclically in (hole, next]
+        const bool inRange = hole <= next ? (hole < home && home <= next)
+                                          : (hole < home || home <= next);
+        if (!inRange) {
+            slots[hole] = slots[next];
+            hole = next;
+        }
+        next = (next + 1) & mask;
+    }
+    slots[hole].key = EMPTY_KEY;
+    count--;
+    return true;
+}
+
+void BrickMap::clear() {
+    slots.assign(INITIAL_CAPACITY, Slot{EMPTY_KEY, 0});
+    slots.shrink_to_fit();
+    mask = INITIAL_CAPACITY - 1;
+    count = 0;
+}
+
+void BrickMap::rehash(size_t capacity) {
+    std::vector<Slot> old(capacity, Slot{EMPTY_KEY, 0});
+    old.swap(slots);
+    mask = capacity - 1;
+
+    for (const Slot& entry : old) {
+        if (entry.key == EMPTY_KEY) continue;
+        size_t slot = hash(entry.key) & mask;
+        while (slots[slot].key != EMPTY_KEY) {
+            slot = (slot + 1) & mask;
+        }
+        slots[slot] = entry;
+    }
+}
+
+} // namespace voxceleron
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace voxceleron {
+
+// Open-addressing hash map from the Morton code of a brick coordinate to the octree
+// node holding that brick. Linear probing with backward-shift deletion, so there are
+// no tombstones and a lookup is usually a single cache line.
+class BrickMap {
+public:
+    static constexpr uint32_t NOT_FOUND = 0xFFFFFFFFu;
+
+    BrickMap();
+    ~BrickMap() = default;
+
+    uint32_t find(uint64_t key) const {
+        size_t slot = hash(key) & mask;
+        while (slots[slot].key != EMPTY_KEY) {
+            if (slots[slot].key == key) return slots[slot].value;
+            slot = (slot + 1) & mask;
+        }
+        return NOT_FOUND;
+    }
+
+    void insert(uint64_t key, uint32_t value);  // Overwrites an existing entry
+    bool erase(uint64_t key);
+    void clear();
+
+    size_t size() const { return count; }
+    size_t getMemoryUsage() const { return slots.capacity() * sizeof(Slot); }
+
+private:
+    // Morton codes only use 63 bits, so the all-ones key never occurs
+    static constexpr uint64_t EMPTY_KEY = ~uint64_t(0);
+    static constexpr size_t INITIAL_CAPACITY = 64;
+
+    struct Slot {
+        uint64_t key;
+        uint32_t value;
+    };
+
+    std::vector<Slot> slots;
+    size_t mask;
+    size_t count{0};
+
+    // Morton codes of neighbouring bricks differ mostly in low bits, mix before masking
+    static size_t hash(uint64_t key) {
+        key ^= key >> 33;
+        key *= 0xFF51AFD7ED558CCDull;
+        key ^= key >> 33;
+        return static_cast<size_t>(key);
+    }
+
+    void rehash(size_t capacity);
+};
+
+} // namespace voxceleron
@@ -0,0 +1,266 @@
+#include "CpuMesher.h"
+#include <algorithm>
+
+namespace voxceleron {
+
+namespace {
+
+// Corner offsets per face, matching mesh_generator.comp so both backends produce identical
+// winding. Order is +X, -X, +Y, -Y, +Z, -Z, the index doubles as the vertex normal index.
+struct FaceDesc {
+    int axis;              // Axis of the normal
+    int dir;               // +1 or -1 along that axis
+    glm::ivec3 corners[4]; // Unit cube corners, scaled by the quad extent
+};
+
+const FaceDesc FACES[6] = {
+    {0,  1, {{1, 0, 0}, {1, 1, 0}, {1, 1, 1}, {1, 0, 1}}},
+    {0, -1, {{0, 0, 0}, {0, 0, 1}, {0, 1, 1}, {0, 1, 0}}},
+    {1,  1, {{0, 1, 0}, {0, 1, 1}, {1, 1, 1}, {1, 1, 0}}},
+    {1, -1, {{0, 0, 0}, {1, 0, 0}, {1, 0, 1}, {0, 0, 1}}},
+    {2,  1, {{0, 0, 1}, {1, 0, 1}, {1, 1, 1}, {0, 1, 1}}},
+    {2, -1, {{0, 0, 0}, {0, 1, 0}, {1, 1, 0}, {1, 0, 0}}},
+};
+
+// Occlusion of a corner from the two edge neighbours and the diagonal one in front of the face
+uint32_t cornerOcclusion(bool side1, bool side2, bool corner) {
+    if (side1 && side2) return 0;
+    return VERTEX_OCCLUSION_NONE - (uint32_t(side1) + uint32_t(side2) + uint32_t(corner));
+}
+
+// Occlusion at the four corners of the unit face of cell, two bits per corner in corner order.
+// solidAt answers for positions one voxel outside the node too, which the padded volume covers.
+template <typename SolidAt>
+uint32_t faceOcclusion(const FaceDesc& face, const glm::ivec3& cell, const SolidAt& solidAt) {
+    const int s = (face.axis + 1) % 3;
+    const int t = (face.axis + 2) % 3;
+    glm::ivec3 front = cell;
+    front[face.axis] += face.dir;
+
+    uint32_t packed = 0;
+    for (int i = 0; i < 4; ++i) {
+        // Directions pointing away from the face at this corner
+        const glm::ivec3& corner = face.corners[i];
+        glm::ivec3 ds(0);
+        glm::ivec3 dt(0);
+        ds[s] = corner[s] ? 1 : -1;
+        dt[t] = corner[t] ? 1 : -1;
+        packed |= cornerOcclusion(solidAt(front + ds), solidAt(front + dt), solidAt(front + ds + dt)) << (2 * i);
+    }
+    return packed;
+}
+
+// True when the occlusion of a face does not change along axis, which lies in the face's
+// plane. A merged quad interpolates its corners across its whole extent, so faces only merge
+// along axes their occlusion is constant on.
+bool isOcclusionConstant(const FaceDesc& face, uint32_t packed, int axis) {
+    const int other = 3 - face.axis - axis;
+    for (int i = 0; i < 4; ++i) {
+        for (int j = i + 1; j < 4; ++j) {
+            if (face.corners[i][other] == face.corners[j][other] &&
+                ((packed >> (2 * i)) & 3u) != ((packed >> (2 * j)) & 3u)) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+// Culls and merges the faces of a volume, calling emit(face, cell, extent, voxel, occlusion)
+// once per quad. Both output formats are built on this.
+template <typename Emit>
+void meshVolume(const MeshVolume& volume, MeshingMode mode, MeshStats* stats, const Emit& emit) {
+    const int n = static_cast<int>(volume.size);
+    const int p = n + 2;
+    const uint32_t* voxels = volume.voxels.data();
+    const auto at = [voxels, p](const glm::ivec3& local) {
+        return voxels[size_t(local.x + 1) + size_t(local.y + 1) * p + size_t(local.z + 1) * p * p];
+    };
+    const auto solidAt = [&at](const glm::ivec3& local) { return (at(local) & 0xFF) != 0; };
+
+    // Visibility comes from the column bitmasks, only visible faces read their voxel
+    thread_local FaceMasks masks;
+    buildFaceMasks(voxels, volume.size, masks);
+
+    // Visible face voxels per slice, 0 where hidden. All zero between faces, the merge
+    // below clears every cell it consumes. The corner occlusion of each visible face is
+    // kept alongside and is part of the merge key.
+    thread_local std::vector<uint32_t> slices;
+    thread_local std::vector<uint8_t> occlusionSlices;
+    const size_t sliceArea = size_t(n) * n;
+    if (slices.size() != sliceArea * n) {
+        slices.assign(sliceArea * n, 0);
+        occlusionSlices.resize(sliceArea * n);
+    }
+
+    for (int f = 0; f < 6; ++f) {
+        const FaceDesc& face = FACES[f];
+
+        // The slice spans the two axes other than the normal
+        const int s = (face.axis + 1) % 3;
+        const int t = (face.axis + 2) % 3;
+
+        // Scatter visible faces into their slices
+        uint64_t usedSlices = 0;
+        uint64_t visibleFaces = 0;
+        const uint64_t* columns = masks.faces[f].data();
+        for (int z = 0; z < n; ++z) {
+            for (int y = 0; y < n; ++y) {
+                for (uint64_t bits = columns[size_t(z) * n + y]; bits != 0; bits &= bits - 1) {
+                    const glm::ivec3 cell(static_cast<int>(countTrailingZeros(bits)), y, z);
+                    const int d = cell[face.axis];
+                    const size_t index = d * sliceArea + size_t(cell[t]) * n + cell[s];
+                    slices[index] = at(cell);
+                    occlusionSlices[index] = static_cast<uint8_t>(faceOcclusion(face, cell, solidAt));
+                    usedSlices |= uint64_t(1) << d;
+                    visibleFaces++;
+                }
+            }
+        }
+
+        if (stats) {
+            stats->visibleFaces += visibleFaces;
+        }
+
+        for (; usedSlices != 0; usedSlices &= usedSlices - 1) {
+            const int d = static_cast<int>(countTrailingZeros(usedSlices));
+            uint32_t* mask = slices.data() + d * sliceArea;
+            const uint8_t* occlusionMask = occlusionSlices.data() + d * sliceArea;
+
+            for (int j = 0; j < n; ++j) {
+                for (int i = 0; i < n;) {
+                    const uint32_t voxel = mask[size_t(j) * n + i];
+                    if (voxel == 0) {
+                        ++i;
+                        continue;
+                    }
+
+                    // Grow along s, then along t while the whole row matches. Only faces of
+                    // equal voxel and occlusion merge, and only along axes the occlusion is
+                    // constant on, so the quad shades exactly like its unit faces.
+                    const uint8_t faceOcclusionBits = occlusionMask[size_t(j) * n + i];
+                    const auto matches = [&](size_t index) {
+                        return mask[index] == voxel && occlusionMask[index] == faceOcclusionBits;
+                    };
+                    int width = 1;
+                    int height = 1;
+                    if (mode == MeshingMode::GREEDY && isOcclusionConstant(face, faceOcclusionBits, s)) {
+                        while (i + width < n && matches(size_t(j) * n + i + width)) {
+                            ++width;
+                        }
+                    }
+                    if (mode == MeshingMode::GREEDY && isOcclusionConstant(face, faceOcclusionBits, t)) {
+                        while (j + height < n) {
+                            const size_t row = size_t(j + height) * n + i;
+                            bool rowMatches = true;
+                            for (int k = 0; k < width && rowMatches; ++k) {
+                                rowMatches = matches(row + k);
+                            }
+                            if (!rowMatches) break;
+                            ++height;
+                        }
+                    }
+                    for (int y = 0; y < height; ++y) {
+                        std::fill_n(mask + size_t(j + y) * n + i, width, 0u);
+                    }
+
+                    glm::ivec3 cell;
+                    cell[face.axis] = d;
+                    cell[s] = i;
+                    cell[t] = j;
+                    glm::ivec3 extent(1);
+                    extent[s] = width;
+                    extent[t] = height;
+                    uint32_t occlusion[4];
+                    for (int k = 0; k < 4; ++k) {
+                        occlusion[k] = (faceOcclusionBits >> (2 * k)) & 3u;
+                    }
+                    emit(static_cast<uint32_t>(f), cell, extent, voxel, occlusion);
+                    if (stats) {
+                        stats->quads++;
+                    }
+                    i += width;
+                }
+            }
+        }
+    }
+}
+
+} // namespace
+
+CpuMesher::CpuMesher(MeshingMode mode, MeshFormat format, uint32_t threadCount)
+    : mode(mode)
+    , format(format)
+    , pool(threadCount) {
+}
+
+void CpuMesher::buildMesh(const MeshVolume& volume, MeshingMode mode,
+                          std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices,
+                          MeshStats* stats) {
+    vertices.clear();
+    indices.clear();
+    if (volume.size == 0 || volume.size > MAX_VOLUME_SIZE) return;
+
+    meshVolume(volume, mode, stats, [&](uint32_t f, const glm::ivec3& cell, const glm::ivec3& extent,
+                                        uint32_t voxel, const uint32_t occlusion[4]) {
+        const uint32_t base = static_cast<uint32_t>(vertices.size());
+        for (int i = 0; i < 4; ++i) {
+            const glm::uvec3 corner(cell + FACES[f].corners[i] * extent);
+            vertices.push_back(MeshVertex::pack(corner, f, occlusion[i], voxel));
+        }
+
+        // Split along the brighter diagonal so occlusion interpolates without a visible seam
+        const uint32_t first = occlusion[0] + occlusion[2] < occlusion[1] + occlusion[3] ? 1 : 0;
+        const uint32_t order[6] = {0, 1, 2, 0, 2, 3};
+        for (uint32_t k : order) {
+            indices.push_back(base + (k + first) % 4);
+        }
+    });
+}
+
+void CpuMesher::buildQuads(const MeshVolume& volume, MeshingMode mode, std::vector<MeshQuad>& quads,
+                           MeshStats* stats) {
+    quads.clear();
+    if (volume.size == 0 || volume.size > MAX_VOLUME_SIZE) return;
+
+    meshVolume(volume, mode, stats, [&](uint32_t f, const glm::ivec3& cell, const glm::ivec3& extent,
+                                        uint32_t voxel, const uint32_t occlusion[4]) {
+        const int s = (FACES[f].axis + 1) % 3;
+        const int t = (FACES[f].axis + 2) % 3;
+        quads.push_back(MeshQuad::pack(glm::uvec3(cell), f, static_cast<uint32_t>(extent[s]),
+                                       static_cast<uint32_t>(extent[t]), occlusion, voxel));
+    });
+}
+
+void CpuMesher::submit(NodeIndex node, uint64_t ticket, MeshVolume volume) {
+    inFlight++;
+    const MeshingMode jobMode = mode;
+    const MeshFormat jobFormat = format;
+    pool.submit([this, node, ticket, jobMode, jobFormat, volume = std::move(volume)]() {
+        CpuMeshResult result;
+        result.node = node;
+        result.ticket = ticket;
+        result.format = jobFormat;
+        if (jobFormat == MeshFormat::QUADS) {
+            buildQuads(volume, jobMode, result.quads, &result.stats);
+        } else {
+            buildMesh(volume, jobMode, result.vertices, result.indices, &result.stats);
+        }
+
+        std::lock_guard<std::mutex> lock(resultMutex);
+        results.push_back(std::move(result));
+        inFlight--;
+    });
+}
+
+size_t CpuMesher::collect(std::vector<CpuMeshResult>& out) {
+    std::lock_guard<std::mutex> lock(resultMutex);
+    const size_t count = results.size();
+    for (CpuMeshResult& result : results) {
+        out.push_back(std::move(result));
+    }
+    results.clear();
+    return count;
+}
+
+} // namespace voxceleron
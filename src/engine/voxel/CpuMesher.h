@@ -0,0 +1,86 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <glm/glm.hpp>
+#include "FlatOctree.h"
+#include "MeshTypes.h"
+#include "FaceCulling.h"
+#include "../core/ThreadPool.h"
+
+namespace voxceleron {
+
+enum class MeshingMode {
+    CULLED,  // One quad per visible voxel face
+    GREEDY   // Coplanar visible faces of equal voxels merged into rectangles
+};
+
+// Voxels of one node plus a one voxel border from its neighbours, as filled by
+// FlatOctree::readVolumeWithBorder. Faces against solid neighbours are culled.
+struct MeshVolume {
+    glm::ivec3 origin{0};         // World position of the node's minimum corner
+    uint32_t size{0};             // Node edge length
+    std::vector<uint32_t> voxels; // (size + 2)^3 packed voxels
+};
+
+// Finished mesh handed back to the main thread
+struct CpuMeshResult {
+    NodeIndex node{INVALID_NODE};
+    uint64_t ticket{0};           // Identifies the submission, stale results are dropped by the owner
+    MeshFormat format{MeshFormat::INDEXED};
+    std::vector<MeshVertex> vertices;  // INDEXED output
+    std::vector<uint32_t> indices;
+    std::vector<MeshQuad> quads;       // QUADS output
+    MeshStats stats;
+};
+
+// Builds meshes on the CPU with the same vertex layout and winding as mesh_generator.comp.
+// buildMesh can be used directly without a device; submit/collect run it on a worker pool
+// so meshing throughput scales with core count and never blocks the frame.
+class CpuMesher {
+public:
+    // Largest node edge one mesh covers
+    static constexpr uint32_t MAX_VOLUME_SIZE = FACE_MASK_MAX_SIZE;
+
+    explicit CpuMesher(MeshingMode mode = MeshingMode::GREEDY, MeshFormat format = MeshFormat::INDEXED,
+                       uint32_t threadCount = 0);
+    ~CpuMesher() = default;  // Pool joins its workers first, queued jobs still run
+
+    CpuMesher(const CpuMesher&) = delete;
+    CpuMesher& operator=(const CpuMesher&) = delete;
+
+    // Mesh a volume synchronously, vertices and indices are cleared first. Vertices are
+    // relative to the volume origin with occlusion sampled at each quad corner.
+    // Volumes larger than MAX_VOLUME_SIZE produce an empty mesh.
+    static void buildMesh(const MeshVolume& volume, MeshingMode mode,
+                          std::vector<MeshVertex>& vertices, std::vector<uint32_t>& indices,
+                          MeshStats* stats = nullptr);
+
+    // Same faces as buildMesh, one record per quad for vertex pulling
+    static void buildQuads(const MeshVolume& volume, MeshingMode mode, std::vector<MeshQuad>& quads,
+                           MeshStats* stats = nullptr);
+
+    // Asynchronous meshing, results are picked up with collect() from the owning thread
+    void submit(NodeIndex node, uint64_t ticket, MeshVolume volume);
+    size_t collect(std::vector<CpuMeshResult>& out);  // Appends finished meshes, returns how many
+    void waitIdle() { pool.waitIdle(); }
+
+    void setMode(MeshingMode value) { mode = value; }  // Applies to later submissions
+    MeshingMode getMode() const { return mode; }
+    void setFormat(MeshFormat value) { format = value; }  // Applies to later submissions
+    MeshFormat getFormat() const { return format; }
+    uint32_t getThreadCount() const { return pool.getThreadCount(); }
+    size_t getInFlightCount() const { return inFlight.load(); }
+
+private:
+    MeshingMode mode;
+    MeshFormat format;
+    std::mutex resultMutex;
+    std::vector<CpuMeshResult> results;
+    std::atomic<size_t> inFlight{0};
+    ThreadPool pool;  // Declared last so workers stop before the members they write go away
+};
+
+} // namespace voxceleron
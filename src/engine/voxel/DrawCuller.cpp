@@ -0,0 +1,462 @@
+#include "DrawCuller.h"
+#include "World.h"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+
+namespace voxceleron {
+
+DrawCuller::DrawCuller(VkDevice device, MemoryAllocator* allocator)
+    : device(device)
+    , allocator(allocator)
+    , cullSetLayout(VK_NULL_HANDLE)
+    , drawSetLayout(VK_NULL_HANDLE)
+    , descriptorPool(VK_NULL_HANDLE)
+    , pipelineLayout(VK_NULL_HANDLE)
+    , pipeline(VK_NULL_HANDLE)
+    , currentFrame(0)
+    , builtGeneration(UINT64_MAX) {
+}
+
+DrawCuller::~DrawCuller() {
+    cleanup();
+}
+
+bool DrawCuller::initialize() {
+    if (!createDescriptors()) {
+        std::cerr << "DrawCuller: Failed to create descriptors" << std::endl;
+        cleanup();
+        return false;
+    }
+
+    VkPushConstantRange pushConstantRange{};
+    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    pushConstantRange.offset = 0;
+    pushConstantRange.size = sizeof(PushConstants);
+
+    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
+    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &cullSetLayout;
+    pipelineLayoutInfo.pushConstantRangeCount = 1;
+    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
+
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        std::cerr << "DrawCuller: Failed to create pipeline layout" << std::endl;
+        cleanup();
+        return false;
+    }
+
+    if (!createPipeline("shaders/cull_draws.comp.spv")) {
+        cleanup();
+        return false;
+    }
+
+    // Every frame has buffers from the start, the draw sets are bound even while unused.
+    // The occlusion pyramid has a fixed size and is never reallocated.
+    for (Frame& frame : frames) {
+        if (!createBuffer(sizeof(OcclusionHeader) + VkDeviceSize(OcclusionBuffer::getPyramidSize()) * sizeof(float),
+                VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                frame.occlusionBuffer, frame.occlusionAllocation) ||
+            !reserveFrame(frame, INITIAL_RECORDS, INITIAL_GROUPS)) {
+            std::cerr << "DrawCuller: Failed to create frame buffers" << std::endl;
+            cleanup();
+            return false;
+        }
+    }
+    return true;
+}
+
+void DrawCuller::cleanup() {
+    if (device == VK_NULL_HANDLE) return;
+
+    // Descriptor sets go away with their pool
+    for (Frame& frame : frames) {
+        destroyFrameBuffers(frame);
+        destroyBuffer(frame.occlusionBuffer, frame.occlusionAllocation);
+        frame = Frame{};
+    }
+    records.clear();
+    groups.clear();
+    builtGeneration = UINT64_MAX;
+
+    if (pipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, pipeline, nullptr);
+        pipeline = VK_NULL_HANDLE;
+    }
+    if (pipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        pipelineLayout = VK_NULL_HANDLE;
+    }
+    if (descriptorPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        descriptorPool = VK_NULL_HANDLE;
+    }
+    if (cullSetLayout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device, cullSetLayout, nullptr);
+        cullSetLayout = VK_NULL_HANDLE;
+    }
+    if (drawSetLayout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device, drawSetLayout, nullptr);
+        drawSetLayout = VK_NULL_HANDLE;
+    }
+}
+
+void DrawCuller::beginFrame() {
+    currentFrame = (currentFrame + 1) % FRAMES_IN_FLIGHT;
+}
+
+bool DrawCuller::recordCulling(VkCommandBuffer commandBuffer, const World& world, const Camera::Frustum& frustum,
+                               float margin, bool frustumTest, const OcclusionBuffer* occlusion) {
+    if (builtGeneration != world.getMeshGeneration()) {
+        buildRecords(world);
+        builtGeneration = world.getMeshGeneration();
+    }
+    if (records.empty()) return false;
+
+    // The frame's buffers are idle, its last frame has finished
+    Frame& frame = frames[currentFrame];
+    if (frame.generation != builtGeneration) {
+        if (!reserveFrame(frame, static_cast<uint32_t>(records.size()), static_cast<uint32_t>(groups.size()))) {
+            std::cerr << "DrawCuller: Failed to grow frame buffers to " << records.size() << " records" << std::endl;
+            frame.generation = UINT64_MAX;
+            return false;
+        }
+        std::memcpy(frame.recordAllocation.mapped, records.data(), records.size() * sizeof(DrawRecord));
+        uint32_t* firstCommands = static_cast<uint32_t*>(frame.groupAllocation.mapped);
+        for (size_t i = 0; i < groups.size(); ++i) {
+            firstCommands[i] = groups[i].firstCommand;
+        }
+        frame.generation = builtGeneration;
+    }
+    writeOcclusion(frame, occlusion);
+
+    // Survivors are appended per group, start every group empty
+    const VkDeviceSize countBytes = groups.size() * sizeof(uint32_t);
+    vkCmdFillBuffer(commandBuffer, frame.countBuffer, 0, countBytes, 0);
+
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+    PushConstants constants{};
+    for (int i = 0; i < 6; ++i) {
+        constants.planes[i] = frustum.planes[i];
+    }
+    constants.recordCount = static_cast<uint32_t>(records.size());
+    constants.margin = margin;
+    constants.frustumTest = frustumTest ? 1u : 0u;
+
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout,
+                            0, 1, &frame.cullSet, 0, nullptr);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &constants);
+    vkCmdDispatch(commandBuffer, (constants.recordCount + GROUP_SIZE - 1) / GROUP_SIZE, 1, 1);
+
+    // The draws read the commands and counts as indirect parameters
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+    return true;
+}
+
+void DrawCuller::writeOcclusion(Frame& frame, const OcclusionBuffer* occlusion) {
+    // Rewritten every frame, the view changes even when the occluders don't
+    OcclusionHeader* header = static_cast<OcclusionHeader*>(frame.occlusionAllocation.mapped);
+    header->enabled = occlusion && occlusion->hasOccluders() ? 1u : 0u;
+    if (!header->enabled) return;
+
+    header->viewProjection = occlusion->getViewProjection();
+    header->width = OcclusionBuffer::WIDTH;
+    header->height = OcclusionBuffer::HEIGHT;
+    header->levelCount = occlusion->getLevelCount();
+    for (uint32_t level = 0; level < OcclusionBuffer::MAX_LEVELS; ++level) {
+        header->levelOffsets[level / 4][level % 4] = level < header->levelCount ? occlusion->getLevelOffset(level) : 0;
+    }
+    const std::vector<float>& depths = occlusion->getDepths();
+    std::memcpy(header + 1, depths.data(), depths.size() * sizeof(float));
+}
+
+void DrawCuller::buildRecords(const World& world) {
+    records.clear();
+    groups.clear();
+
+    const FlatOctree& octree = world.getOctree();
+    const BufferArena& vertexArena = world.getVertexArena();
+    const BufferArena& indexArena = world.getIndexArena();
+    const BufferArena& quadArena = world.getQuadArena();
+
+    // Format, index type and pages packed into one key per group
+    std::unordered_map<uint64_t, uint32_t> groupIndices;
+    auto findGroup = [&](MeshFormat format, uint32_t vertexPage, uint32_t indexPage, VkIndexType indexType) {
+        const uint64_t key = (uint64_t(vertexPage) << 32) | (uint64_t(indexPage) << 2) |
+                             (indexType == VK_INDEX_TYPE_UINT16 ? 2u : 0u) | (format == MeshFormat::QUADS ? 1u : 0u);
+        auto it = groupIndices.find(key);
+        if (it != groupIndices.end()) return it->second;
+
+        const uint32_t group = static_cast<uint32_t>(groups.size());
+        groups.push_back({format, vertexPage, indexPage, indexType, 0, 0});
+        groupIndices.emplace(key, group);
+        return group;
+    };
+
+    for (const auto& entry : world.getMeshes()) {
+        const NodeIndex node = entry.first;
+        const MeshData& mesh = entry.second;
+
+        // Only leaves are meshed, a subdivided node's mesh is on its way out
+        if (!octree.isLeaf(node) || mesh.vertexCount == 0 || mesh.indexCount == 0) continue;
+
+        const NodeBounds bounds = octree.getBounds(node);
+        DrawRecord record{};
+        record.bounds = glm::vec4(glm::vec3(bounds.position), static_cast<float>(bounds.size));
+
+        if (mesh.format == MeshFormat::QUADS) {
+            // One record per QUADS_PER_DRAW quads, as the direct path splits its draws
+            const BufferArena::Range& range = quadArena.getRange(mesh.vertices);
+            record.group = findGroup(MeshFormat::QUADS, range.page, 0, VK_INDEX_TYPE_UINT16);
+            const uint32_t quadCount = mesh.indexCount / 6;
+            for (uint32_t first = 0; first < quadCount; first += QUADS_PER_DRAW) {
+                record.indexCount = std::min(QUADS_PER_DRAW, quadCount - first) * 6;
+                record.firstIndex = 0;
+                record.vertexOffset = static_cast<int32_t>((range.first + first) * 4);
+                records.push_back(record);
+                groups[record.group].recordCount++;
+            }
+        } else {
+            // The index arena counts 32-bit words, 16-bit indices start at twice the word offset
+            const BufferArena::Range& vertexRange = vertexArena.getRange(mesh.vertices);
+            const BufferArena::Range& indexRange = indexArena.getRange(mesh.indices);
+            record.group = findGroup(MeshFormat::INDEXED, vertexRange.page, indexRange.page, mesh.indexType);
+            record.indexCount = mesh.indexCount;
+            record.firstIndex = mesh.indexType == VK_INDEX_TYPE_UINT16 ? indexRange.first * 2 : indexRange.first;
+            record.vertexOffset = static_cast<int32_t>(vertexRange.first);
+            records.push_back(record);
+            groups[record.group].recordCount++;
+        }
+    }
+
+    // Commands are written at the record's position within its group, order records by group
+    uint32_t firstCommand = 0;
+    for (Group& group : groups) {
+        group.firstCommand = firstCommand;
+        firstCommand += group.recordCount;
+    }
+    std::stable_sort(records.begin(), records.end(),
+        [](const DrawRecord& a, const DrawRecord& b) { return a.group < b.group; });
+}
+
+bool DrawCuller::reserveFrame(Frame& frame, uint32_t recordCount, uint32_t groupCount) {
+    if (recordCount <= frame.recordCapacity && groupCount <= frame.groupCapacity) {
+        return true;
+    }
+
+    // Grow geometrically, the world's mesh count mostly climbs while it streams in
+    uint32_t recordCapacity = std::max(frame.recordCapacity, INITIAL_RECORDS);
+    while (recordCapacity < recordCount) recordCapacity *= 2;
+    uint32_t groupCapacity = std::max(frame.groupCapacity, INITIAL_GROUPS);
+    while (groupCapacity < groupCount) groupCapacity *= 2;
+
+    destroyFrameBuffers(frame);
+    if (!createBuffer(VkDeviceSize(recordCapacity) * sizeof(DrawRecord), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            frame.recordBuffer, frame.recordAllocation) ||
+        !createBuffer(VkDeviceSize(groupCapacity) * sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            frame.groupBuffer, frame.groupAllocation) ||
+        !createBuffer(VkDeviceSize(recordCapacity) * sizeof(VkDrawIndexedIndirectCommand),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.commandBuffer, frame.commandAllocation) ||
+        !createBuffer(VkDeviceSize(groupCapacity) * sizeof(uint32_t),
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, frame.countBuffer, frame.countAllocation)) {
+        destroyFrameBuffers(frame);
+        return false;
+    }
+    frame.recordCapacity = recordCapacity;
+    frame.groupCapacity = groupCapacity;
+
+    // Sets are allocated once, new buffers are written into them
+    if (frame.cullSet == VK_NULL_HANDLE) {
+        const VkDescriptorSetLayout layouts[2] = {cullSetLayout, drawSetLayout};
+        VkDescriptorSet sets[2];
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = descriptorPool;
+        allocInfo.descriptorSetCount = 2;
+        allocInfo.pSetLayouts = layouts;
+        if (vkAllocateDescriptorSets(device, &allocInfo, sets) != VK_SUCCESS) {
+            destroyFrameBuffers(frame);
+            return false;
+        }
+        frame.cullSet = sets[0];
+        frame.drawSet = sets[1];
+    }
+
+    const VkDescriptorBufferInfo bufferInfos[CULL_BINDINGS] = {
+        {frame.recordBuffer, 0, VK_WHOLE_SIZE},
+        {frame.groupBuffer, 0, VK_WHOLE_SIZE},
+        {frame.commandBuffer, 0, VK_WHOLE_SIZE},
+        {frame.countBuffer, 0, VK_WHOLE_SIZE},
+        {frame.occlusionBuffer, 0, VK_WHOLE_SIZE},
+    };
+    // The last write puts the records into the draw set as well
+    std::array<VkWriteDescriptorSet, CULL_BINDINGS + 1> writes{};
+    for (uint32_t i = 0; i < writes.size(); ++i) {
+        const bool cull = i < CULL_BINDINGS;
+        writes[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        writes[i].dstSet = cull ? frame.cullSet : frame.drawSet;
+        writes[i].dstBinding = cull ? i : 0;
+        writes[i].descriptorCount = 1;
+        writes[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        writes[i].pBufferInfo = &bufferInfos[cull ? i : 0];
+    }
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+    frame.generation = UINT64_MAX;
+    return true;
+}
+
+void DrawCuller::destroyFrameBuffers(Frame& frame) {
+    destroyBuffer(frame.recordBuffer, frame.recordAllocation);
+    destroyBuffer(frame.groupBuffer, frame.groupAllocation);
+    destroyBuffer(frame.commandBuffer, frame.commandAllocation);
+    destroyBuffer(frame.countBuffer, frame.countAllocation);
+    frame.recordCapacity = 0;
+    frame.groupCapacity = 0;
+}
+
+bool DrawCuller::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                              VkBuffer& buffer, MemoryAllocation& allocation) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+    if (!allocator->allocate(memRequirements, properties, allocation) ||
+        vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        destroyBuffer(buffer, allocation);
+        return false;
+    }
+    return true;
+}
+
+void DrawCuller::destroyBuffer(VkBuffer& buffer, MemoryAllocation& allocation) {
+    if (buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+    }
+    allocator->free(allocation);
+}
+
+bool DrawCuller::createDescriptors() {
+    // Culling reads records, group starts and the occlusion pyramid, writes commands and counts
+    std::array<VkDescriptorSetLayoutBinding, CULL_BINDINGS> cullBindings{};
+    for (uint32_t i = 0; i < cullBindings.size(); ++i) {
+        cullBindings[i].binding = i;
+        cullBindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        cullBindings[i].descriptorCount = 1;
+        cullBindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
+
+    VkDescriptorSetLayoutCreateInfo layoutInfo{};
+    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    layoutInfo.bindingCount = static_cast<uint32_t>(cullBindings.size());
+    layoutInfo.pBindings = cullBindings.data();
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &cullSetLayout) != VK_SUCCESS) {
+        return false;
+    }
+
+    // Vertex shaders find their node's origin through gl_InstanceIndex, the draw's record
+    VkDescriptorSetLayoutBinding drawBinding{};
+    drawBinding.binding = 0;
+    drawBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    drawBinding.descriptorCount = 1;
+    drawBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    layoutInfo.bindingCount = 1;
+    layoutInfo.pBindings = &drawBinding;
+    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &drawSetLayout) != VK_SUCCESS) {
+        return false;
+    }
+
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = FRAMES_IN_FLIGHT * (static_cast<uint32_t>(cullBindings.size()) + 1);
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = FRAMES_IN_FLIGHT * 2;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    return vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) == VK_SUCCESS;
+}
+
+bool DrawCuller::createPipeline(const std::string& shaderPath) {
+    std::vector<char> shaderCode;
+    if (!loadShaderFile(shaderPath, shaderCode)) {
+        return false;
+    }
+
+    VkShaderModuleCreateInfo createInfo{};
+    createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+    createInfo.codeSize = shaderCode.size();
+    createInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
+
+    VkShaderModule shaderModule;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        std::cerr << "DrawCuller: Failed to create shader module for " << shaderPath << std::endl;
+        return false;
+    }
+
+    VkComputePipelineCreateInfo pipelineInfo{};
+    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.layout = pipelineLayout;
+
+    const bool created = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) == VK_SUCCESS;
+    if (!created) {
+        std::cerr << "DrawCuller: Failed to create compute pipeline from " << shaderPath << std::endl;
+    }
+
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+    return created;
+}
+
+bool DrawCuller::loadShaderFile(const std::string& filename, std::vector<char>& buffer) {
+    std::ifstream file(filename, std::ios::ate | std::ios::binary);
+    if (!file.is_open()) {
+        std::cerr << "Failed to open shader file: " << filename << std::endl;
+        return false;
+    }
+
+    size_t fileSize = static_cast<size_t>(file.tellg());
+    if (fileSize == 0 || fileSize % 4 != 0) {
+        std::cerr << "Invalid shader file: " << filename << std::endl;
+        return false;
+    }
+
+    buffer.resize(fileSize);
+    file.seekg(0);
+    file.read(buffer.data(), fileSize);
+    return true;
+}
+
+} // namespace voxceleron
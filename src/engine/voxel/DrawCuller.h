@@ -0,0 +1,144 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <array>
+#include <string>
+#include <vector>
+#include "../core/Camera.h"
+#include "../vulkan/core/MemoryAllocator.h"
+#include "MeshTypes.h"
+#include "OcclusionBuffer.h"
+
+namespace voxceleron {
+
+class World;
+
+// GPU-driven culling of the world's meshes. Every mesh is a draw record with its node's
+// bounds and draw parameters, grouped by the arena pages it is drawn from. Each frame a
+// compute pass tests the records against the frustum and, if given, the occlusion buffer's
+// pyramid, then appends the survivors' indirect draw commands to their group, so the
+// renderer issues one vkCmdDrawIndexedIndirectCount per group. Records are only rebuilt
+// when the world's meshes change.
+class DrawCuller {
+public:
+    static constexpr uint32_t FRAMES_IN_FLIGHT = 2;  // Frames the renderer keeps in flight
+    static constexpr uint32_t QUADS_PER_DRAW = 1u << 14;  // Quads one draw of the shared quad index buffer covers
+
+    // Draws sharing their bound state, the commands of group i start at firstCommand and
+    // their count is at i in getCountBuffer
+    struct Group {
+        MeshFormat format;
+        uint32_t vertexPage;   // Vertex arena page, quad arena page for QUADS
+        uint32_t indexPage;    // Unused for QUADS, they draw from the shared quad index buffer
+        VkIndexType indexType;
+        uint32_t firstCommand;
+        uint32_t recordCount;  // Upper bound of the group's draw count
+    };
+
+    DrawCuller(VkDevice device, MemoryAllocator* allocator);
+    ~DrawCuller();
+
+    bool initialize();
+    void cleanup();  // The device must be idle
+
+    // Layout of the set the vertex shaders read per-draw origins from, the draw records
+    VkDescriptorSetLayout getDrawSetLayout() const { return drawSetLayout; }
+
+    // Moves on to the next frame's buffers. Call once per frame before recording, the
+    // buffers are reused once the frame that last recorded them has finished.
+    void beginFrame();
+
+    // Brings the records up to date with the world's meshes and records the culling pass.
+    // Must be recorded outside a render pass. Returns false if there is nothing to draw.
+    bool recordCulling(VkCommandBuffer commandBuffer, const World& world, const Camera::Frustum& frustum,
+                       float margin, bool frustumTest, const OcclusionBuffer* occlusion);
+
+    // Valid for the current frame after recordCulling
+    const std::vector<Group>& getGroups() const { return groups; }
+    VkBuffer getCommandBuffer() const { return frames[currentFrame].commandBuffer; }
+    VkBuffer getCountBuffer() const { return frames[currentFrame].countBuffer; }
+    VkDescriptorSet getDrawSet() const { return frames[currentFrame].drawSet; }
+
+private:
+    // Mirrors DrawRecord in cull_draws.comp, basic.vert and quad.vert
+    struct DrawRecord {
+        glm::vec4 bounds;       // xyz node origin, w node size
+        uint32_t indexCount;
+        uint32_t firstIndex;
+        int32_t vertexOffset;
+        uint32_t group;
+    };
+
+    // Mirrors the header of OcclusionData in cull_draws.comp, the pyramid's depths follow it
+    struct OcclusionHeader {
+        glm::mat4 viewProjection;
+        uint32_t width;
+        uint32_t height;
+        uint32_t levelCount;
+        uint32_t enabled;
+        glm::uvec4 levelOffsets[OcclusionBuffer::MAX_LEVELS / 4];
+    };
+
+    struct PushConstants {
+        glm::vec4 planes[6];
+        uint32_t recordCount;
+        float margin;
+        uint32_t frustumTest;
+        uint32_t padding;
+    };
+
+    struct Frame {
+        VkBuffer recordBuffer = VK_NULL_HANDLE;   // Host-visible DrawRecords
+        MemoryAllocation recordAllocation;
+        VkBuffer groupBuffer = VK_NULL_HANDLE;    // Host-visible firstCommand per group
+        MemoryAllocation groupAllocation;
+        VkBuffer commandBuffer = VK_NULL_HANDLE;  // VkDrawIndexedIndirectCommand per record
+        MemoryAllocation commandAllocation;
+        VkBuffer countBuffer = VK_NULL_HANDLE;    // Draw count per group
+        MemoryAllocation countAllocation;
+        VkBuffer occlusionBuffer = VK_NULL_HANDLE;  // Host-visible OcclusionHeader and pyramid
+        MemoryAllocation occlusionAllocation;
+        uint32_t recordCapacity = 0;
+        uint32_t groupCapacity = 0;
+        VkDescriptorSet cullSet = VK_NULL_HANDLE;
+        VkDescriptorSet drawSet = VK_NULL_HANDLE;
+        uint64_t generation = UINT64_MAX;         // Mesh generation the buffers hold, none yet
+    };
+
+    static constexpr uint32_t GROUP_SIZE = 64;  // local_size of cull_draws.comp
+    static constexpr uint32_t CULL_BINDINGS = 5;
+    static constexpr uint32_t INITIAL_RECORDS = 4096;
+    static constexpr uint32_t INITIAL_GROUPS = 64;
+
+    VkDevice device;
+    MemoryAllocator* allocator;
+    VkDescriptorSetLayout cullSetLayout;
+    VkDescriptorSetLayout drawSetLayout;
+    VkDescriptorPool descriptorPool;
+    VkPipelineLayout pipelineLayout;
+    VkPipeline pipeline;
+    std::array<Frame, FRAMES_IN_FLIGHT> frames;
+    uint32_t currentFrame;
+
+    // Host copy of the records, built once per mesh generation and copied into each frame
+    std::vector<DrawRecord> records;
+    std::vector<Group> groups;
+    uint64_t builtGeneration;
+
+    void buildRecords(const World& world);
+    bool reserveFrame(Frame& frame, uint32_t recordCount, uint32_t groupCount);
+    void writeOcclusion(Frame& frame, const OcclusionBuffer* occlusion);
+    void destroyFrameBuffers(Frame& frame);
+    bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                      VkBuffer& buffer, MemoryAllocation& allocation);
+    void destroyBuffer(VkBuffer& buffer, MemoryAllocation& allocation);
+    bool createDescriptors();
+    bool createPipeline(const std::string& shaderPath);
+    bool loadShaderFile(const std::string& filename, std::vector<char>& buffer);
+
+    DrawCuller(const DrawCuller&) = delete;
+    DrawCuller& operator=(const DrawCuller&) = delete;
+};
+
+} // namespace voxceleron
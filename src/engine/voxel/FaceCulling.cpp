@@ -0,0 +1,159 @@
+#include "FaceCulling.h"
+#include <algorithm>
+
+#if defined(__AVX2__)
+#define FACE_CULLING_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FACE_CULLING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace voxceleron {
+
+namespace {
+
+// Bit x set when row[x] holds a solid voxel (type byte non-zero)
+uint64_t solidBits(const uint32_t* row, uint32_t n) {
+    uint64_t bits = 0;
+    uint32_t x = 0;
+#if defined(FACE_CULLING_AVX2)
+    const __m256i typeMask = _mm256_set1_epi32(0xFF);
+    const __m256i zero = _mm256_setzero_si256();
+    for (; x + 8 <= n; x += 8) {
+        const __m256i voxels = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(row + x));
+        const __m256i air = _mm256_cmpeq_epi32(_mm256_and_si256(voxels, typeMask), zero);
+        const uint32_t airBits = static_cast<uint32_t>(_mm256_movemask_ps(_mm256_castsi256_ps(air)));
+        bits |= uint64_t(~airBits & 0xFFu) << x;
+    }
+#elif defined(FACE_CULLING_SSE2)
+    const __m128i typeMask = _mm_set1_epi32(0xFF);
+    const __m128i zero = _mm_setzero_si128();
+    for (; x + 4 <= n; x += 4) {
+        const __m128i voxels = _mm_loadu_si128(reinterpret_cast<const __m128i*>(row + x));
+        const __m128i air = _mm_cmpeq_epi32(_mm_and_si128(voxels, typeMask), zero);
+        const uint32_t airBits = static_cast<uint32_t>(_mm_movemask_ps(_mm_castsi128_ps(air)));
+        bits |= uint64_t(~airBits & 0xFu) << x;
+    }
+#endif
+    for (; x < n; ++x) {
+        bits |= uint64_t((row[x] & 0xFF) != 0) << x;
+    }
+    return bits;
+}
+
+// Faces between neighbouring columns: plus = c & ~next, minus = c & ~prev
+void cullAcross(const uint64_t* center, const uint64_t* next, const uint64_t* prev,
+                uint64_t* plus, uint64_t* minus, uint32_t count) {
+    uint32_t i = 0;
+#if defined(FACE_CULLING_AVX2)
+    for (; i + 4 <= count; i += 4) {
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(center + i));
+        const __m256i n = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(next + i));
+        const __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(prev + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(plus + i), _mm256_andnot_si256(n, c));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(minus + i), _mm256_andnot_si256(p, c));
+    }
+#elif defined(FACE_CULLING_SSE2)
+    for (; i + 2 <= count; i += 2) {
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(center + i));
+        const __m128i n = _mm_loadu_si128(reinterpret_cast<const __m128i*>(next + i));
+        const __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(prev + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(plus + i), _mm_andnot_si128(n, c));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(minus + i), _mm_andnot_si128(p, c));
+    }
+#endif
+    for (; i < count; ++i) {
+        plus[i] = center[i] & ~next[i];
+        minus[i] = center[i] & ~prev[i];
+    }
+}
+
+// Faces along a column, lo/hi hold the border voxel below bit 0 and above bit n-1 as 0 or 1
+void cullAlong(const uint64_t* center, const uint64_t* lo, const uint64_t* hi,
+               uint64_t* plus, uint64_t* minus, uint32_t count, uint32_t n) {
+    uint32_t i = 0;
+#if defined(FACE_CULLING_AVX2)
+    const __m128i topShift = _mm_cvtsi32_si128(static_cast<int>(n - 1));
+    for (; i + 4 <= count; i += 4) {
+        const __m256i c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(center + i));
+        const __m256i l = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lo + i));
+        const __m256i h = _mm256_sll_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(hi + i)), topShift);
+        const __m256i above = _mm256_or_si256(_mm256_srli_epi64(c, 1), h);
+        const __m256i below = _mm256_or_si256(_mm256_slli_epi64(c, 1), l);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(plus + i), _mm256_andnot_si256(above, c));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(minus + i), _mm256_andnot_si256(below, c));
+    }
+#elif defined(FACE_CULLING_SSE2)
+    const __m128i topShift = _mm_cvtsi32_si128(static_cast<int>(n - 1));
+    for (; i + 2 <= count; i += 2) {
+        const __m128i c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(center + i));
+        const __m128i l = _mm_loadu_si128(reinterpret_cast<const __m128i*>(lo + i));
+        const __m128i h = _mm_sll_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(hi + i)), topShift);
+        const __m128i above = _mm_or_si128(_mm_srli_epi64(c, 1), h);
+        const __m128i below = _mm_or_si128(_mm_slli_epi64(c, 1), l);
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(plus + i), _mm_andnot_si128(above, c));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(minus + i), _mm_andnot_si128(below, c));
+    }
+#endif
+    for (; i < count; ++i) {
+        plus[i] = center[i] & ~((center[i] >> 1) | (hi[i] << (n - 1)));
+        minus[i] = center[i] & ~((center[i] << 1) | lo[i]);
+    }
+}
+
+} // namespace
+
+void buildFaceMasks(const uint32_t* paddedVoxels, uint32_t size, FaceMasks& masks) {
+    const uint32_t n = size;
+    const uint32_t p = n + 2;
+    masks.size = n;
+    for (std::vector<uint64_t>& face : masks.faces) {
+        face.resize(size_t(n) * n);
+    }
+
+    // Occupancy columns over the padded y/z range so rows next to the border have neighbours,
+    // plus the x border voxels of every interior column
+    thread_local std::vector<uint64_t> occupancy;
+    thread_local std::vector<uint64_t> borderLo;
+    thread_local std::vector<uint64_t> borderHi;
+    occupancy.resize(size_t(p) * p);
+    borderLo.resize(size_t(n) * n);
+    borderHi.resize(size_t(n) * n);
+
+    for (uint32_t z = 0; z < p; ++z) {
+        for (uint32_t y = 0; y < p; ++y) {
+            const uint32_t* row = paddedVoxels + size_t(y) * p + size_t(z) * p * p;
+            occupancy[size_t(z) * p + y] = solidBits(row + 1, n);
+
+            if (z == 0 || y == 0 || z == p - 1 || y == p - 1) continue;
+            const size_t column = size_t(z - 1) * n + (y - 1);
+            borderLo[column] = (row[0] & 0xFF) != 0 ? 1 : 0;
+            borderHi[column] = (row[n + 1] & 0xFF) != 0 ? 1 : 0;
+        }
+    }
+
+    for (uint32_t z = 0; z < n; ++z) {
+        const uint64_t* center = occupancy.data() + size_t(z + 1) * p + 1;
+        const size_t column = size_t(z) * n;
+
+        cullAlong(center, borderLo.data() + column, borderHi.data() + column,
+                  masks.faces[0].data() + column, masks.faces[1].data() + column, n, n);
+        cullAcross(center, center + 1, center - 1,
+                   masks.faces[2].data() + column, masks.faces[3].data() + column, n);
+        cullAcross(center, center + p, center - p,
+                   masks.faces[4].data() + column, masks.faces[5].data() + column, n);
+    }
+}
+
+const char* getFaceCullingIsa() {
+#if defined(FACE_CULLING_AVX2)
+    return "avx2";
+#elif defined(FACE_CULLING_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace voxceleron
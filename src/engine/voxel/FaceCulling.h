@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace voxceleron {
+
+// Largest volume edge one 64-bit column covers
+static constexpr uint32_t FACE_MASK_MAX_SIZE = 64;
+
+// Visible faces of a volume as bitmasks. Columns run along x: word [z * size + y] of
+// faces[f] has bit x set when voxel (x, y, z) is solid and its neighbour across face f
+// is not. Face order is +X, -X, +Y, -Y, +Z, -Z.
+//
+// Faces along x come from shifting a column against itself, faces along y and z from
+// AND-NOT of neighbouring columns, so 64 voxels are culled per word operation instead
+// of one neighbour test per voxel. Kernels use AVX2 or SSE2 when the build targets them.
+struct FaceMasks {
+    uint32_t size{0};
+    std::vector<uint64_t> faces[6];
+};
+
+// Fill masks from size^3 voxels padded by one border voxel on each side, laid out as
+// (x+1) + (y+1)*p + (z+1)*p*p with p = size + 2. size must not exceed FACE_MASK_MAX_SIZE.
+void buildFaceMasks(const uint32_t* paddedVoxels, uint32_t size, FaceMasks& masks);
+
+// Instruction set the culling kernels were compiled for: "avx2", "sse2" or "scalar"
+const char* getFaceCullingIsa();
+
+inline uint32_t countTrailingZeros(uint64_t bits) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(bits));
+#endif
+}
+
+} // namespace voxceleron
@@ -0,0 +1,808 @@
+#include "FlatOctree.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+
+namespace voxceleron {
+
+enum class RegionCoverage {
+    None,
+    Partial,
+    Full
+};
+
+// Shape and per-voxel transform of a region edit
+struct FlatOctree::RegionEdit {
+    bool isSphere{false};
+    glm::ivec3 min{0};          // Inclusive voxel bounds of the shape
+    glm::ivec3 max{0};
+    glm::ivec3 center{0};       // Sphere only
+    int64_t radiusSq{0};
+
+    bool replaceOnly{false};    // Only rewrite voxels whose type is fromType
+    uint32_t fromType{0};
+    uint32_t value{0};
+
+    bool contains(const glm::ivec3& p) const {
+        if (!isSphere) return true;  // Callers already clip to [min, max]
+        const int64_t dx = int64_t(p.x) - center.x;
+        const int64_t dy = int64_t(p.y) - center.y;
+        const int64_t dz = int64_t(p.z) - center.z;
+        return dx * dx + dy * dy + dz * dz <= radiusSq;
+    }
+
+    uint32_t apply(uint32_t old) const {
+        if (replaceOnly && (old & 0xFF) != fromType) return old;
+        return value;
+    }
+
+    RegionCoverage classify(const NodeBounds& bounds) const {
+        const glm::ivec3 nodeMin = bounds.position;
+        const glm::ivec3 nodeMax = bounds.position + glm::ivec3(bounds.size - 1);
+        for (int axis = 0; axis < 3; ++axis) {
+            if (nodeMax[axis] < min[axis] || nodeMin[axis] > max[axis]) return RegionCoverage::None;
+        }
+
+        if (!isSphere) {
+            for (int axis = 0; axis < 3; ++axis) {
+                if (nodeMin[axis] < min[axis] || nodeMax[axis] > max[axis]) return RegionCoverage::Partial;
+            }
+            return RegionCoverage::Full;
+        }
+
+        // Nearest and farthest voxel of the node from the sphere center
+        int64_t nearSq = 0;
+        int64_t farSq = 0;
+        for (int axis = 0; axis < 3; ++axis) {
+            const int64_t c = center[axis];
+            const int64_t nearest = std::clamp<int64_t>(c, nodeMin[axis], nodeMax[axis]) - c;
+            const int64_t farthest = std::max(std::abs(nodeMin[axis] - c), std::abs(nodeMax[axis] - c));
+            nearSq += nearest * nearest;
+            farSq += farthest * farthest;
+        }
+        if (nearSq > radiusSq) return RegionCoverage::None;
+        return farSq <= radiusSq ? RegionCoverage::Full : RegionCoverage::Partial;
+    }
+};
+
+FlatOctree::FlatOctree(uint32_t maxLevel, const glm::ivec3& origin, uint32_t brickSizeLog2)
+    : maxLevel(maxLevel)
+    , brickLevel(maxLevel - brickSizeLog2)
+    , origin(origin)
+    , bricks(brickSizeLog2) {
+    clear();
+}
+
+void FlatOctree::clear() {
+    childBase.assign(1, INVALID_NODE);
+    childMask.assign(1, 0);
+    flags.assign(1, NODE_FLAG_NONE);
+    payload.assign(1, 0);
+    groupParent.clear();
+    freeGroups.clear();
+    releasedGroups.clear();
+    collapseQueue.clear();
+    dirtyNodes.clear();
+    bricks.clear();
+    brickMap.clear();
+}
+
+NodeBounds FlatOctree::getRootBounds() const {
+    NodeBounds bounds;
+    bounds.position = origin;
+    bounds.size = 1u << maxLevel;
+    bounds.level = 0;
+    return bounds;
+}
+
+bool FlatOctree::contains(const glm::ivec3& pos) const {
+    const int64_t rootSize = int64_t(1) << maxLevel;
+    return pos.x >= origin.x && pos.y >= origin.y && pos.z >= origin.z &&
+           int64_t(pos.x) - origin.x < rootSize &&
+           int64_t(pos.y) - origin.y < rootSize &&
+           int64_t(pos.z) - origin.z < rootSize;
+}
+
+void FlatOctree::setDirty(NodeIndex node, bool dirty) {
+    if (dirty) {
+        markDirty(node);
+    } else {
+        flags[node] &= ~NODE_FLAG_DIRTY;
+    }
+}
+
+NodeBounds FlatOctree::getChildBounds(const NodeBounds& parent, uint32_t i) {
+    NodeBounds bounds;
+    bounds.size = parent.size >> 1;
+    bounds.level = parent.level + 1;
+    bounds.position = parent.position + glm::ivec3(
+        (i & 1) ? bounds.size : 0,
+        (i & 2) ? bounds.size : 0,
+        (i & 4) ? bounds.size : 0
+    );
+    return bounds;
+}
+
+NodeIndex FlatOctree::findLeaf(const glm::ivec3& pos, NodeBounds* bounds) const {
+    if (!contains(pos)) return INVALID_NODE;
+
+    const glm::ivec3 localPos = pos - origin;
+    NodeIndex current = findBrickLocal(localPos);
+    uint32_t level = brickLevel;
+
+    // Only descend when pos is not inside a brick
+    if (current == INVALID_NODE) {
+        current = 0;
+        level = 0;
+    }
+
+    while (childBase[current] != INVALID_NODE) {
+        current = childBase[current] + childIndexFor(localPos, level);
+        level++;
+    }
+
+    if (bounds) {
+        const uint32_t shift = maxLevel - level;
+        bounds->size = 1u << shift;
+        bounds->level = level;
+        bounds->position = origin + ((localPos >> shift) << shift);
+    }
+    return current;
+}
+
+NodeIndex FlatOctree::findBrick(const glm::ivec3& pos) const {
+    if (!contains(pos)) return INVALID_NODE;
+    return findBrickLocal(pos - origin);
+}
+
+uint32_t FlatOctree::getValue(const glm::ivec3& pos) const {
+    NodeBounds bounds;
+    const NodeIndex leaf = findLeaf(pos, &bounds);
+    if (leaf == INVALID_NODE) return 0;
+
+    if (flags[leaf] & NODE_FLAG_BRICK) {
+        return bricks.getVoxel(payload[leaf], pos - bounds.position);
+    }
+    return payload[leaf];
+}
+
+NodeIndex FlatOctree::setValue(const glm::ivec3& pos, uint32_t value) {
+    if (!contains(pos)) return INVALID_NODE;
+
+    const glm::ivec3 localPos = pos - origin;
+    const uint32_t brickMask = bricks.getBrickSize() - 1;
+    const glm::ivec3 local(localPos.x & brickMask, localPos.y & brickMask, localPos.z & brickMask);
+
+    // Fast path: the brick already exists, its ancestors already have their mask bits set
+    NodeIndex current = findBrickLocal(localPos);
+    if (current != INVALID_NODE) {
+        if (!bricks.setVoxel(payload[current], local, value)) return current;
+        markDirty(current);
+        markNeighborsDirty(pos);
+        queueCollapse(current);
+
+        if (value == 0 && isEmptyBrick(current)) {
+            releaseEmptyBrick(current);
+        }
+        return current;
+    }
+
+    current = 0;
+    uint32_t level = 0;
+
+    while (level < brickLevel) {
+        if (childBase[current] == INVALID_NODE) {
+            // Writing the value the leaf already holds changes nothing
+            if (payload[current] == value) return current;
+            subdivide(current);
+        }
+        const uint32_t childIndex = childIndexFor(localPos, level);
+        if (value != 0) {
+            childMask[current] |= (1 << childIndex);
+        }
+        current = childBase[current] + childIndex;
+        level++;
+    }
+
+    if (!(flags[current] & NODE_FLAG_BRICK)) {
+        if (payload[current] == value) return current;
+
+        // Expand the uniform leaf into a brick holding its old value
+        const uint32_t shift = maxLevel - brickLevel;
+        const glm::ivec3 brickOrigin = origin + ((localPos >> shift) << shift);
+        payload[current] = bricks.allocate(brickOrigin, payload[current]);
+        flags[current] = (flags[current] & ~NODE_FLAG_UNIFORM) | NODE_FLAG_BRICK;
+        brickMap.insert(brickKey(localPos), current);
+    }
+
+    if (bricks.setVoxel(payload[current], local, value)) {
+        markDirty(current);
+        markNeighborsDirty(pos);
+    }
+    queueCollapse(current);
+
+    // Drop bricks that were emptied so air stays free
+    if (value == 0 && isEmptyBrick(current)) {
+        releaseEmptyBrick(current);
+    }
+    return current;
+}
+
+void FlatOctree::setValues(const glm::ivec3* positions, const uint32_t* values, size_t count) {
+    std::vector<std::pair<uint64_t, uint32_t>> order;
+    sortByMorton(positions, count, order);
+
+    // Morton codes of voxels in the same brick share everything above the low 3*log2 bits
+    const uint32_t brickShift = 3 * bricks.getSizeLog2();
+    const uint32_t brickMask = bricks.getBrickSize() - 1;
+
+    size_t runStart = 0;
+    while (runStart < order.size()) {
+        const uint64_t runKey = order[runStart].first >> brickShift;
+        size_t runEnd = runStart + 1;
+        while (runEnd < order.size() && (order[runEnd].first >> brickShift) == runKey) {
+            runEnd++;
+        }
+
+        NodeIndex node = brickMap.find(runKey);
+        bool changed = false;
+
+        for (size_t i = runStart; i < runEnd; ++i) {
+            const uint32_t input = order[i].second;
+            if (node == INVALID_NODE) {
+                // No brick yet, let the single-voxel path split the tree and create it
+                setValue(positions[input], values[input]);
+                node = brickMap.find(runKey);
+                continue;
+            }
+
+            const glm::ivec3 localPos = positions[input] - origin;
+            const glm::ivec3 local(localPos.x & brickMask, localPos.y & brickMask, localPos.z & brickMask);
+            if (bricks.setVoxel(payload[node], local, values[input])) {
+                markNeighborsDirty(positions[input]);
+                changed = true;
+            }
+        }
+
+        if (node != INVALID_NODE && changed) {
+            markDirty(node);
+            queueCollapse(node);
+            if (isEmptyBrick(node)) {
+                releaseEmptyBrick(node);
+            }
+        }
+        runStart = runEnd;
+    }
+}
+
+void FlatOctree::getValues(const glm::ivec3* positions, uint32_t* values, size_t count) const {
+    std::fill(values, values + count, 0);
+
+    std::vector<std::pair<uint64_t, uint32_t>> order;
+    sortByMorton(positions, count, order);
+
+    // Sorted input mostly stays inside the last leaf, only look up a new one on exit
+    NodeIndex leaf = INVALID_NODE;
+    NodeBounds bounds;
+    for (const auto& entry : order) {
+        const glm::ivec3& pos = positions[entry.second];
+        const glm::ivec3 offset = pos - bounds.position;
+        if (leaf == INVALID_NODE ||
+            static_cast<uint32_t>(offset.x) >= bounds.size ||
+            static_cast<uint32_t>(offset.y) >= bounds.size ||
+            static_cast<uint32_t>(offset.z) >= bounds.size) {
+            leaf = findLeaf(pos, &bounds);
+        }
+
+        values[entry.second] = (flags[leaf] & NODE_FLAG_BRICK)
+            ? bricks.getVoxel(payload[leaf], pos - bounds.position)
+            : payload[leaf];
+    }
+}
+
+void FlatOctree::readVolumeWithBorder(NodeIndex leaf, const NodeBounds& bounds, uint32_t* out) const {
+    const int n = static_cast<int>(bounds.size);
+    const int p = n + 2;
+    std::fill(out, out + size_t(p) * p * p, 0);
+
+    // Interior, row by row into the padded layout
+    const auto row = [p](int y, int z) { return size_t(1) + size_t(y + 1) * p + size_t(z + 1) * p * p; };
+    if (flags[leaf] & NODE_FLAG_BRICK) {
+        thread_local std::vector<uint32_t> decoded;
+        decoded.resize(size_t(n) * n * n);
+        bricks.decode(payload[leaf], decoded.data());
+        for (int z = 0; z < n; ++z) {
+            for (int y = 0; y < n; ++y) {
+                const uint32_t* src = decoded.data() + size_t(y) * n + size_t(z) * n * n;
+                std::copy(src, src + n, out + row(y, z));
+            }
+        }
+    } else {
+        for (int z = 0; z < n; ++z) {
+            for (int y = 0; y < n; ++y) {
+                std::fill(out + row(y, z), out + row(y, z) + n, payload[leaf]);
+            }
+        }
+    }
+
+    // One slab per face, consecutive cells mostly stay inside the same neighbouring leaf
+    for (int axis = 0; axis < 3; ++axis) {
+        const int u = (axis + 1) % 3;
+        const int v = (axis + 2) % 3;
+        for (int side : {-1, n}) {
+            NodeIndex neighbor = INVALID_NODE;
+            NodeBounds neighborBounds;
+            for (int j = 0; j < n; ++j) {
+                for (int i = 0; i < n; ++i) {
+                    glm::ivec3 local(0);
+                    local[axis] = side;
+                    local[u] = i;
+                    local[v] = j;
+                    const glm::ivec3 pos = bounds.position + local;
+
+                    const glm::ivec3 offset = pos - neighborBounds.position;
+                    if (neighbor == INVALID_NODE ||
+                        static_cast<uint32_t>(offset.x) >= neighborBounds.size ||
+                        static_cast<uint32_t>(offset.y) >= neighborBounds.size ||
+                        static_cast<uint32_t>(offset.z) >= neighborBounds.size) {
+                        neighbor = findLeaf(pos, &neighborBounds);
+                        if (neighbor == INVALID_NODE) continue;  // Outside the octree reads as air
+                    }
+
+                    const size_t index = size_t(local.x + 1) + size_t(local.y + 1) * p + size_t(local.z + 1) * p * p;
+                    out[index] = (flags[neighbor] & NODE_FLAG_BRICK)
+                        ? bricks.getVoxel(payload[neighbor], pos - neighborBounds.position)
+                        : payload[neighbor];
+                }
+            }
+        }
+    }
+}
+
+void FlatOctree::fillBox(const glm::ivec3& min, const glm::ivec3& max, uint32_t value) {
+    RegionEdit edit;
+    edit.min = min;
+    edit.max = max;
+    edit.value = value;
+    editRegion(0, getRootBounds(), edit);
+}
+
+void FlatOctree::fillSphere(const glm::ivec3& center, float radius, uint32_t value) {
+    if (radius < 0.0f) return;
+
+    const int extent = static_cast<int>(radius);
+    RegionEdit edit;
+    edit.isSphere = true;
+    edit.center = center;
+    edit.radiusSq = static_cast<int64_t>(radius * radius);
+    edit.min = center - glm::ivec3(extent);
+    edit.max = center + glm::ivec3(extent);
+    edit.value = value;
+    editRegion(0, getRootBounds(), edit);
+}
+
+void FlatOctree::replaceType(const glm::ivec3& min, const glm::ivec3& max, uint32_t fromType, uint32_t value) {
+    RegionEdit edit;
+    edit.min = min;
+    edit.max = max;
+    edit.replaceOnly = true;
+    edit.fromType = fromType & 0xFF;
+    edit.value = value;
+    editRegion(0, getRootBounds(), edit);
+}
+
+void FlatOctree::takeDirtyNodes(std::vector<NodeIndex>& out) {
+    out.insert(out.end(), dirtyNodes.begin(), dirtyNodes.end());
+    dirtyNodes.clear();
+}
+
+NodeBounds FlatOctree::getBounds(NodeIndex node) const {
+    // Collect child indices up to the root, then replay them downwards
+    uint32_t path[32];
+    uint32_t depth = 0;
+    for (NodeIndex current = node; current != 0; current = getParent(current)) {
+        path[depth++] = (current - 1) & 7;
+    }
+
+    NodeBounds bounds = getRootBounds();
+    while (depth > 0) {
+        bounds = getChildBounds(bounds, path[--depth]);
+    }
+    return bounds;
+}
+
+void FlatOctree::takeReleasedGroups(std::vector<NodeIndex>& out) {
+    out.insert(out.end(), releasedGroups.begin(), releasedGroups.end());
+    releasedGroups.clear();
+}
+
+bool FlatOctree::subdivide(NodeIndex node) {
+    if (childBase[node] != INVALID_NODE || (flags[node] & NODE_FLAG_BRICK)) return false;
+
+    const NodeIndex base = allocateGroup();
+    groupParent[groupOf(base)] = node;
+    const uint32_t value = payload[node];
+    for (uint32_t i = 0; i < 8; ++i) {
+        childBase[base + i] = INVALID_NODE;
+        childMask[base + i] = 0;
+        flags[base + i] = NODE_FLAG_NONE;
+        markDirty(base + i);
+        payload[base + i] = value;
+    }
+
+    childBase[node] = base;
+    childMask[node] = value != 0 ? 0xFF : 0;
+    flags[node] &= ~NODE_FLAG_UNIFORM;
+    markDirty(node);
+    payload[node] = 0;
+    return true;
+}
+
+bool FlatOctree::isCollapsible(NodeIndex node) const {
+    const NodeIndex base = childBase[node];
+    if (base == INVALID_NODE) return false;
+
+    for (uint32_t i = 0; i < 8; ++i) {
+        if (childBase[base + i] != INVALID_NODE || (flags[base + i] & NODE_FLAG_BRICK) ||
+            payload[base + i] != payload[base]) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool FlatOctree::collapse(NodeIndex node) {
+    if (!isCollapsible(node)) return false;
+
+    const NodeIndex base = childBase[node];
+    payload[node] = payload[base];
+    releaseGroup(base);
+
+    childBase[node] = INVALID_NODE;
+    childMask[node] = 0;
+    flags[node] |= NODE_FLAG_UNIFORM;
+    markDirty(node);
+    updateParentMask(node);
+    return true;
+}
+
+bool FlatOctree::compactBrick(NodeIndex node) {
+    if (!(flags[node] & NODE_FLAG_BRICK)) return false;
+
+    uint32_t value;
+    if (!bricks.isUniform(payload[node], value)) return false;
+
+    releaseBrick(node, value);
+    flags[node] |= NODE_FLAG_UNIFORM;
+    updateParentMask(node);
+    return true;
+}
+
+size_t FlatOctree::collapsePending() {
+    const size_t before = getNodeCount();
+
+    for (NodeIndex node : collapseQueue) {
+        // Nodes released since they were queued had their flags reset
+        if (!(flags[node] & NODE_FLAG_QUEUED)) continue;
+        flags[node] &= ~NODE_FLAG_QUEUED;
+
+        compactBrick(node);
+
+        // Merge upwards until a level still has differing children, or solid children
+        // would end up in a leaf above brick level
+        NodeIndex current = isLeaf(node) ? getParent(node) : node;
+        if (current == INVALID_NODE) continue;
+        uint32_t level = getBounds(current).level;
+        while (current != INVALID_NODE && isCollapsible(current) &&
+               canBeUniform(level, payload[childBase[current]]) && collapse(current)) {
+            current = getParent(current);
+            level--;
+        }
+    }
+    collapseQueue.clear();
+
+    return before - getNodeCount();
+}
+
+size_t FlatOctree::getMemoryUsage() const {
+    return childBase.capacity() * sizeof(uint32_t) +
+           childMask.capacity() * sizeof(uint8_t) +
+           flags.capacity() * sizeof(uint8_t) +
+           payload.capacity() * sizeof(uint32_t) +
+           groupParent.capacity() * sizeof(NodeIndex) +
+           freeGroups.capacity() * sizeof(NodeIndex) +
+           collapseQueue.capacity() * sizeof(NodeIndex) +
+           dirtyNodes.capacity() * sizeof(NodeIndex) +
+           bricks.getMemoryUsage() +
+           brickMap.getMemoryUsage();
+}
+
+NodeIndex FlatOctree::allocateGroup() {
+    if (!freeGroups.empty()) {
+        const NodeIndex base = freeGroups.back();
+        freeGroups.pop_back();
+        return base;
+    }
+
+    const NodeIndex base = static_cast<NodeIndex>(childBase.size());
+    childBase.resize(base + 8);
+    childMask.resize(base + 8);
+    flags.resize(base + 8);
+    payload.resize(base + 8);
+    groupParent.resize(groupOf(base) + 1);
+    return base;
+}
+
+void FlatOctree::releaseGroup(NodeIndex base) {
+    // Release grandchildren first so no group is left unreachable
+    for (uint32_t i = 0; i < 8; ++i) {
+        releaseSubtree(base + i);
+        flags[base + i] = NODE_FLAG_NONE;
+    }
+    groupParent[groupOf(base)] = INVALID_NODE;
+    freeGroups.push_back(base);
+    releasedGroups.push_back(base);
+}
+
+void FlatOctree::releaseSubtree(NodeIndex node) {
+    if (flags[node] & NODE_FLAG_BRICK) {
+        releaseBrick(node, 0);
+    }
+    if (childBase[node] == INVALID_NODE) return;
+    releaseGroup(childBase[node]);
+    childBase[node] = INVALID_NODE;
+    childMask[node] = 0;
+}
+
+void FlatOctree::releaseBrick(NodeIndex node, uint32_t value) {
+    brickMap.erase(brickKey(bricks.get(payload[node]).getOrigin() - origin));
+    bricks.release(payload[node]);
+    payload[node] = value;
+    flags[node] &= ~NODE_FLAG_BRICK;
+    markDirty(node);
+}
+
+void FlatOctree::editRegion(NodeIndex node, const NodeBounds& bounds, const RegionEdit& edit) {
+    const RegionCoverage coverage = edit.classify(bounds);
+    if (coverage == RegionCoverage::None) return;
+
+    // Fully covered by a fill: drop whatever is below and store one value. Solid fills of
+    // nodes above brick level are split down to it like a partial cover.
+    if (coverage == RegionCoverage::Full && !edit.replaceOnly && canBeUniform(bounds.level, edit.value)) {
+        if (isLeaf(node) && !(flags[node] & NODE_FLAG_BRICK) && payload[node] == edit.value) return;
+        makeUniform(node, edit.value);
+        markFaceNeighborsDirty(bounds);
+        return;
+    }
+
+    if (isLeaf(node) && !(flags[node] & NODE_FLAG_BRICK)) {
+        const uint32_t newValue = edit.apply(payload[node]);
+        if (newValue == payload[node]) return;
+        if (coverage == RegionCoverage::Full && canBeUniform(bounds.level, newValue)) {
+            payload[node] = newValue;
+            markDirty(node);
+            markFaceNeighborsDirty(bounds);
+            return;
+        }
+    }
+
+    if (bounds.level >= brickLevel) {
+        editBrick(node, bounds, edit);
+        return;
+    }
+
+    subdivide(node);
+
+    uint8_t mask = 0;
+    for (uint32_t i = 0; i < 8; ++i) {
+        const NodeIndex child = childBase[node] + i;
+
+        // Air-only children cannot contain the type being replaced
+        const bool skip = edit.replaceOnly && edit.fromType != 0 && !(childMask[node] & (1 << i));
+        if (!skip) {
+            editRegion(child, getChildBounds(bounds, i), edit);
+        }
+        if (mayHoldSolid(child)) {
+            mask |= (1 << i);
+        }
+    }
+    childMask[node] = mask;
+    markDirty(node);
+
+    // Children that ended up identical merge right away, as long as the result may be uniform
+    if (isCollapsible(node) && canBeUniform(bounds.level, payload[childBase[node]])) {
+        collapse(node);
+    }
+}
+
+void FlatOctree::editBrick(NodeIndex node, const NodeBounds& bounds, const RegionEdit& edit) {
+    if (!(flags[node] & NODE_FLAG_BRICK)) {
+        payload[node] = bricks.allocate(bounds.position, payload[node]);
+        flags[node] = (flags[node] & ~NODE_FLAG_UNIFORM) | NODE_FLAG_BRICK;
+        brickMap.insert(brickKey(bounds.position - origin), node);
+    }
+
+    // Clip the shape's bounds to the brick
+    const glm::ivec3 brickMax = bounds.position + glm::ivec3(bounds.size - 1);
+    glm::ivec3 lo, hi;
+    for (int axis = 0; axis < 3; ++axis) {
+        lo[axis] = std::max(bounds.position[axis], edit.min[axis]);
+        hi[axis] = std::min(brickMax[axis], edit.max[axis]);
+    }
+
+    Brick& brick = bricks.get(payload[node]);
+    bool changed = false;
+
+    // Fills write one x-run per row, clipped to the sphere analytically
+    if (!edit.replaceOnly) {
+        for (int z = lo.z; z <= hi.z; ++z) {
+            for (int y = lo.y; y <= hi.y; ++y) {
+                int x0 = lo.x;
+                int x1 = hi.x;
+                if (edit.isSphere) {
+                    const int64_t dy = int64_t(y) - edit.center.y;
+                    const int64_t dz = int64_t(z) - edit.center.z;
+                    const int64_t remaining = edit.radiusSq - dy * dy - dz * dz;
+                    if (remaining < 0) continue;
+
+                    int64_t extent = static_cast<int64_t>(std::sqrt(static_cast<double>(remaining)));
+                    while (extent * extent > remaining) extent--;
+                    while ((extent + 1) * (extent + 1) <= remaining) extent++;
+                    x0 = static_cast<int>(std::max<int64_t>(x0, edit.center.x - extent));
+                    x1 = static_cast<int>(std::min<int64_t>(x1, edit.center.x + extent));
+                    if (x0 > x1) continue;
+                }
+
+                const uint32_t first = bricks.localIndex(glm::ivec3(x0, y, z) - bounds.position);
+                changed |= brick.fillRun(first, static_cast<uint32_t>(x1 - x0 + 1), edit.value);
+            }
+        }
+
+        if (changed) {
+            markDirty(node);
+            markFaceNeighborsDirty(bounds);
+        }
+        compactBrick(node);
+        return;
+    }
+
+    // Replacements depend on each old voxel, edit a decoded copy and re-encode once
+    brickScratch.resize(bricks.getVoxelsPerBrick());
+    brick.decode(brickScratch.data());
+
+    for (int z = lo.z; z <= hi.z; ++z) {
+        for (int y = lo.y; y <= hi.y; ++y) {
+            for (int x = lo.x; x <= hi.x; ++x) {
+                const glm::ivec3 p(x, y, z);
+                if (!edit.contains(p)) continue;
+
+                uint32_t& voxel = brickScratch[bricks.localIndex(p - bounds.position)];
+                const uint32_t value = edit.apply(voxel);
+                changed |= value != voxel;
+                voxel = value;
+            }
+        }
+    }
+
+    if (changed) {
+        brick.encode(brickScratch.data());
+        markDirty(node);
+        markFaceNeighborsDirty(bounds);
+    }
+    compactBrick(node);
+}
+
+void FlatOctree::makeUniform(NodeIndex node, uint32_t value) {
+    releaseSubtree(node);
+    payload[node] = value;
+    childMask[node] = 0;
+    flags[node] = (flags[node] & ~NODE_FLAG_BRICK) | NODE_FLAG_UNIFORM;
+    markDirty(node);
+}
+
+bool FlatOctree::mayHoldSolid(NodeIndex node) const {
+    if (flags[node] & NODE_FLAG_BRICK) return true;
+    if (childBase[node] != INVALID_NODE) return childMask[node] != 0;
+    return payload[node] != 0;
+}
+
+void FlatOctree::markNeighborsDirty(const glm::ivec3& pos) {
+    // Only voxels on a brick face change the geometry of the brick next to them
+    const uint32_t brickMask = bricks.getBrickSize() - 1;
+    const glm::ivec3 localPos = pos - origin;
+    for (int axis = 0; axis < 3; ++axis) {
+        const uint32_t local = static_cast<uint32_t>(localPos[axis]) & brickMask;
+        if (local == 0) {
+            glm::ivec3 neighbor = pos;
+            neighbor[axis]--;
+            markLeafDirty(neighbor);
+        }
+        if (local == brickMask) {
+            glm::ivec3 neighbor = pos;
+            neighbor[axis]++;
+            markLeafDirty(neighbor);
+        }
+    }
+}
+
+void FlatOctree::markFaceNeighborsDirty(const NodeBounds& bounds) {
+    const glm::ivec3 nodeMin = bounds.position;
+    const glm::ivec3 nodeMax = bounds.position + glm::ivec3(bounds.size - 1);
+    for (int axis = 0; axis < 3; ++axis) {
+        for (int side = 0; side < 2; ++side) {
+            // One voxel thick slab just outside this face
+            glm::ivec3 slabMin = nodeMin;
+            glm::ivec3 slabMax = nodeMax;
+            slabMin[axis] = slabMax[axis] = side == 0 ? nodeMin[axis] - 1 : nodeMax[axis] + 1;
+
+            // Nothing is smaller than a brick, so a brick-sized face has a single neighbor leaf
+            if (bounds.size <= bricks.getBrickSize()) {
+                markLeafDirty(slabMin);
+            } else {
+                markLeavesDirty(0, getRootBounds(), slabMin, slabMax);
+            }
+        }
+    }
+}
+
+void FlatOctree::markLeafDirty(const glm::ivec3& pos) {
+    const NodeIndex leaf = findLeaf(pos);
+    if (leaf != INVALID_NODE && mayHoldSolid(leaf)) {
+        markDirty(leaf);
+    }
+}
+
+void FlatOctree::markLeavesDirty(NodeIndex node, const NodeBounds& bounds,
+                                 const glm::ivec3& min, const glm::ivec3& max) {
+    for (int axis = 0; axis < 3; ++axis) {
+        if (bounds.position[axis] > max[axis] ||
+            int64_t(bounds.position[axis]) + bounds.size <= min[axis]) {
+            return;
+        }
+    }
+
+    if (isLeaf(node)) {
+        if (mayHoldSolid(node)) markDirty(node);
+        return;
+    }
+
+    // Air-only children have no geometry to update
+    for (uint32_t i = 0; i < 8; ++i) {
+        if (childMask[node] & (1 << i)) {
+            markLeavesDirty(childBase[node] + i, getChildBounds(bounds, i), min, max);
+        }
+    }
+}
+
+void FlatOctree::releaseEmptyBrick(NodeIndex node) {
+    releaseBrick(node, 0);
+    updateParentMask(node);
+}
+
+void FlatOctree::updateParentMask(NodeIndex node) {
+    const NodeIndex parent = getParent(node);
+    if (parent == INVALID_NODE) return;
+
+    const uint8_t bit = static_cast<uint8_t>(1 << ((node - 1) & 7));
+    if (mayHoldSolid(node)) {
+        childMask[parent] |= bit;
+    } else {
+        childMask[parent] &= ~bit;
+    }
+}
+
+void FlatOctree::sortByMorton(const glm::ivec3* positions, size_t count,
+                              std::vector<std::pair<uint64_t, uint32_t>>& order) const {
+    order.clear();
+    order.reserve(count);
+    for (size_t i = 0; i < count; ++i) {
+        if (contains(positions[i])) {
+            order.emplace_back(mortonEncode(positions[i] - origin), static_cast<uint32_t>(i));
+        }
+    }
+
+    // Ties keep input order through the index, so later duplicates are applied last
+    std::sort(order.begin(), order.end());
+}
+
+} // namespace voxceleron
@@ -0,0 +1,217 @@
+#pragma once
+
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include <glm/glm.hpp>
+#include "Brick.h"
+#include "BrickMap.h"
+#include "Morton.h"
+
+namespace voxceleron {
+
+// Index of a node inside a FlatOctree (0 = root)
+using NodeIndex = uint32_t;
+static constexpr NodeIndex INVALID_NODE = 0xFFFFFFFFu;
+
+// Per-node flag bits
+enum NodeFlags : uint8_t {
+    NODE_FLAG_NONE      = 0,
+    NODE_FLAG_UNIFORM   = 1 << 0,  // Leaf was collapsed, payload fills the whole node (isOptimized)
+    NODE_FLAG_DIRTY     = 1 << 1,  // Node needs a mesh update (needsUpdate)
+    NODE_FLAG_BRICK     = 1 << 2,  // Leaf at brick level, payload is a BrickPool id
+    NODE_FLAG_QUEUED    = 1 << 3,  // Waiting in the collapse queue
+};
+
+// Spatial extent of a node. Not stored per node, derived while walking down from the root.
+struct NodeBounds {
+    glm::ivec3 position{0};  // Minimum corner in world space
+    uint32_t size{0};        // Edge length (power of 2)
+    uint32_t level{0};       // Depth in the octree (0 = root)
+};
+
+// Pointer-free sparse voxel octree.
+//
+// Nodes live in parallel arrays indexed by NodeIndex. Children of a node are
+// allocated as a contiguous group of 8 starting at childBase, and childMask marks
+// which of those children may hold anything other than air. Leaves have no child group
+// and store a packed voxel in payload that covers their whole extent, except at brick
+// level where a mixed leaf stores the id of a palette-compressed Brick instead. The tree never
+// subdivides below brick level. Brick leaves are also indexed by the Morton code of
+// their brick coordinate, so point queries that land in a brick skip the descent.
+//
+// Point edits queue the node they wrote. collapsePending() later walks up from just those
+// nodes, turning uniform bricks into plain leaves and merging eight equal leaves into
+// their parent, so no full-tree sweep is needed to keep the tree compact. Writes into a
+// collapsed region split it again on demand.
+//
+// Per-node header: childBase (4) + payload (4) + childMask (1) + flags (1) = 10 bytes,
+// plus one parent index per group of 8.
+class FlatOctree {
+public:
+    static constexpr size_t NODE_HEADER_SIZE =
+        sizeof(uint32_t) + sizeof(uint32_t) + sizeof(uint8_t) + sizeof(uint8_t);
+
+    FlatOctree(uint32_t maxLevel, const glm::ivec3& origin, uint32_t brickSizeLog2 = DEFAULT_BRICK_SIZE_LOG2);
+    ~FlatOctree() = default;
+
+    // Reset to a single empty root leaf
+    void clear();
+
+    // Root access
+    NodeIndex getRoot() const { return 0; }
+    NodeBounds getRootBounds() const;
+    uint32_t getMaxLevel() const { return maxLevel; }
+    uint32_t getBrickLevel() const { return brickLevel; }
+    bool contains(const glm::ivec3& pos) const;
+
+    // Node accessors
+    bool isLeaf(NodeIndex node) const { return childBase[node] == INVALID_NODE; }
+    uint8_t getChildMask(NodeIndex node) const { return childMask[node]; }
+    NodeIndex getChild(NodeIndex node, uint32_t i) const { return childBase[node] + i; }
+    NodeIndex getParent(NodeIndex node) const { return node == 0 ? INVALID_NODE : groupParent[groupOf(node)]; }
+    uint32_t getPayload(NodeIndex node) const { return payload[node]; }
+    bool isUniform(NodeIndex node) const { return (flags[node] & NODE_FLAG_UNIFORM) != 0; }
+    bool isDirty(NodeIndex node) const { return (flags[node] & NODE_FLAG_DIRTY) != 0; }
+    NodeBounds getBounds(NodeIndex node) const;  // Walks up through the parents, O(depth)
+    bool isBrick(NodeIndex node) const { return (flags[node] & NODE_FLAG_BRICK) != 0; }
+    void setDirty(NodeIndex node, bool dirty);
+    static NodeBounds getChildBounds(const NodeBounds& parent, uint32_t i);
+
+    // Point queries
+    NodeIndex findLeaf(const glm::ivec3& pos, NodeBounds* bounds = nullptr) const;
+    NodeIndex findBrick(const glm::ivec3& pos) const;  // Brick leaf containing pos or INVALID_NODE
+    uint32_t getValue(const glm::ivec3& pos) const;
+
+    // Point edits, splitting leaves down to brick level and converting the brick-level
+    // leaf to a brick as needed.
+    // Returns the leaf that was written or INVALID_NODE if pos is outside the octree.
+    NodeIndex setValue(const glm::ivec3& pos, uint32_t value);
+
+    // Batched edits and queries. Inputs are visited in Morton order so consecutive
+    // voxels share a brick, each brick is resolved once per run and marked dirty once.
+    // setValues applies duplicates in input order (last write wins), positions outside
+    // the octree are skipped and read back as air.
+    void setValues(const glm::ivec3* positions, const uint32_t* values, size_t count);
+    void getValues(const glm::ivec3* positions, uint32_t* values, size_t count) const;
+
+    // Copy a leaf's voxels into out with a one voxel border read from its face neighbours,
+    // (size + 2)^3 values laid out as (x+1) + (y+1)*p + (z+1)*p*p with p = size + 2.
+    // Edge and corner cells of the border are left as air, meshers only look across faces.
+    void readVolumeWithBorder(NodeIndex leaf, const NodeBounds& bounds, uint32_t* out) const;
+
+    // Region edits. Nodes entirely inside the region become a single uniform leaf (or get
+    // their payload rewritten), only nodes straddling the boundary are split, and only
+    // bricks crossed by the boundary are edited voxel by voxel. Box corners are inclusive.
+    // Solid values are stored no coarser than brick size, see canBeUniform.
+    void fillBox(const glm::ivec3& min, const glm::ivec3& max, uint32_t value);
+    void fillSphere(const glm::ivec3& center, float radius, uint32_t value);
+    void replaceType(const glm::ivec3& min, const glm::ivec3& max, uint32_t fromType, uint32_t value);
+
+    // Structure edits
+    bool subdivide(NodeIndex node);         // Leaf -> 8 children inheriting its payload
+    bool collapse(NodeIndex node);          // Internal node with 8 equal leaf children -> uniform leaf
+    bool isCollapsible(NodeIndex node) const;
+    // Whether a leaf at level may hold value uniformly. Meshes cover at most a brick, so
+    // only air is stored in leaves above brick level.
+    bool canBeUniform(uint32_t level, uint32_t value) const { return level >= brickLevel || (value & 0xFF) == 0; }
+    bool compactBrick(NodeIndex node);      // Brick leaf whose voxels are all equal -> uniform leaf
+
+    // Collapse homogeneous subtrees above nodes edited since the last call.
+    // Returns the number of nodes merged away.
+    size_t collapsePending();
+    size_t getPendingCollapseCount() const { return collapseQueue.size(); }
+
+    // Brick storage
+    BrickPool& getBricks() { return bricks; }
+    const BrickPool& getBricks() const { return bricks; }
+    size_t getBrickMapSize() const { return brickMap.size(); }
+
+    // Nodes that became dirty since the last call, including leaves next to an edit whose
+    // border faces changed. May hold duplicates and nodes that were cleaned or released
+    // since, check isDirty() before use.
+    void takeDirtyNodes(std::vector<NodeIndex>& out);
+
+    // Child groups released since the last call, for owners that key data by NodeIndex
+    void takeReleasedGroups(std::vector<NodeIndex>& out);
+
+    // Statistics
+    size_t getNodeCount() const { return childBase.size() - freeGroups.size() * 8; }
+    size_t getMemoryUsage() const;
+
+private:
+    uint32_t maxLevel;
+    uint32_t brickLevel;
+    glm::ivec3 origin;
+    BrickPool bricks;
+    BrickMap brickMap;  // Morton code of brick coordinate -> brick leaf
+
+    // Hot per-node data, kept as parallel arrays so walks only touch what they need
+    std::vector<uint32_t> childBase;  // First child of the group, INVALID_NODE for leaves
+    std::vector<uint8_t> childMask;   // Bit i set if child i may hold non-air data
+    std::vector<uint8_t> flags;       // NodeFlags
+    std::vector<uint32_t> payload;    // Packed voxel covering the whole leaf, or brick id
+    std::vector<NodeIndex> groupParent;  // Owner of each child group, indexed by groupOf()
+
+    // Released child groups, reused before growing the arrays
+    std::vector<NodeIndex> freeGroups;
+    std::vector<NodeIndex> releasedGroups;  // Released since the last takeReleasedGroups()
+    std::vector<uint32_t> brickScratch;     // Decoded brick reused by region edits
+    std::vector<NodeIndex> collapseQueue;   // Nodes flagged NODE_FLAG_QUEUED
+    std::vector<NodeIndex> dirtyNodes;      // Nodes flagged NODE_FLAG_DIRTY since the last take
+
+    struct RegionEdit;
+    void editRegion(NodeIndex node, const NodeBounds& bounds, const RegionEdit& edit);
+    void editBrick(NodeIndex node, const NodeBounds& bounds, const RegionEdit& edit);
+    void makeUniform(NodeIndex node, uint32_t value);
+    bool mayHoldSolid(NodeIndex node) const;
+
+    // Groups start right after the root, so node n belongs to group (n - 1) / 8
+    static uint32_t groupOf(NodeIndex node) { return (node - 1) >> 3; }
+
+    NodeIndex allocateGroup();
+    void releaseGroup(NodeIndex base);
+    void releaseSubtree(NodeIndex node);
+    void releaseBrick(NodeIndex node, uint32_t value);
+    void releaseEmptyBrick(NodeIndex node);
+    void updateParentMask(NodeIndex node);
+    void markDirty(NodeIndex node) {
+        if (!(flags[node] & NODE_FLAG_DIRTY)) {
+            flags[node] |= NODE_FLAG_DIRTY;
+            dirtyNodes.push_back(node);
+        }
+    }
+    void markNeighborsDirty(const glm::ivec3& pos);
+    void markFaceNeighborsDirty(const NodeBounds& bounds);
+    void markLeafDirty(const glm::ivec3& pos);
+    void markLeavesDirty(NodeIndex node, const NodeBounds& bounds, const glm::ivec3& min, const glm::ivec3& max);
+    void queueCollapse(NodeIndex node) {
+        if (!(flags[node] & NODE_FLAG_QUEUED)) {
+            flags[node] |= NODE_FLAG_QUEUED;
+            collapseQueue.push_back(node);
+        }
+    }
+    bool isEmptyBrick(NodeIndex node) const {
+        // Air voxels may still carry a color, only an all-zero brick can be dropped
+        uint32_t value;
+        return bricks.isUniform(payload[node], value) && value == 0;
+    }
+    void sortByMorton(const glm::ivec3* positions, size_t count,
+                      std::vector<std::pair<uint64_t, uint32_t>>& order) const;
+
+    uint64_t brickKey(const glm::ivec3& localPos) const {
+        return mortonEncode(localPos >> static_cast<int>(maxLevel - brickLevel));
+    }
+    NodeIndex findBrickLocal(const glm::ivec3& localPos) const {
+        return brickMap.find(brickKey(localPos));
+    }
+
+    uint32_t childIndexFor(const glm::ivec3& localPos, uint32_t level) const {
+        const uint32_t shift = maxLevel - level - 1;
+        return ((localPos.x >> shift) & 1) |
+              (((localPos.y >> shift) & 1) << 1) |
+              (((localPos.z >> shift) & 1) << 2);
+    }
+};
+
+} // namespace voxceleron
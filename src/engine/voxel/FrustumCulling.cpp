@@ -0,0 +1,160 @@
+#include "FrustumCulling.h"
+#include <cmath>
+
+#if defined(__AVX2__)
+#define FRUSTUM_CULLING_AVX2
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define FRUSTUM_CULLING_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace voxceleron {
+
+namespace {
+
+// Plane normal, its absolute value for projecting extents, and distance
+struct PlaneTerms {
+    float nx, ny, nz;
+    float ax, ay, az;
+    float w;
+};
+
+FrustumTest combine(uint32_t outside, uint32_t inside) {
+    return outside ? FRUSTUM_OUTSIDE : (inside ? FRUSTUM_INSIDE : FRUSTUM_INTERSECTS);
+}
+
+#if defined(FRUSTUM_CULLING_AVX2) || defined(FRUSTUM_CULLING_SSE2)
+// Packs the lane masks of eight boxes into FrustumTest bytes. A set mask is -1, so
+// 1 - inside is INTERSECTS or INSIDE, and outside clears it to OUTSIDE.
+void storeResults(__m128i outsideLow, __m128i insideLow, __m128i outsideHigh, __m128i insideHigh, FrustumTest* results) {
+    const __m128i one = _mm_set1_epi32(1);
+    const __m128i low = _mm_andnot_si128(outsideLow, _mm_sub_epi32(one, insideLow));
+    const __m128i high = _mm_andnot_si128(outsideHigh, _mm_sub_epi32(one, insideHigh));
+    const __m128i bytes = _mm_packus_epi16(_mm_packs_epi32(low, high), _mm_setzero_si128());
+    _mm_storel_epi64(reinterpret_cast<__m128i*>(results), bytes);
+}
+#endif
+
+#if defined(FRUSTUM_CULLING_SSE2)
+// Plane terms broadcast to every lane
+struct PlaneLanes {
+    __m128 nx, ny, nz, ax, ay, az, w;
+};
+
+// Four boxes starting at i, returns the outside and inside lane masks
+void classifyFour(const PlaneLanes (&planes)[6], const FrustumBoxes& boxes, size_t i, __m128 margin,
+                  __m128i& outsideMask, __m128i& insideMask) {
+    const __m128 cx = _mm_loadu_ps(boxes.centerX + i);
+    const __m128 cy = _mm_loadu_ps(boxes.centerY + i);
+    const __m128 cz = _mm_loadu_ps(boxes.centerZ + i);
+    const __m128 ex = _mm_mul_ps(_mm_loadu_ps(boxes.extentX + i), margin);
+    const __m128 ey = _mm_mul_ps(_mm_loadu_ps(boxes.extentY + i), margin);
+    const __m128 ez = _mm_mul_ps(_mm_loadu_ps(boxes.extentZ + i), margin);
+
+    __m128 outside = _mm_setzero_ps();
+    __m128 inside = _mm_castsi128_ps(_mm_set1_epi32(-1));
+    for (const PlaneLanes& plane : planes) {
+        const __m128 distance = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(plane.nx, cx), _mm_mul_ps(plane.ny, cy)),
+            _mm_add_ps(_mm_mul_ps(plane.nz, cz), plane.w));
+        const __m128 radius = _mm_add_ps(
+            _mm_add_ps(_mm_mul_ps(plane.ax, ex), _mm_mul_ps(plane.ay, ey)),
+            _mm_mul_ps(plane.az, ez));
+        outside = _mm_or_ps(outside, _mm_cmplt_ps(distance, _mm_sub_ps(_mm_setzero_ps(), radius)));
+        inside = _mm_and_ps(inside, _mm_cmpge_ps(distance, radius));
+    }
+    outsideMask = _mm_castps_si128(outside);
+    insideMask = _mm_castps_si128(inside);
+}
+#endif
+
+} // namespace
+
+void classifyBoxes(const Camera::Frustum& frustum, const FrustumBoxes& boxes, float margin, FrustumTest* results) {
+    PlaneTerms planes[6];
+    for (int p = 0; p < 6; ++p) {
+        const glm::vec4& plane = frustum.planes[p];
+        planes[p] = {plane.x, plane.y, plane.z, std::abs(plane.x), std::abs(plane.y), std::abs(plane.z), plane.w};
+    }
+
+    size_t i = 0;
+#if defined(FRUSTUM_CULLING_AVX2)
+    struct PlaneLanes {
+        __m256 nx, ny, nz, ax, ay, az, w;
+    } lanes[6];
+    for (int p = 0; p < 6; ++p) {
+        lanes[p] = {_mm256_set1_ps(planes[p].nx), _mm256_set1_ps(planes[p].ny), _mm256_set1_ps(planes[p].nz),
+                    _mm256_set1_ps(planes[p].ax), _mm256_set1_ps(planes[p].ay), _mm256_set1_ps(planes[p].az),
+                    _mm256_set1_ps(planes[p].w)};
+    }
+    const __m256 marginScale = _mm256_set1_ps(margin);
+    for (; i + 8 <= boxes.count; i += 8) {
+        const __m256 cx = _mm256_loadu_ps(boxes.centerX + i);
+        const __m256 cy = _mm256_loadu_ps(boxes.centerY + i);
+        const __m256 cz = _mm256_loadu_ps(boxes.centerZ + i);
+        const __m256 ex = _mm256_mul_ps(_mm256_loadu_ps(boxes.extentX + i), marginScale);
+        const __m256 ey = _mm256_mul_ps(_mm256_loadu_ps(boxes.extentY + i), marginScale);
+        const __m256 ez = _mm256_mul_ps(_mm256_loadu_ps(boxes.extentZ + i), marginScale);
+
+        __m256 outside = _mm256_setzero_ps();
+        __m256 inside = _mm256_castsi256_ps(_mm256_set1_epi32(-1));
+        for (const auto& plane : lanes) {
+            const __m256 distance = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(plane.nx, cx), _mm256_mul_ps(plane.ny, cy)),
+                _mm256_add_ps(_mm256_mul_ps(plane.nz, cz), plane.w));
+            const __m256 radius = _mm256_add_ps(
+                _mm256_add_ps(_mm256_mul_ps(plane.ax, ex), _mm256_mul_ps(plane.ay, ey)),
+                _mm256_mul_ps(plane.az, ez));
+            outside = _mm256_or_ps(outside, _mm256_cmp_ps(distance, _mm256_sub_ps(_mm256_setzero_ps(), radius), _CMP_LT_OQ));
+            inside = _mm256_and_ps(inside, _mm256_cmp_ps(distance, radius, _CMP_GE_OQ));
+        }
+
+        const __m256i outsideMask = _mm256_castps_si256(outside);
+        const __m256i insideMask = _mm256_castps_si256(inside);
+        storeResults(_mm256_castsi256_si128(outsideMask), _mm256_castsi256_si128(insideMask),
+                     _mm256_extracti128_si256(outsideMask, 1), _mm256_extracti128_si256(insideMask, 1), results + i);
+    }
+#elif defined(FRUSTUM_CULLING_SSE2)
+    // Two independent groups per iteration keep both halves of eight boxes in flight
+    PlaneLanes lanes[6];
+    for (int p = 0; p < 6; ++p) {
+        lanes[p] = {_mm_set1_ps(planes[p].nx), _mm_set1_ps(planes[p].ny), _mm_set1_ps(planes[p].nz),
+                    _mm_set1_ps(planes[p].ax), _mm_set1_ps(planes[p].ay), _mm_set1_ps(planes[p].az),
+                    _mm_set1_ps(planes[p].w)};
+    }
+    const __m128 marginScale = _mm_set1_ps(margin);
+    for (; i + 8 <= boxes.count; i += 8) {
+        __m128i outsideLow, insideLow, outsideHigh, insideHigh;
+        classifyFour(lanes, boxes, i, marginScale, outsideLow, insideLow);
+        classifyFour(lanes, boxes, i + 4, marginScale, outsideHigh, insideHigh);
+        storeResults(outsideLow, insideLow, outsideHigh, insideHigh, results + i);
+    }
+#endif
+    for (; i < boxes.count; ++i) {
+        const float ex = boxes.extentX[i] * margin;
+        const float ey = boxes.extentY[i] * margin;
+        const float ez = boxes.extentZ[i] * margin;
+        uint32_t outside = 0;
+        uint32_t inside = 1;
+        for (const PlaneTerms& plane : planes) {
+            const float distance = plane.nx * boxes.centerX[i] + plane.ny * boxes.centerY[i] + plane.nz * boxes.centerZ[i] + plane.w;
+            const float radius = plane.ax * ex + plane.ay * ey + plane.az * ez;
+            outside |= distance < -radius;
+            inside &= distance >= radius;
+        }
+        results[i] = combine(outside, inside);
+    }
+}
+
+const char* getFrustumCullingIsa() {
+#if defined(FRUSTUM_CULLING_AVX2)
+    return "avx2";
+#elif defined(FRUSTUM_CULLING_SSE2)
+    return "sse2";
+#else
+    return "scalar";
+#endif
+}
+
+} // namespace voxceleron
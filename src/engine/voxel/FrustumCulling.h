@@ -0,0 +1,37 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "../core/Camera.h"
+
+namespace voxceleron {
+
+// Outcome of a box against all six frustum planes
+enum FrustumTest : uint8_t {
+    FRUSTUM_OUTSIDE     = 0,  // Behind at least one plane
+    FRUSTUM_INTERSECTS  = 1,  // Straddles a plane, children need their own test
+    FRUSTUM_INSIDE      = 2,  // In front of every plane, so is everything it contains
+};
+
+// Axis-aligned boxes in structure-of-arrays form, centers and half extents. Each array
+// holds count floats, no alignment is required.
+struct FrustumBoxes {
+    const float* centerX;
+    const float* centerY;
+    const float* centerZ;
+    const float* extentX;
+    const float* extentY;
+    const float* extentZ;
+    size_t count;
+};
+
+// Classifies every box against the frustum, writing one FrustumTest per box. Extents are
+// scaled by margin first (1.0 = exact). A box is projected onto each plane normal, so the
+// test is exact per plane rather than using a bounding sphere. Kernels test eight boxes
+// per iteration with AVX2, or two groups of four with SSE2, when the build targets them.
+void classifyBoxes(const Camera::Frustum& frustum, const FrustumBoxes& boxes, float margin, FrustumTest* results);
+
+// Instruction set the frustum kernels were compiled for: "avx2", "sse2" or "scalar"
+const char* getFrustumCullingIsa();
+
+} // namespace voxceleron
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace voxceleron {
+
+// Fixed-size object pool with O(1) allocate and deallocate.
+//
+// Slots are carved out of blocks of BlockSize objects. A block is allocated aligned
+// to its own (power of two) byte size, so the header of the block owning any slot is
+// found by masking the slot address. Freed slots are threaded onto an intrusive free
+// list stored inside the slots themselves. Blocks are only returned to the system
+// when the pool is destroyed.
+//
+// allocate()/deallocate() take a mutex.
+template<typename T, size_t BlockSize = 4096>
+class MemoryPool {
+    struct FreeSlot {
+        FreeSlot* next;
+    };
+
+    struct BlockHeader {
+        MemoryPool* owner;
+        size_t liveCount;
+    };
+
+    static constexpr size_t SLOT_ALIGN = alignof(T) > alignof(FreeSlot) ? alignof(T) : alignof(FreeSlot);
+    static constexpr size_t SLOT_SIZE =
+        ((sizeof(T) > sizeof(FreeSlot) ? sizeof(T) : sizeof(FreeSlot)) + SLOT_ALIGN - 1) & ~(SLOT_ALIGN - 1);
+    static constexpr size_t HEADER_SIZE = (sizeof(BlockHeader) + SLOT_ALIGN - 1) & ~(SLOT_ALIGN - 1);
+
+    static constexpr size_t nextPowerOfTwo(size_t value) {
+        size_t result = 1;
+        while (result < value) result <<= 1;
+        return result;
+    }
+
+public:
+    static constexpr size_t BLOCK_BYTES = nextPowerOfTwo(HEADER_SIZE + BlockSize * SLOT_SIZE);
+
+    MemoryPool() = default;
+    ~MemoryPool() {
+        assert(liveCount == 0 && "MemoryPool destroyed with live objects");
+        for (BlockHeader* block : blocks) {
+            ::operator delete(block, std::align_val_t(BLOCK_BYTES));
+        }
+    }
+
+    MemoryPool(const MemoryPool&) = delete;
+    MemoryPool& operator=(const MemoryPool&) = delete;
+
+    // Raw slots
+    void* allocate() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return allocateLocked();
+    }
+
+    void deallocate(void* ptr) {
+        std::lock_guard<std::mutex> lock(mutex);
+        deallocateLocked(ptr);
+    }
+
+    // Constructed objects
+    template<typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate()) T(std::forward<Args>(args)...);
+    }
+
+    void destroy(T* object) {
+        if (!object) return;
+        object->~T();
+        deallocate(object);
+    }
+
+    // Statistics
+    size_t getLiveCount() const { return liveCount; }
+    size_t getBlockCount() const { return blocks.size(); }
+    size_t getMemoryUsage() const {
+        return blocks.size() * BLOCK_BYTES + blocks.capacity() * sizeof(BlockHeader*);
+    }
+
+private:
+    std::mutex mutex;
+    std::vector<BlockHeader*> blocks;
+    FreeSlot* freeList{nullptr};
+    char* bumpCursor{nullptr};  // Untouched slots of the newest block
+    char* bumpEnd{nullptr};
+    size_t liveCount{0};
+
+    static BlockHeader* blockOf(const void* ptr) {
+        return reinterpret_cast<BlockHeader*>(reinterpret_cast<uintptr_t>(ptr) & ~uintptr_t(BLOCK_BYTES - 1));
+    }
+
+    void* allocateLocked() {
+        void* slot;
+        if (freeList) {
+            slot = freeList;
+            freeList = freeList->next;
+        } else {
+            if (bumpCursor == bumpEnd) {
+                addBlock();
+            }
+            slot = bumpCursor;
+            bumpCursor += SLOT_SIZE;
+        }
+
+        blockOf(slot)->liveCount++;
+        liveCount++;
+        return slot;
+    }
+
+    void deallocateLocked(void* ptr) {
+        BlockHeader* block = blockOf(ptr);
+        assert(block->owner == this && "Pointer does not belong to this MemoryPool");
+        block->liveCount--;
+        liveCount--;
+
+        FreeSlot* slot = static_cast<FreeSlot*>(ptr);
+        slot->next = freeList;
+        freeList = slot;
+    }
+
+    void addBlock() {
+        void* memory = ::operator new(BLOCK_BYTES, std::align_val_t(BLOCK_BYTES));
+        BlockHeader* block = new (memory) BlockHeader{this, 0};
+        blocks.push_back(block);
+
+        bumpCursor = static_cast<char*>(memory) + HEADER_SIZE;
+        bumpEnd = bumpCursor + BlockSize * SLOT_SIZE;
+    }
+};
+
+} // namespace voxceleron
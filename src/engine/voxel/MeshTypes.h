@@ -2,57 +2,142 @@
 
 #include <vulkan/vulkan.h>
 #include <vector>
-#include <memory>
 #include <glm/glm.hpp>
-#include <array>
+#include "../vulkan/core/BufferArena.h"
 
 namespace voxceleron {
 
-struct MeshData {
-    VkBuffer vertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory vertexMemory = VK_NULL_HANDLE;
-    VkBuffer indexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory indexMemory = VK_NULL_HANDLE;
-    uint32_t vertexCount = 0;
-    uint32_t indexCount = 0;
+// Bits per brick-local vertex coordinate. Quad corners of a 64 voxel node reach 64, one more than 6 bits hold.
+static constexpr uint32_t VERTEX_POSITION_BITS = 7;
+static constexpr uint32_t VERTEX_POSITION_MASK = (1u << VERTEX_POSITION_BITS) - 1;
+static constexpr uint32_t VERTEX_NORMAL_SHIFT = 3 * VERTEX_POSITION_BITS;
+static constexpr uint32_t VERTEX_OCCLUSION_SHIFT = VERTEX_NORMAL_SHIFT + 3;
+
+// Ambient occlusion of an unobstructed corner, 0 is fully occluded
+static constexpr uint32_t VERTEX_OCCLUSION_NONE = 3;
+
+// Vertex written by the mesh generators and consumed by basic.vert, 8 bytes instead of 32.
+// The first word holds the corner relative to the node origin, the face normal as an index
+// into +X, -X, +Y, -Y, +Z, -Z and two bits of ambient occlusion. The node origin is pushed
+// per draw and uvs follow from the position, so neither is stored.
+struct MeshVertex {
+    uint32_t position;  // x | y << 7 | z << 14 | normal << 21 | occlusion << 24
+    uint32_t voxel;     // Packed voxel of the face, color in the high 24 bits, type in the low 8
+
+    static MeshVertex pack(const glm::uvec3& local, uint32_t normal, uint32_t occlusion, uint32_t voxel) {
+        return {
+            (local.x & VERTEX_POSITION_MASK) |
+            ((local.y & VERTEX_POSITION_MASK) << VERTEX_POSITION_BITS) |
+            ((local.z & VERTEX_POSITION_MASK) << (2 * VERTEX_POSITION_BITS)) |
+            ((normal & 0x7) << VERTEX_NORMAL_SHIFT) |
+            ((occlusion & 0x3) << VERTEX_OCCLUSION_SHIFT),
+            voxel
+        };
+    }
+
+    glm::uvec3 getPosition() const {
+        return glm::uvec3(position & VERTEX_POSITION_MASK,
+                          (position >> VERTEX_POSITION_BITS) & VERTEX_POSITION_MASK,
+                          (position >> (2 * VERTEX_POSITION_BITS)) & VERTEX_POSITION_MASK);
+    }
+    uint32_t getNormal() const { return (position >> VERTEX_NORMAL_SHIFT) & 0x7; }
+    uint32_t getOcclusion() const { return (position >> VERTEX_OCCLUSION_SHIFT) & 0x3; }
 };
+static_assert(sizeof(MeshVertex) == 2 * sizeof(uint32_t), "MeshVertex must match the two word vertex stride");
+
+// Layout of a mesh's geometry
+enum class MeshFormat {
+    INDEXED,  // Four MeshVertex per quad plus a per-mesh index buffer
+    QUADS     // One MeshQuad per face, expanded by quad.vert from gl_VertexIndex
+};
+
+// Bits per quad cell coordinate and extent, quads start inside a node of at most 64 voxels
+static constexpr uint32_t QUAD_CELL_BITS = 6;
+static constexpr uint32_t QUAD_CELL_MASK = (1u << QUAD_CELL_BITS) - 1;
+static constexpr uint32_t QUAD_FACE_SHIFT = 3 * QUAD_CELL_BITS;
+static constexpr uint32_t QUAD_OCCLUSION_SHIFT = 2 * QUAD_CELL_BITS;
 
-// Forward declaration
-class OctreeNode;
+// One face rectangle, 12 bytes against four vertices and six indices. The vertex shader
+// rebuilds the corners with the same tables as the mesh generators.
+struct MeshQuad {
+    uint32_t cell;   // x | y << 6 | z << 12 | face << 18, minimum voxel covered by the quad
+    uint32_t shape;  // (width - 1) | (height - 1) << 6 | occlusion << 12, two bits per corner
+    uint32_t voxel;  // Packed voxel of the face
 
-struct LeafData {
-    std::vector<uint32_t> data;  // Packed voxel data
-    std::vector<uint8_t> runs;   // RLE compressed runs
+    // width runs along axis (face axis + 1) % 3, height along (face axis + 2) % 3
+    static MeshQuad pack(const glm::uvec3& cell, uint32_t face, uint32_t width, uint32_t height,
+                         const uint32_t occlusion[4], uint32_t voxel) {
+        uint32_t corners = 0;
+        for (uint32_t i = 0; i < 4; ++i) {
+            corners |= (occlusion[i] & 0x3) << (2 * i);
+        }
+        return {
+            (cell.x & QUAD_CELL_MASK) | ((cell.y & QUAD_CELL_MASK) << QUAD_CELL_BITS) |
+            ((cell.z & QUAD_CELL_MASK) << (2 * QUAD_CELL_BITS)) | ((face & 0x7) << QUAD_FACE_SHIFT),
+            ((width - 1) & QUAD_CELL_MASK) | (((height - 1) & QUAD_CELL_MASK) << QUAD_CELL_BITS) |
+            (corners << QUAD_OCCLUSION_SHIFT),
+            voxel
+        };
+    }
+
+    glm::uvec3 getCell() const {
+        return glm::uvec3(cell & QUAD_CELL_MASK, (cell >> QUAD_CELL_BITS) & QUAD_CELL_MASK,
+                          (cell >> (2 * QUAD_CELL_BITS)) & QUAD_CELL_MASK);
+    }
+    uint32_t getFace() const { return (cell >> QUAD_FACE_SHIFT) & 0x7; }
+    uint32_t getWidth() const { return (shape & QUAD_CELL_MASK) + 1; }
+    uint32_t getHeight() const { return ((shape >> QUAD_CELL_BITS) & QUAD_CELL_MASK) + 1; }
+    uint32_t getOcclusion(uint32_t corner) const { return (shape >> (QUAD_OCCLUSION_SHIFT + 2 * corner)) & 0x3; }
 };
+static_assert(sizeof(MeshQuad) == 3 * sizeof(uint32_t), "MeshQuad must match the three word quad stride");
+
+// Most faces a node of the given edge can expose: one per adjacent voxel pair plus its surface
+inline uint32_t getMaxQuadCount(uint32_t size) {
+    return 3 * size * size * (size + 1);
+}
+
+// 16-bit indices address every vertex of meshes up to this size
+static constexpr uint32_t MAX_UINT16_INDEXED_VERTICES = 1u << 16;
+
+inline VkIndexType selectIndexType(size_t vertexCount) {
+    return vertexCount <= MAX_UINT16_INDEXED_VERTICES ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32;
+}
+
+inline uint32_t getIndexSize(VkIndexType indexType) {
+    return indexType == VK_INDEX_TYPE_UINT16 ? sizeof(uint16_t) : sizeof(uint32_t);
+}
 
-struct InternalData {
-    std::array<std::unique_ptr<OctreeNode>, 8> children;
+// Face counts of generated meshes, quads against visible faces shows what merging saved
+struct MeshStats {
+    uint64_t visibleFaces = 0;  // Unit voxel faces that survived culling
+    uint64_t quads = 0;         // Quads emitted after merging, two triangles each
+
+    void add(const MeshStats& other) {
+        visibleFaces += other.visibleFaces;
+        quads += other.quads;
+    }
+    uint64_t getTriangleCount() const { return quads * 2; }
+    float getReduction() const {  // Fraction of triangles removed by merging
+        return visibleFaces > 0 ? 1.0f - static_cast<float>(quads) / static_cast<float>(visibleFaces) : 0.0f;
+    }
 };
 
-class OctreeNode {
-public:
-    glm::ivec3 position{0};      // Position in world space
-    uint32_t size{0};            // Size of this node (power of 2)
-    uint32_t level{0};           // Level in octree (0 = root)
-    bool isLeaf{true};           // Is this a leaf node?
-    bool needsUpdate{false};     // Does this node need mesh update?
-    bool isOptimized{false};     // Has this node been optimized?
-    uint32_t optimizedValue{0};  // Value for optimized nodes
-    uint8_t childMask{0};        // Bitmask of active children
-
-    // Mesh data
-    std::vector<MeshData> meshes;
-
-    // Node data (union to save memory)
-    union NodeData {
-        LeafData leaf;
-        InternalData internal;
-
-        NodeData() : leaf() {}  // Initialize as leaf data by default
-        ~NodeData() {}         // Empty destructor
-    } nodeData;
-
-    const std::vector<MeshData>& getMeshes() const { return meshes; }
+// Meshes live in the world's mesh arenas, the handles stay valid when compaction moves them.
+// INDEXED meshes hold MeshVertex records and 32-bit words of indices, 16-bit indices pack two
+// per word. QUADS meshes hold MeshQuad records and no indices, the counts describe the
+// expanded quads the renderer draws.
+struct MeshData {
+    MeshFormat format = MeshFormat::INDEXED;
+    BufferArena::Handle vertices = BufferArena::INVALID_HANDLE;  // MeshVertex or MeshQuad records
+    BufferArena::Handle indices = BufferArena::INVALID_HANDLE;
+    uint32_t vertexCount = 0;
+    uint32_t indexCount = 0;
+    VkIndexType indexType = VK_INDEX_TYPE_UINT32;
 };
 
+// Words of the index arena holding count indices of the given type
+inline uint32_t getIndexWordCount(uint32_t count, VkIndexType indexType) {
+    return indexType == VK_INDEX_TYPE_UINT16 ? (count + 1) / 2 : count;
+}
+
 } // namespace voxceleron
\ No newline at end of file
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstdint>
+#include <glm/glm.hpp>
+
+namespace voxceleron {
+
+// 3D Morton (Z-order) codes, 21 bits per axis interleaved as ...z1y1x1z0y0x0.
+// Coordinates must be non-negative, callers offset by the octree origin first.
+
+// Spread the low 21 bits of v so there are two zero bits between each of them
+inline uint64_t mortonSpread(uint32_t v) {
+    uint64_t x = v & 0x1FFFFF;
+    x = (x | (x << 32)) & 0x001F00000000FFFFull;
+    x = (x | (x << 16)) & 0x001F0000FF0000FFull;
+    x = (x | (x << 8))  & 0x100F00F00F00F00Full;
+    x = (x | (x << 4))  & 0x10C30C30C30C30C3ull;
+    x = (x | (x << 2))  & 0x1249249249249249ull;
+    return x;
+}
+
+// Inverse of mortonSpread
+inline uint32_t mortonCompact(uint64_t x) {
+    x &= 0x1249249249249249ull;
+    x = (x | (x >> 2))  & 0x10C30C30C30C30C3ull;
+    x = (x | (x >> 4))  & 0x100F00F00F00F00Full;
+    x = (x | (x >> 8))  & 0x001F0000FF0000FFull;
+    x = (x | (x >> 16)) & 0x001F00000000FFFFull;
+    x = (x | (x >> 32)) & 0x1FFFFF;
+    return static_cast<uint32_t>(x);
+}
+
+inline uint64_t mortonEncode(const glm::ivec3& p) {
+    return mortonSpread(static_cast<uint32_t>(p.x)) |
+           (mortonSpread(static_cast<uint32_t>(p.y)) << 1) |
+           (mortonSpread(static_cast<uint32_t>(p.z)) << 2);
+}
+
+inline glm::ivec3 mortonDecode(uint64_t code) {
+    return glm::ivec3(
+        static_cast<int>(mortonCompact(code)),
+        static_cast<int>(mortonCompact(code >> 1)),
+        static_cast<int>(mortonCompact(code >> 2))
+    );
+}
+
+} // namespace voxceleron
@@ -0,0 +1,261 @@
+#include "OcclusionBuffer.h"
+#include "World.h"
+#include <cfloat>
+#include <cmath>
+
+namespace voxceleron {
+
+namespace {
+
+// Corners closer to the eye than this are treated as crossing the near plane
+constexpr float MIN_CLIP_W = 1e-3f;
+
+bool isBoxInFrustum(const glm::vec3& min, const glm::vec3& max, const Camera::Frustum& frustum) {
+    const glm::vec3 center = (min + max) * 0.5f;
+    const glm::vec3 extent = (max - min) * 0.5f;
+    for (const glm::vec4& plane : frustum.planes) {
+        const float radius = glm::dot(extent, glm::abs(glm::vec3(plane)));
+        if (glm::dot(glm::vec3(plane), center) + plane.w < -radius) {
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+OcclusionBuffer::OcclusionBuffer()
+    : viewProjection(1.0f)
+    , depths(getPyramidSize(), FLT_MAX)
+    , levelOffsets{}
+    , levelCount(0) {
+    uint32_t offset = 0;
+    for (uint32_t level = 0; level < MAX_LEVELS; ++level) {
+        levelOffsets[level] = offset;
+        offset += getLevelWidth(level) * getLevelHeight(level);
+        levelCount = level + 1;
+        if (getLevelWidth(level) == 1 && getLevelHeight(level) == 1) break;
+    }
+}
+
+void OcclusionBuffer::build(const World& world, const glm::mat4& viewProjection, const Camera::Frustum& frustum,
+                            const glm::vec3& cameraPosition) {
+    this->viewProjection = viewProjection;
+    std::fill(depths.begin(), depths.end(), FLT_MAX);
+
+    occluders.clear();
+    const FlatOctree& octree = world.getOctree();
+    collectOccluders(world, octree.getRoot(), octree.getRootBounds(), frustum, cameraPosition);
+    if (occluders.size() > MAX_OCCLUDERS) {
+        std::nth_element(occluders.begin(), occluders.begin() + MAX_OCCLUDERS, occluders.end(),
+            [](const Occluder& a, const Occluder& b) { return a.score > b.score; });
+        occluders.resize(MAX_OCCLUDERS);
+    }
+
+    for (const Occluder& occluder : occluders) {
+        rasterizeBox(occluder, cameraPosition);
+    }
+    buildPyramid();
+}
+
+void OcclusionBuffer::clear() {
+    occluders.clear();
+    std::fill(depths.begin(), depths.end(), FLT_MAX);
+}
+
+bool OcclusionBuffer::isOccluded(const glm::vec3& min, const glm::vec3& max) const {
+    if (occluders.empty()) return false;
+
+    // Screen rectangle and nearest depth of the box. A box reaching behind the camera is
+    // never occluded, z / w grows with view depth, so the nearest point is a corner.
+    glm::vec2 rectMin(FLT_MAX);
+    glm::vec2 rectMax(-FLT_MAX);
+    float nearest = FLT_MAX;
+    for (uint32_t i = 0; i < 8; ++i) {
+        const glm::vec3 corner(i & 1 ? max.x : min.x, i & 2 ? max.y : min.y, i & 4 ? max.z : min.z);
+        glm::vec3 screen;
+        if (!project(corner, screen)) return false;
+        rectMin = glm::min(rectMin, glm::vec2(screen));
+        rectMax = glm::max(rectMax, glm::vec2(screen));
+        nearest = std::min(nearest, screen.z);
+    }
+
+    // Boxes off screen are left to frustum culling
+    const int x0 = std::max(static_cast<int>(std::floor(rectMin.x)), 0);
+    const int y0 = std::max(static_cast<int>(std::floor(rectMin.y)), 0);
+    const int x1 = std::min(static_cast<int>(std::floor(rectMax.x)), static_cast<int>(WIDTH) - 1);
+    const int y1 = std::min(static_cast<int>(std::floor(rectMax.y)), static_cast<int>(HEIGHT) - 1);
+    if (x0 > x1 || y0 > y1) return false;
+
+    // Coarsest level where the rectangle spans at most 2 x 2 texels
+    uint32_t level = 0;
+    while (level + 1 < levelCount && (((x1 >> level) - (x0 >> level)) > 1 || ((y1 >> level) - (y0 >> level)) > 1)) {
+        level++;
+    }
+
+    const uint32_t width = getLevelWidth(level);
+    const float* texels = depths.data() + levelOffsets[level];
+    for (int y = y0 >> level; y <= (y1 >> level); ++y) {
+        for (int x = x0 >> level; x <= (x1 >> level); ++x) {
+            if (texels[y * width + x] >= nearest) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void OcclusionBuffer::collectOccluders(const World& world, NodeIndex node, const NodeBounds& bounds,
+                                       const Camera::Frustum& frustum, const glm::vec3& cameraPosition) {
+    const FlatOctree& octree = world.getOctree();
+
+    // Nodes below the minimum size hold no occluder, the walk never goes deeper
+    if (bounds.size < MIN_OCCLUDER_SIZE) return;
+
+    const glm::vec3 min(bounds.position);
+    const glm::vec3 max = min + glm::vec3(static_cast<float>(bounds.size));
+    if (!isBoxInFrustum(min, max, frustum)) return;
+
+    if (octree.isLeaf(node)) {
+        // Uniform leaves fill their extent with the payload, type 0 is air. Only leaves with
+        // a mesh occlude, anything else does not draw yet and would hide what is behind it.
+        if (octree.isBrick(node) || (octree.getPayload(node) & 0xFF) == 0 || !world.findMesh(node)) return;
+
+        const float distance = glm::length(glm::max(glm::max(min - cameraPosition, cameraPosition - max), glm::vec3(0.0f)));
+        occluders.push_back({min, max, static_cast<float>(bounds.size) / std::max(distance, 1.0f)});
+        return;
+    }
+
+    const uint8_t childMask = octree.getChildMask(node);
+    for (uint32_t i = 0; i < 8; ++i) {
+        if (childMask & (1 << i)) {
+            collectOccluders(world, octree.getChild(node, i), FlatOctree::getChildBounds(bounds, i), frustum, cameraPosition);
+        }
+    }
+}
+
+void OcclusionBuffer::rasterizeBox(const Occluder& occluder, const glm::vec3& cameraPosition) {
+    // Only faces turned towards the camera, a camera inside the box draws nothing
+    for (int axis = 0; axis < 3; ++axis) {
+        float plane;
+        if (cameraPosition[axis] < occluder.min[axis]) {
+            plane = occluder.min[axis];
+        } else if (cameraPosition[axis] > occluder.max[axis]) {
+            plane = occluder.max[axis];
+        } else {
+            continue;
+        }
+
+        const int u = (axis + 1) % 3;
+        const int v = (axis + 2) % 3;
+        glm::vec3 corners[4];
+        for (int i = 0; i < 4; ++i) {
+            corners[i][axis] = plane;
+            corners[i][u] = (i == 1 || i == 2) ? occluder.max[u] : occluder.min[u];
+            corners[i][v] = (i >= 2) ? occluder.max[v] : occluder.min[v];
+        }
+        rasterizeFace(corners);
+    }
+}
+
+void OcclusionBuffer::rasterizeFace(const glm::vec3 (&corners)[4]) {
+    glm::vec3 screen[4];
+    for (int i = 0; i < 4; ++i) {
+        // Clipping could only shrink the face, skipping it stays conservative
+        if (!project(corners[i], screen[i])) return;
+    }
+
+    // Edge functions a*x + b*y + c, positive inside whatever the winding
+    float area = 0.0f;
+    for (int i = 0; i < 4; ++i) {
+        const glm::vec3& p = screen[i];
+        const glm::vec3& q = screen[(i + 1) % 4];
+        area += p.x * q.y - q.x * p.y;
+    }
+    if (std::abs(area) < 1e-6f) return;
+    const float sign = area > 0.0f ? 1.0f : -1.0f;
+
+    glm::vec3 edges[4];
+    for (int i = 0; i < 4; ++i) {
+        const glm::vec3& p = screen[i];
+        const glm::vec3& q = screen[(i + 1) % 4];
+        edges[i] = sign * glm::vec3(p.y - q.y, q.x - p.x, p.x * q.y - q.x * p.y);
+    }
+
+    // z / w is affine in screen space across a planar face
+    const glm::vec3& p0 = screen[0];
+    const glm::vec3& p1 = screen[1];
+    const glm::vec3& p2 = screen[2];
+    const float denominator = (p1.x - p0.x) * (p2.y - p0.y) - (p2.x - p0.x) * (p1.y - p0.y);
+    if (std::abs(denominator) < 1e-6f) return;
+    const float depthX = ((p1.z - p0.z) * (p2.y - p0.y) - (p2.z - p0.z) * (p1.y - p0.y)) / denominator;
+    const float depthY = ((p1.x - p0.x) * (p2.z - p0.z) - (p2.x - p0.x) * (p1.z - p0.z)) / denominator;
+    const float depthC = p0.z - depthX * p0.x - depthY * p0.y;
+
+    glm::vec2 rectMin(FLT_MAX);
+    glm::vec2 rectMax(-FLT_MAX);
+    for (const glm::vec3& p : screen) {
+        rectMin = glm::min(rectMin, glm::vec2(p));
+        rectMax = glm::max(rectMax, glm::vec2(p));
+    }
+    const int x0 = std::max(static_cast<int>(std::floor(rectMin.x)), 0);
+    const int y0 = std::max(static_cast<int>(std::floor(rectMin.y)), 0);
+    const int x1 = std::min(static_cast<int>(std::ceil(rectMax.x)), static_cast<int>(WIDTH));
+    const int y1 = std::min(static_cast<int>(std::ceil(rectMax.y)), static_cast<int>(HEIGHT));
+
+    // Over a pixel the affine functions take their extremes at its corners
+    for (int y = y0; y < y1; ++y) {
+        for (int x = x0; x < x1; ++x) {
+            const float fx = static_cast<float>(x);
+            const float fy = static_cast<float>(y);
+            bool covered = true;
+            for (const glm::vec3& edge : edges) {
+                const float lowest = edge.x * fx + edge.y * fy + edge.z + std::min(edge.x, 0.0f) + std::min(edge.y, 0.0f);
+                if (lowest < 0.0f) {
+                    covered = false;
+                    break;
+                }
+            }
+            if (!covered) continue;
+
+            const float farthest = depthX * fx + depthY * fy + depthC + std::max(depthX, 0.0f) + std::max(depthY, 0.0f);
+            float& depth = depths[y * WIDTH + x];
+            depth = std::min(depth, farthest);
+        }
+    }
+}
+
+void OcclusionBuffer::buildPyramid() {
+    for (uint32_t level = 1; level < levelCount; ++level) {
+        const uint32_t srcWidth = getLevelWidth(level - 1);
+        const uint32_t srcHeight = getLevelHeight(level - 1);
+        const float* src = depths.data() + levelOffsets[level - 1];
+        float* dst = depths.data() + levelOffsets[level];
+
+        const uint32_t width = getLevelWidth(level);
+        const uint32_t height = getLevelHeight(level);
+        for (uint32_t y = 0; y < height; ++y) {
+            const uint32_t y0 = std::min(2 * y, srcHeight - 1);
+            const uint32_t y1 = std::min(2 * y + 1, srcHeight - 1);
+            for (uint32_t x = 0; x < width; ++x) {
+                const uint32_t x0 = std::min(2 * x, srcWidth - 1);
+                const uint32_t x1 = std::min(2 * x + 1, srcWidth - 1);
+                dst[y * width + x] = std::max(std::max(src[y0 * srcWidth + x0], src[y0 * srcWidth + x1]),
+                                              std::max(src[y1 * srcWidth + x0], src[y1 * srcWidth + x1]));
+            }
+        }
+    }
+}
+
+bool OcclusionBuffer::project(const glm::vec3& point, glm::vec3& screen) const {
+    const glm::vec4 clip = viewProjection * glm::vec4(point, 1.0f);
+    if (clip.w < MIN_CLIP_W) return false;
+
+    const float invW = 1.0f / clip.w;
+    screen.x = (clip.x * invW * 0.5f + 0.5f) * WIDTH;
+    screen.y = (clip.y * invW * 0.5f + 0.5f) * HEIGHT;
+    screen.z = clip.z * invW;
+    return true;
+}
+
+} // namespace voxceleron
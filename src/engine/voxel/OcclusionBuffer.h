@@ -0,0 +1,81 @@
+#pragma once
+
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <vector>
+#include "../core/Camera.h"
+#include "FlatOctree.h"
+
+namespace voxceleron {
+
+class World;
+
+// Low-resolution software depth buffer for occlusion culling. Large solid leaves of the
+// octree that have a mesh are rasterized as occluders, then a pyramid keeps the farthest occluder depth per
+// texel at every level. A box is occluded when every texel its screen rectangle touches has
+// an occluder nearer than the box's nearest corner. Depth is clip z / w of the camera's
+// view projection, texels nothing covered hold FLT_MAX and never occlude.
+//
+// Occluder depth is conservative: a pixel is only written if the face covers all of it,
+// with the face's farthest depth over the pixel.
+class OcclusionBuffer {
+public:
+    static constexpr uint32_t WIDTH = 256;
+    static constexpr uint32_t HEIGHT = 128;
+    static constexpr uint32_t MAX_LEVELS = 16;
+    static constexpr uint32_t MIN_OCCLUDER_SIZE = 16;  // Smaller leaves cover too little to pay off
+    static constexpr uint32_t MAX_OCCLUDERS = 512;     // Largest on screen first
+
+    // Texels of all pyramid levels, WIDTH x HEIGHT down to 1 x 1
+    static constexpr uint32_t getPyramidSize() {
+        uint32_t total = 0;
+        for (uint32_t width = WIDTH, height = HEIGHT;; width = width > 1 ? width / 2 : 1, height = height > 1 ? height / 2 : 1) {
+            total += width * height;
+            if (width == 1 && height == 1) break;
+        }
+        return total;
+    }
+
+    OcclusionBuffer();
+
+    // Rasterizes the drawn solid leaves in view and builds the pyramid for this view
+    void build(const World& world, const glm::mat4& viewProjection, const Camera::Frustum& frustum,
+               const glm::vec3& cameraPosition);
+    void clear();  // Nothing is occluded until the next build
+
+    bool hasOccluders() const { return !occluders.empty(); }
+    bool isOccluded(const glm::vec3& min, const glm::vec3& max) const;
+
+    // Pyramid for the GPU culling pass, levels are stored one after another
+    const glm::mat4& getViewProjection() const { return viewProjection; }
+    uint32_t getLevelCount() const { return levelCount; }
+    uint32_t getLevelOffset(uint32_t level) const { return levelOffsets[level]; }
+    const std::vector<float>& getDepths() const { return depths; }
+    uint32_t getOccluderCount() const { return static_cast<uint32_t>(occluders.size()); }
+
+private:
+    struct Occluder {
+        glm::vec3 min;
+        glm::vec3 max;
+        float score;  // Size over distance, a rough measure of screen coverage
+    };
+
+    glm::mat4 viewProjection;
+    std::vector<float> depths;
+    std::array<uint32_t, MAX_LEVELS> levelOffsets;
+    uint32_t levelCount;
+    std::vector<Occluder> occluders;  // Reused between builds
+
+    void collectOccluders(const World& world, NodeIndex node, const NodeBounds& bounds,
+                          const Camera::Frustum& frustum, const glm::vec3& cameraPosition);
+    void rasterizeBox(const Occluder& occluder, const glm::vec3& cameraPosition);
+    void rasterizeFace(const glm::vec3 (&corners)[4]);
+    void buildPyramid();
+    bool project(const glm::vec3& point, glm::vec3& screen) const;  // False behind the camera
+    static uint32_t getLevelWidth(uint32_t level) { return std::max(WIDTH >> level, 1u); }
+    static uint32_t getLevelHeight(uint32_t level) { return std::max(HEIGHT >> level, 1u); }
+};
+
+} // namespace voxceleron
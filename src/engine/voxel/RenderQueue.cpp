@@ -0,0 +1,64 @@
+#include "RenderQueue.h"
+#include <array>
+#include <cstring>
+
+namespace voxceleron {
+
+namespace {
+
+constexpr uint32_t RADIX_BITS = 8;
+constexpr uint32_t RADIX_SIZE = 1u << RADIX_BITS;
+constexpr uint32_t RADIX_PASSES = 64 / RADIX_BITS;
+constexpr uint32_t BUFFER_ID_MASK = (1u << (RenderQueue::STATE_BITS / 2)) - 1;
+
+} // namespace
+
+uint64_t RenderQueue::makeKey(uint32_t pipeline, uint32_t primaryBuffer, uint32_t secondaryBuffer, float depth) {
+    // Non-negative floats order the same as their bit patterns
+    uint32_t depthBits;
+    std::memcpy(&depthBits, &depth, sizeof(depthBits));
+    const uint64_t state = (static_cast<uint64_t>(primaryBuffer & BUFFER_ID_MASK) << (STATE_BITS / 2)) |
+                           (secondaryBuffer & BUFFER_ID_MASK);
+    return (static_cast<uint64_t>(pipeline & ((1u << PIPELINE_BITS) - 1)) << (64 - PIPELINE_BITS)) |
+           (state << 32) | depthBits;
+}
+
+void RenderQueue::reserve(size_t count) {
+    entries.reserve(count);
+    scratch.reserve(count);
+}
+
+void RenderQueue::sort() {
+    if (entries.size() < 2) return;
+    scratch.resize(entries.size());
+
+    // Histograms of every digit in one read of the keys
+    std::array<std::array<uint32_t, RADIX_SIZE>, RADIX_PASSES> counts{};
+    for (const Entry& entry : entries) {
+        for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+            counts[pass][(entry.key >> (pass * RADIX_BITS)) & (RADIX_SIZE - 1)]++;
+        }
+    }
+
+    // Least significant digit first, each pass is stable. Digits every key shares, like the
+    // pipeline bits of a single-pipeline frame, are skipped.
+    const uint32_t total = static_cast<uint32_t>(entries.size());
+    for (uint32_t pass = 0; pass < RADIX_PASSES; ++pass) {
+        std::array<uint32_t, RADIX_SIZE>& count = counts[pass];
+        const uint32_t shift = pass * RADIX_BITS;
+        if (count[(entries[0].key >> shift) & (RADIX_SIZE - 1)] == total) continue;
+
+        uint32_t offset = 0;
+        for (uint32_t& bucket : count) {
+            const uint32_t size = bucket;
+            bucket = offset;
+            offset += size;
+        }
+        for (const Entry& entry : entries) {
+            scratch[count[(entry.key >> shift) & (RADIX_SIZE - 1)]++] = entry;
+        }
+        entries.swap(scratch);
+    }
+}
+
+} // namespace voxceleron
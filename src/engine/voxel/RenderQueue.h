@@ -0,0 +1,44 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace voxceleron {
+
+// Draws ordered by a 64-bit state key. The key puts the pipeline in the top bits, the
+// buffers bound with it below, and front-to-back depth at the bottom, so sorting it groups
+// draws sharing their bound state and draws each group nearest first, which gives the
+// depth test the most to reject. Keys are built once per draw and radix-sorted. Storage is
+// kept between frames, so a steady frame allocates nothing.
+class RenderQueue {
+public:
+    static constexpr uint32_t PIPELINE_BITS = 2;
+    static constexpr uint32_t STATE_BITS = 30;  // Two 15-bit buffer ids
+
+    // Pipeline and state in the order they are bound, depth must not be negative
+    static uint64_t makeKey(uint32_t pipeline, uint32_t primaryBuffer, uint32_t secondaryBuffer, float depth);
+
+    void clear() { entries.clear(); }  // Keeps the storage
+    void reserve(size_t count);
+    void push(uint64_t key, uint32_t item) { entries.push_back({key, item}); }
+
+    // Sorts by key, ties keep the order they were pushed in
+    void sort();
+
+    size_t size() const { return entries.size(); }
+    bool empty() const { return entries.empty(); }
+    uint32_t getItem(size_t i) const { return entries[i].item; }
+    uint64_t getKey(size_t i) const { return entries[i].key; }
+
+private:
+    struct Entry {
+        uint64_t key;
+        uint32_t item;  // Caller's index of the draw
+    };
+
+    std::vector<Entry> entries;
+    std::vector<Entry> scratch;  // Second buffer of the radix passes
+};
+
+} // namespace voxceleron
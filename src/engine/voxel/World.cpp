@@ -2,24 +2,34 @@
 #include "WorldRenderer.h"
 #include "../core/Camera.h"
 #include "../vulkan/core/VulkanContext.h"
+#include "../vulkan/core/UploadQueue.h"
+#include "../vulkan/compute/MeshGenerator.h"
 #include <iostream>
 #include <algorithm>
-#include <fstream>
+#include <array>
+#include <cstring>
 #include <functional>
+#include <limits>
 #include <glm/gtc/matrix_transform.hpp>
 
 namespace voxceleron {
 
 World::World(VulkanContext* context)
-    : context(context)
+    : octree(MAX_LEVEL, glm::ivec3(-(1 << (MAX_LEVEL - 1))), BRICK_SIZE_LOG2)
+    , lodCell(0)
+    , lodViewerPos(0.0f)
+    , lodStale(true)
+    , context(context)
     , device(context->getDevice())
     , physicalDevice(context->getPhysicalDevice())
-    , descriptorPool(VK_NULL_HANDLE)
-    , descriptorSetLayout(VK_NULL_HANDLE)
-    , pipelineLayout(VK_NULL_HANDLE)
-    , computePipeline(VK_NULL_HANDLE)
     , computeQueue(VK_NULL_HANDLE)
-    , commandPool(VK_NULL_HANDLE) {
+    , commandPool(VK_NULL_HANDLE)
+    , meshGeneration(0)
+    , meshBackend(MeshBackend::COMPUTE)
+    , meshingMode(MeshingMode::GREEDY)
+    , meshFormat(MeshFormat::INDEXED)
+    , nextMeshTicket(1)
+    , quadDescriptorPool(VK_NULL_HANDLE) {
     std::cout << "World: Creating world instance" << std::endl;
 }
 
@@ -31,16 +41,13 @@ World::~World() {
 bool World::initialize() {
     std::cout << "World: Starting initialization..." << std::endl;
 
-    // Create root node
-    root = std::make_unique<OctreeNode>();
-    root->position = glm::ivec3(0);
-    root->size = 1 << MAX_LEVEL;
-    root->level = 0;
-    root->isLeaf = true;
+    // Start from an empty octree centered on the origin
+    octree.clear();
 
     // Create renderer
     renderer = std::make_unique<WorldRenderer>();
-    if (!renderer->initialize(device, physicalDevice)) {
+    if (!renderer->initialize(device, physicalDevice, context->getMemoryAllocator(),
+                              context->getGraphicsQueueFamily())) {
         std::cerr << "World: Failed to initialize renderer" << std::endl;
         return false;
     }
@@ -48,9 +55,30 @@ bool World::initialize() {
     // Create test scene
     createTestScene();
 
-    // Create compute pipeline for mesh generation
-    if (!createComputePipeline()) {
-        std::cerr << "World: Failed to create compute pipeline" << std::endl;
+    // Create the compute queue and the GPU mesher
+    if (!createMeshGenerator()) {
+        std::cerr << "World: Failed to create mesh generator" << std::endl;
+        return false;
+    }
+
+    if (!createQuadDescriptorPool()) {
+        std::cerr << "World: Failed to create quad descriptor pool" << std::endl;
+        return false;
+    }
+
+    if (!createMeshArenas()) {
+        std::cerr << "World: Failed to create mesh arenas" << std::endl;
+        return false;
+    }
+
+    uploadQueue = std::make_unique<UploadQueue>(context, computeQueue, findComputeQueueFamily(physicalDevice));
+    if (!uploadQueue->initialize()) {
+        std::cerr << "World: Failed to create upload queue" << std::endl;
+        return false;
+    }
+
+    if (!createMeshBatches()) {
+        std::cerr << "World: Failed to create mesh batches" << std::endl;
         return false;
     }
 
@@ -66,33 +94,41 @@ void World::cleanup() {
         renderer.reset();
     }
 
-    // Clean up mesh data
+    // Stop the CPU mesher first, its results would reference meshes about to go away
+    cpuMesher.reset();
+    pendingMeshJobs.clear();
+
+    // Clean up mesh data, including uploads still in flight
+    if (uploadQueue) {
+        uploadQueue->waitIdle();
+    }
+    for (PendingMesh& pending : pendingMeshes) {
+        cleanupMeshData(pending.meshData);
+    }
+    pendingMeshes.clear();
     for (auto& [node, meshData] : meshes) {
         cleanupMeshData(meshData);
     }
     meshes.clear();
+    meshGeneration++;
 
     // Clean up Vulkan resources
     if (device != VK_NULL_HANDLE) {
-        if (computePipeline != VK_NULL_HANDLE) {
-            vkDestroyPipeline(device, computePipeline, nullptr);
-            computePipeline = VK_NULL_HANDLE;
-        }
-
-        if (pipelineLayout != VK_NULL_HANDLE) {
-            vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
-            pipelineLayout = VK_NULL_HANDLE;
-        }
-
-        if (descriptorSetLayout != VK_NULL_HANDLE) {
-            vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
-            descriptorSetLayout = VK_NULL_HANDLE;
-        }
-
-        if (descriptorPool != VK_NULL_HANDLE) {
-            vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-            descriptorPool = VK_NULL_HANDLE;
+        destroyMeshBatches();
+        meshGenerator.reset();
+        uploadQueue.reset();
+
+        // Meshes are gone, the arenas release their pages
+        vertexArena.reset();
+        indexArena.reset();
+        quadArena.reset();
+
+        if (quadDescriptorPool != VK_NULL_HANDLE) {
+            vkDestroyDescriptorPool(device, quadDescriptorPool, nullptr);
+            quadDescriptorPool = VK_NULL_HANDLE;
         }
+        quadPageSets.clear();
+        quadPageBuffers.clear();
 
         if (commandPool != VK_NULL_HANDLE) {
             vkDestroyCommandPool(device, commandPool, nullptr);
@@ -101,128 +137,177 @@ void World::cleanup() {
     }
 
     // Clean up octree
-    root.reset();
+    octree.clear();
 
     std::cout << "World: Cleanup complete" << std::endl;
 }
 
 void World::setVoxel(const glm::ivec3& pos, const Voxel& voxel) {
-    OctreeNode* node = findNode(pos, true);
-    if (!node) return;
+    octree.setValue(pos, packVoxel(voxel));
+    lodStale = true;
+}
 
-    // Calculate local position within the node
-    glm::ivec3 localPos = pos - node->position;
-    uint32_t index = (localPos.x & 1) | ((localPos.y & 1) << 1) | ((localPos.z & 1) << 2);
+Voxel World::getVoxel(const glm::ivec3& pos) const {
+    return unpackVoxel(octree.getValue(pos));
+}
 
-    // Initialize data vector if empty
-    if (node->nodeData.leaf.data.empty()) {
-        node->nodeData.leaf.data.resize(8, 0);  // Initialize with 8 empty voxels
+void World::setVoxels(const glm::ivec3* positions, const Voxel* voxels, size_t count) {
+    std::vector<uint32_t> values(count);
+    for (size_t i = 0; i < count; ++i) {
+        values[i] = packVoxel(voxels[i]);
     }
-
-    // Pack voxel data into uint32_t
-    uint32_t packedVoxel = (voxel.color & 0xFFFFFF00) | (voxel.type & 0xFF);
-    node->nodeData.leaf.data[index] = packedVoxel;
-    node->needsUpdate = true;
+    octree.setValues(positions, values.data(), count);
+    lodStale = true;
 }
 
-Voxel World::getVoxel(const glm::ivec3& pos) const {
-    const OctreeNode* node = findNode(pos);
-    if (!node || node->nodeData.leaf.data.empty()) {
-        return Voxel{0, 0};  // Return empty voxel if node doesn't exist
+void World::getVoxels(const glm::ivec3* positions, Voxel* voxels, size_t count) const {
+    std::vector<uint32_t> values(count);
+    octree.getValues(positions, values.data(), count);
+    for (size_t i = 0; i < count; ++i) {
+        voxels[i] = unpackVoxel(values[i]);
     }
+}
 
-    // Calculate local position within the node
-    glm::ivec3 localPos = pos - node->position;
-    uint32_t index = (localPos.x & 1) | ((localPos.y & 1) << 1) | ((localPos.z & 1) << 2);
+void World::fillBox(const glm::ivec3& min, const glm::ivec3& max, const Voxel& voxel) {
+    octree.fillBox(min, max, packVoxel(voxel));
+    releaseStaleMeshes();
+    lodStale = true;
+}
 
-    // Unpack voxel data from uint32_t
-    uint32_t packedVoxel = node->nodeData.leaf.data[index];
-    return Voxel{
-        static_cast<uint32_t>(packedVoxel & 0xFF),           // type
-        static_cast<uint32_t>(packedVoxel & 0xFFFFFF00)      // color
-    };
+void World::fillSphere(const glm::ivec3& center, float radius, const Voxel& voxel) {
+    octree.fillSphere(center, radius, packVoxel(voxel));
+    releaseStaleMeshes();
+    lodStale = true;
+}
+
+void World::replaceType(const glm::ivec3& min, const glm::ivec3& max, uint32_t fromType, const Voxel& voxel) {
+    octree.replaceType(min, max, fromType, packVoxel(voxel));
+    releaseStaleMeshes();
+    lodStale = true;
+}
+
+void World::clearRegion(const glm::ivec3& min, const glm::ivec3& max) {
+    octree.fillBox(min, max, 0);
+    releaseStaleMeshes();
+    lodStale = true;
 }
 
 void World::updateLOD(const glm::vec3& viewerPos) {
-    if (!root) return;
-
-    // Update LOD levels based on distance from viewer
-    std::function<void(OctreeNode*, const glm::vec3&)> updateNode = 
-        [&](OctreeNode* node, const glm::vec3& pos) {
-            if (!node) return;
-
-            // Calculate distance to viewer
-            glm::vec3 center = glm::vec3(node->position) + glm::vec3(node->size / 2);
-            float distance = glm::length(center - pos);
-
-            // Determine desired LOD level based on distance
-            float factor = distance / (node->size * 2.0f);
-            uint32_t desiredLevel = static_cast<uint32_t>(glm::log2(factor));
-            desiredLevel = glm::clamp(desiredLevel, 0u, MAX_LEVEL);
-
-            // Split or merge based on desired level
-            if (desiredLevel > node->level && !node->isLeaf) {
-                // Node is too detailed, try to merge
-                optimizeNode(node);
-            } else if (desiredLevel < node->level && node->isLeaf) {
-                // Node needs more detail, split
-                subdivideNode(node);
-            }
+    // A static world seen from the same cell has nothing to re-evaluate
+    const glm::ivec3 cell(glm::floor(viewerPos / LOD_CELL_SIZE));
+    if (!lodStale && cell == lodCell) return;
+
+    const bool full = lodStale;
+    lodCell = cell;
+    lodStale = false;
+    updateNodeLOD(octree.getRoot(), octree.getRootBounds(), viewerPos, full);
+    lodViewerPos = viewerPos;
+}
 
-            // Recursively update children
-            if (!node->isLeaf) {
-                for (uint8_t i = 0; i < 8; ++i) {
-                    if (node->childMask & (1 << i)) {
-                        updateNode(node->nodeData.internal.children[i].get(), pos);
-                    }
-                }
-            }
-        };
+void World::updateNodeLOD(NodeIndex node, const NodeBounds& bounds, const glm::vec3& viewerPos, bool full) {
+    const glm::vec3 boxMin(bounds.position);
+    const glm::vec3 boxMax = boxMin + glm::vec3(static_cast<float>(bounds.size));
+
+    // Every center below this node lies in its box. If no power of two separates the nearest
+    // and farthest distance from either viewer position, no level in the subtree changed.
+    if (!full) {
+        float nearest = std::numeric_limits<float>::max();
+        float farthest = 0.0f;
+        for (const glm::vec3& pos : {lodViewerPos, viewerPos}) {
+            const glm::vec3 toFar = glm::max(glm::abs(boxMin - pos), glm::abs(boxMax - pos));
+            nearest = std::min(nearest, glm::length(glm::max(glm::max(boxMin - pos, pos - boxMax), glm::vec3(0.0f))));
+            farthest = std::max(farthest, glm::length(toFar));
+        }
+        if (nearest >= 1.0f && std::floor(std::log2(nearest)) == std::floor(std::log2(farthest))) return;
+    }
 
-    updateNode(root.get(), viewerPos);
+    // Determine desired LOD level based on distance, nodes closer than twice their size
+    // want level 0
+    const glm::vec3 center = boxMin + glm::vec3(static_cast<float>(bounds.size / 2));
+    const float factor = glm::length(center - viewerPos) / (bounds.size * 2.0f);
+    const float desired = glm::clamp(glm::log2(std::max(factor, 1.0f)), 0.0f, static_cast<float>(MAX_LEVEL));
+    const uint32_t desiredLevel = static_cast<uint32_t>(desired);
+
+    // Split or merge based on desired level
+    bool split = false;
+    if (desiredLevel > bounds.level && !octree.isLeaf(node)) {
+        // Node is too detailed, try to merge
+        optimizeNode(node);
+    } else if (desiredLevel < bounds.level && octree.isLeaf(node) &&
+               bounds.level < octree.getBrickLevel()) {
+        // Node needs more detail, split (bricks are the finest node level)
+        subdivideNode(node);
+        split = !octree.isLeaf(node);
+    }
+
+    // Children created just now have never been evaluated
+    if (!octree.isLeaf(node)) {
+        const uint8_t childMask = octree.getChildMask(node);
+        for (uint8_t i = 0; i < 8; ++i) {
+            if (childMask & (1 << i)) {
+                updateNodeLOD(octree.getChild(node, i), FlatOctree::getChildBounds(bounds, i), viewerPos, full || split);
+            }
+        }
+    }
 }
 
 void World::generateMeshes(const glm::vec3& viewerPos) {
-    if (!root) return;
-
-    // Queue of nodes that need mesh updates
-    std::vector<OctreeNode*> updateQueue;
+    const MeshStats statsBefore = meshStats;
 
-    // Collect nodes that need updates
-    std::function<void(OctreeNode*)> collectNodes = [&](OctreeNode* node) {
-        if (!node) return;
+    // Upload whatever the CPU mesher and the compute batches finished since the last frame
+    if (cpuMesher) {
+        collectCpuMeshes();
+    }
+    collectComputeMeshes();
 
-        if (node->needsUpdate) {
-            updateQueue.push_back(node);
-        }
+    // Pick up nodes dirtied since the last frame, a static world adds nothing here
+    octree.takeDirtyNodes(meshQueue);
 
-        if (!node->isLeaf) {
-            for (uint8_t i = 0; i < 8; ++i) {
-                if (node->childMask & (1 << i)) {
-                    collectNodes(node->nodeData.internal.children[i].get());
-                }
-            }
-        }
+    // Queue of nodes that need mesh updates
+    struct PendingNode {
+        NodeIndex node;
+        NodeBounds bounds;
+        float distance;
     };
+    std::vector<PendingNode> updateQueue;
+    updateQueue.reserve(meshQueue.size());
+
+    for (NodeIndex node : meshQueue) {
+        // Cleaned or released since it was queued
+        if (!octree.isDirty(node)) continue;
 
-    collectNodes(root.get());
+        const NodeBounds bounds = octree.getBounds(node);
+        glm::vec3 center = glm::vec3(bounds.position) + glm::vec3(bounds.size / 2);
+        updateQueue.push_back({node, bounds, glm::length(center - viewerPos)});
+    }
+    meshQueue.clear();
 
     // Sort nodes by distance to viewer (closest first)
     std::sort(updateQueue.begin(), updateQueue.end(),
-        [&viewerPos](const OctreeNode* a, const OctreeNode* b) {
-            glm::vec3 centerA = glm::vec3(a->position) + glm::vec3(a->size / 2);
-            glm::vec3 centerB = glm::vec3(b->position) + glm::vec3(b->size / 2);
-            float distA = glm::length(centerA - viewerPos);
-            float distB = glm::length(centerB - viewerPos);
-            return distA < distB;
+        [](const PendingNode& a, const PendingNode& b) {
+            return a.distance < b.distance;
         });
 
     // Generate meshes for nodes that need updates
-    for (auto* node : updateQueue) {
-        if (generateMeshForNode(node)) {
-            node->needsUpdate = false;
+    for (const auto& pending : updateQueue) {
+        // A node can be queued more than once, the first pass already cleaned it
+        if (!octree.isDirty(pending.node)) continue;
+
+        if (generateMeshForNode(pending.node, pending.bounds)) {
+            octree.setDirty(pending.node, false);
+        } else if (octree.isDirty(pending.node)) {
+            meshQueue.push_back(pending.node);  // Retry next frame
         }
     }
+
+    // Report how much merging saved on the meshes finished this frame
+    MeshStats frameStats;
+    frameStats.visibleFaces = meshStats.visibleFaces - statsBefore.visibleFaces;
+    frameStats.quads = meshStats.quads - statsBefore.quads;
+    if (frameStats.visibleFaces > 0) {
+        std::cout << "World: Meshed " << frameStats.visibleFaces * 2 << " -> " << frameStats.getTriangleCount()
+                  << " triangles (" << static_cast<int>(100.0f * frameStats.getReduction()) << "% fewer)" << std::endl;
+    }
 }
 
 void World::prepareFrame(const Camera& camera) {
@@ -231,9 +316,19 @@ void World::prepareFrame(const Camera& camera) {
     }
 }
 
-void World::render(VkCommandBuffer commandBuffer) {
+void World::recordCulling(VkCommandBuffer commandBuffer) {
+    if (renderer) {
+        renderer->recordCulling(commandBuffer);
+    }
+}
+
+bool World::usesSecondaryCommandBuffers() const {
+    return renderer && renderer->usesSecondaryCommandBuffers();
+}
+
+void World::render(VkCommandBuffer commandBuffer, const RenderTarget& target) {
     if (renderer) {
-        renderer->recordCommands(commandBuffer);
+        renderer->recordCommands(commandBuffer, target);
     }
 }
 
@@ -243,174 +338,113 @@ void World::setDebugVisualization(bool enabled) {
     }
 }
 
-bool World::isDebugVisualizationEnabled() const {
-    return renderer ? renderer->isDebugVisualizationEnabled() : false;
-}
+void World::setMeshBackend(MeshBackend backend, MeshingMode mode) {
+    meshBackend = backend;
+    meshingMode = mode;
+    if (backend != MeshBackend::CPU) return;
 
-OctreeNode* World::findNode(const glm::ivec3& position, bool create) {
-    if (!root) {
-        if (create) {
-            root = std::make_unique<OctreeNode>();
-            root->position = glm::ivec3(0);
-            root->size = 1u << MAX_LEVEL;
-            root->level = 0;
-            root->isLeaf = true;
-            return root.get();
-        }
-        return nullptr;
+    if (!cpuMesher) {
+        cpuMesher = std::make_unique<CpuMesher>(mode, meshFormat);
+        std::cout << "World: CPU meshing enabled with " << cpuMesher->getThreadCount() << " workers ("
+                  << getFaceCullingIsa() << " face culling)" << std::endl;
+    } else {
+        cpuMesher->setMode(mode);
     }
+}
 
-    OctreeNode* current = root.get();
-    uint32_t size = 1u << MAX_LEVEL;
-    uint32_t level = 0;
-
-    while (current && !current->isLeaf && level < MAX_LEVEL) {
-        size >>= 1;
-        glm::ivec3 localPos = (position - current->position) / static_cast<int>(size);
-        uint32_t index = (localPos.x & 1) | ((localPos.y & 1) << 1) | ((localPos.z & 1) << 2);
-
-        if (!(current->childMask & (1 << index))) {
-            if (!create) {
-                return nullptr;
-            }
-            
-            // Create new child node
-            auto& child = current->nodeData.internal.children[index];
-            child = std::make_unique<OctreeNode>();
-            child->position = current->position + glm::ivec3(
-                (index & 1) ? size : 0,
-                (index & 2) ? size : 0,
-                (index & 4) ? size : 0
-            );
-            child->size = size;
-            child->level = level + 1;
-            child->isLeaf = true;
-            current->childMask |= (1 << index);
-        }
-
-        current = current->nodeData.internal.children[index].get();
-        level++;
+void World::setMeshFormat(MeshFormat format) {
+    meshFormat = format;
+    if (cpuMesher) {
+        cpuMesher->setFormat(format);
     }
+}
 
-    return current;
+bool World::isDebugVisualizationEnabled() const {
+    return renderer ? renderer->isDebugVisualizationEnabled() : false;
 }
 
-const OctreeNode* World::findNode(const glm::ivec3& position) const {
-    if (!root) return nullptr;
+NodeIndex World::findNode(const glm::ivec3& position, NodeBounds* bounds) const {
+    return octree.findLeaf(position, bounds);
+}
 
-    const OctreeNode* current = root.get();
-    uint32_t size = 1u << MAX_LEVEL;
-    uint32_t level = 0;
+const MeshData* World::findMesh(NodeIndex node) const {
+    auto it = meshes.find(node);
+    return it != meshes.end() ? &it->second : nullptr;
+}
 
-    while (current && !current->isLeaf && level < MAX_LEVEL) {
-        size >>= 1;
-        glm::ivec3 localPos = (position - current->position) / static_cast<int>(size);
-        uint32_t index = (localPos.x & 1) | ((localPos.y & 1) << 1) | ((localPos.z & 1) << 2);
+void World::releaseMeshes(NodeIndex node) {
+    dropMesh(node);
 
-        if (!(current->childMask & (1 << index))) {
-            return nullptr;
+    if (!octree.isLeaf(node)) {
+        for (uint32_t i = 0; i < 8; ++i) {
+            releaseMeshes(octree.getChild(node, i));
         }
-
-        current = current->nodeData.internal.children[index].get();
-        level++;
     }
-
-    return current;
 }
 
-void World::subdivideNode(OctreeNode* node) {
-    if (!node || !node->isLeaf || node->level >= MAX_LEVEL) return;
-
-    // Convert to internal node
-    node->isLeaf = false;
-    std::vector<uint32_t> leafData;
-    if (!node->nodeData.leaf.data.empty()) {
-        leafData = node->nodeData.leaf.data;  // Save the data before moving
-    }
-    node->nodeData.leaf.~LeafData();  // Explicitly destruct leaf data
-    new (&node->nodeData.internal) InternalData();
-
-    // Create child nodes
-    uint32_t childSize = node->size >> 1;
-    for (uint32_t i = 0; i < 8; ++i) {
-        auto& child = node->nodeData.internal.children[i];
-        child = std::make_unique<OctreeNode>();
-        child->position = node->position + glm::ivec3(
-            (i & 1) ? childSize : 0,
-            (i & 2) ? childSize : 0,
-            (i & 4) ? childSize : 0
-        );
-        child->size = childSize;
-        child->level = node->level + 1;
-        child->isLeaf = true;
-        node->childMask |= (1 << i);
-        
-        // Copy voxel data if it exists
-        if (!leafData.empty()) {
-            child->nodeData.leaf.data.resize(8, 0);
-            child->nodeData.leaf.data[i] = leafData[i];
+void World::releaseStaleMeshes() {
+    std::vector<NodeIndex> groups;
+    octree.takeReleasedGroups(groups);
+
+    // Released nodes are no longer reachable from the root, drop their entries directly
+    for (NodeIndex base : groups) {
+        for (uint32_t i = 0; i < 8; ++i) {
+            dropMesh(base + i);
         }
     }
-
-    node->needsUpdate = true;
 }
 
-void World::optimizeNode(OctreeNode* node) {
-    if (!node) return;
-    
-    if (node->isLeaf) {
-        if (!node->nodeData.leaf.data.empty()) {
-            // Check if all voxels are the same
-            uint32_t firstVoxel = node->nodeData.leaf.data[0];
-            bool allSame = true;
-            
-            for (size_t i = 1; i < node->nodeData.leaf.data.size(); ++i) {
-                if (node->nodeData.leaf.data[i] != firstVoxel) {
-                    allSame = false;
-                    break;
-                }
-            }
-            
-            if (allSame) {
-                // If all voxels are empty (type == 0)
-                if ((firstVoxel & 0xFF) == 0) {
-                    node->nodeData.leaf.data.clear();
-                    node->nodeData.leaf.runs.clear();
-                    node->isOptimized = true;
-                    node->optimizedValue = 0;
-                } else {
-                    // Otherwise, keep one voxel and mark as optimized
-                    node->isOptimized = true;
-                    node->optimizedValue = firstVoxel;
-                }
-            }
+void World::dropMesh(NodeIndex node) {
+    auto it = meshes.find(node);
+    if (it != meshes.end()) {
+        cleanupMeshData(it->second);
+        meshes.erase(it);
+        meshGeneration++;
+    }
+    pendingMeshJobs.erase(node);
+
+    // Their copies are already recorded, the ranges are freed once the batch is done
+    for (PendingMesh& pending : pendingMeshes) {
+        if (pending.node == node) {
+            pending.cancelled = true;
         }
     }
 }
 
-bool World::optimizeNodes() {
-    if (!root) return false;
+void World::subdivideNode(NodeIndex node) {
+    if (node == INVALID_NODE || !octree.isLeaf(node) || octree.isBrick(node)) return;
 
-    bool anyOptimized = false;
-    std::function<void(OctreeNode*)> optimizeRecursive = [&](OctreeNode* node) {
-        if (!node || node->isLeaf) return;
+    // Children inherit the leaf's voxel, so only the node's own mesh goes stale
+    releaseMeshes(node);
+    octree.subdivide(node);
+}
 
-        // First optimize children
-        for (uint8_t i = 0; i < 8; ++i) {
-            if (node->childMask & (1 << i)) {
-                optimizeRecursive(node->nodeData.internal.children[i].get());
-            }
-        }
+void World::optimizeNode(NodeIndex node) {
+    if (node == INVALID_NODE) return;
 
-        // Then try to optimize this node
-        bool wasLeaf = node->isLeaf;
-        optimizeNode(node);
-        if (node->isLeaf && !wasLeaf) {
-            anyOptimized = true;
+    // Bricks that became uniform turn back into plain leaves
+    if (octree.isBrick(node)) {
+        octree.compactBrick(node);
+        return;
+    }
+    if (octree.isLeaf(node)) return;
+
+    // Merge eight identical leaf children back into a single uniform leaf, solid ones only
+    // up to brick size since larger leaves are never meshed
+    if (octree.isCollapsible(node) &&
+        octree.canBeUniform(octree.getBounds(node).level, octree.getPayload(octree.getChild(node, 0)))) {
+        for (uint32_t i = 0; i < 8; ++i) {
+            releaseMeshes(octree.getChild(node, i));
         }
-    };
+        octree.collapse(node);
+    }
+}
 
-    optimizeRecursive(root.get());
+bool World::optimizeNodes() {
+    // Only the paths edited since the last call are visited, a static world costs nothing
+    const bool anyOptimized = octree.collapsePending() > 0;
+    releaseStaleMeshes();
+    lodStale = lodStale || anyOptimized;
     return anyOptimized;
 }
 
@@ -423,85 +457,62 @@ uint32_t World::getNodeCount() const {
 }
 
 size_t World::calculateMemoryUsage() const {
-    size_t total = sizeof(World);
-    if (root) {
-        std::function<size_t(const OctreeNode*)> calcNodeMemory = 
-            [&calcNodeMemory](const OctreeNode* node) -> size_t {
-                if (!node) return 0;
-
-                size_t memory = sizeof(OctreeNode);
-                
-                if (node->isLeaf) {
-                    memory += node->nodeData.leaf.data.capacity() * sizeof(uint32_t);
-                    memory += node->nodeData.leaf.runs.capacity() * sizeof(VoxelRun);
-                } else {
-                    for (uint8_t i = 0; i < 8; ++i) {
-                        if (node->childMask & (1 << i)) {
-                            memory += calcNodeMemory(node->nodeData.internal.children[i].get());
-                        }
-                    }
-                }
-
-                return memory;
-            };
-
-        total += calcNodeMemory(root.get());
-    }
-    return total;
+    return sizeof(World) + octree.getMemoryUsage();
 }
 
 size_t World::countNodes(bool activeOnly) const {
-    if (!root) return 0;
-
-    std::function<size_t(const OctreeNode*)> countRecursive = 
-        [activeOnly, &countRecursive](const OctreeNode* node) -> size_t {
-            if (!node) return 0;
+    if (!activeOnly) {
+        return octree.getNodeCount();
+    }
 
-            size_t count = 1;
-            if (!node->isLeaf) {
-                for (uint8_t i = 0; i < 8; ++i) {
-                    if (!activeOnly || (node->childMask & (1 << i))) {
-                        count += countRecursive(node->nodeData.internal.children[i].get());
-                    }
+    std::function<size_t(NodeIndex)> countRecursive = [&](NodeIndex node) -> size_t {
+        size_t count = 1;
+        if (!octree.isLeaf(node)) {
+            const uint8_t childMask = octree.getChildMask(node);
+            for (uint8_t i = 0; i < 8; ++i) {
+                if (childMask & (1 << i)) {
+                    count += countRecursive(octree.getChild(node, i));
                 }
             }
-            return count;
-        };
+        }
+        return count;
+    };
 
-    return countRecursive(root.get());
+    return countRecursive(octree.getRoot());
 }
 
 size_t World::countNodesByLevel(uint32_t level) const {
-    if (!root) return 0;
+    std::function<size_t(NodeIndex, uint32_t)> countRecursive =
+        [&](NodeIndex node, uint32_t nodeLevel) -> size_t {
+            if (nodeLevel == level) return 1;
 
-    std::function<size_t(const OctreeNode*)> countRecursive = 
-        [level, &countRecursive](const OctreeNode* node) -> size_t {
-            if (!node) return 0;
-
-            size_t count = (node->level == level) ? 1 : 0;
-            if (!node->isLeaf) {
+            size_t count = 0;
+            if (!octree.isLeaf(node)) {
                 for (uint8_t i = 0; i < 8; ++i) {
-                    if (node->childMask & (1 << i)) {
-                        count += countRecursive(node->nodeData.internal.children[i].get());
-                    }
+                    count += countRecursive(octree.getChild(node, i), nodeLevel + 1);
                 }
             }
             return count;
         };
 
-    return countRecursive(root.get());
+    return countRecursive(octree.getRoot(), 0);
 }
 
 void World::createTestScene() {
     std::cout << "World: Creating test scene..." << std::endl;
-    
+
+    // Collect the whole scene and apply it as one batch
+    std::vector<glm::ivec3> positions;
+    std::vector<Voxel> voxels;
+
     // Create a ground plane
     for (int x = -8; x <= 8; x++) {
         for (int z = -8; z <= 8; z++) {
             Voxel groundVoxel;
             groundVoxel.type = 1;  // Solid voxel
             groundVoxel.color = 0x808080FF;  // Gray
-            setVoxel(glm::ivec3(x, -2, z), groundVoxel);
+            positions.push_back(glm::ivec3(x, -2, z));
+            voxels.push_back(groundVoxel);
         }
     }
 
@@ -519,7 +530,8 @@ void World::createTestScene() {
             Voxel voxel;
             voxel.type = 1;
             voxel.color = colors[i];
-            setVoxel(pos + glm::ivec3(0, y, 0), voxel);
+            positions.push_back(pos + glm::ivec3(0, y, 0));
+            voxels.push_back(voxel);
         }
     }
 
@@ -529,158 +541,232 @@ void World::createTestScene() {
             Voxel platformVoxel;
             platformVoxel.type = 1;
             platformVoxel.color = 0xA0522DFF;  // Brown
-            setVoxel(glm::ivec3(x, 3, z), platformVoxel);
+            positions.push_back(glm::ivec3(x, 3, z));
+            voxels.push_back(platformVoxel);
         }
     }
 
+    setVoxels(positions.data(), voxels.data(), positions.size());
+
+    // A 64^3 block covering a whole node above brick size, it is stored as brick-sized leaves
+    Voxel blockVoxel;
+    blockVoxel.type = 1;
+    blockVoxel.color = 0x6B8E23FF;  // Olive
+    fillBox(glm::ivec3(64, -64, -64), glm::ivec3(127, -1, -1), blockVoxel);
+
     std::cout << "World: Test scene created" << std::endl;
 }
 
-bool World::createComputePipeline() {
-    std::cout << "World: Creating compute pipeline..." << std::endl;
-    
-    // Create descriptor set layout
-    VkDescriptorSetLayoutBinding bindings[4] = {};
-    
-    // Binding 0: Input voxel data (storage buffer)
-    bindings[0].binding = 0;
-    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    bindings[0].descriptorCount = 1;
-    bindings[0].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    
-    // Binding 1: Vertex buffer (storage buffer)
-    bindings[1].binding = 1;
-    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    bindings[1].descriptorCount = 1;
-    bindings[1].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-
-    // Binding 2: Index buffer (storage buffer)
-    bindings[2].binding = 2;
-    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    bindings[2].descriptorCount = 1;
-    bindings[2].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-
-    // Binding 3: Counter buffer (storage buffer)
-    bindings[3].binding = 3;
-    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    bindings[3].descriptorCount = 1;
-    bindings[3].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-
-    VkDescriptorSetLayoutCreateInfo layoutInfo{};
-    layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
-    layoutInfo.bindingCount = 4; // Updated to match new binding count
-    layoutInfo.pBindings = bindings;
-
-    std::cout << "World: Creating descriptor set layout with " << layoutInfo.bindingCount << " bindings" << std::endl;
-    if (vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) != VK_SUCCESS) {
-        std::cerr << "World: Failed to create descriptor set layout" << std::endl;
+bool World::createMeshGenerator() {
+    // Create command pool for compute commands
+    VkCommandPoolCreateInfo commandPoolInfo{};
+    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+    commandPoolInfo.queueFamilyIndex = findComputeQueueFamily(physicalDevice);
+
+    if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        std::cerr << "World: Failed to create command pool" << std::endl;
         return false;
     }
-    std::cout << "World: Created descriptor set layout: " << descriptorSetLayout << std::endl;
 
-    // Create descriptor pool
-    VkDescriptorPoolSize poolSizes[4] = {};
-    for (int i = 0; i < 4; i++) {
-        poolSizes[i].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        poolSizes[i].descriptorCount = 100; // Adjust based on max concurrent nodes
+    // Get compute queue
+    vkGetDeviceQueue(device, findComputeQueueFamily(physicalDevice), 0, &computeQueue);
+
+    // One generator batch per mesh batch. Nodes share the output, most are far from their
+    // worst case, and the few that don't fit are meshed again by a later batch.
+    MeshGeneratorCreateInfo createInfo{};
+    createInfo.maxNodeSize = MAX_MESH_NODE_SIZE;
+    createInfo.maxNodesPerBatch = MESH_BATCH_JOBS;
+    createInfo.batchCount = MESH_BATCH_COUNT;
+    createInfo.quadCapacity = MESH_BATCH_QUADS * getMaxQuadCount(MAX_MESH_NODE_SIZE);
+
+    meshGenerator = std::make_unique<MeshGenerator>(context);
+    if (!meshGenerator->initialize(createInfo)) {
+        meshGenerator.reset();
+        return false;
     }
+    return true;
+}
 
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.maxSets = 100; // Adjust based on max concurrent nodes
-    poolInfo.poolSizeCount = 4; // Updated to match new number of bindings
-    poolInfo.pPoolSizes = poolSizes;
+bool World::createMeshBatches() {
+    for (MeshBatch& batch : meshBatches) {
+        VkCommandBufferAllocateInfo cmdAllocInfo{};
+        cmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        cmdAllocInfo.commandPool = commandPool;
+        cmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        cmdAllocInfo.commandBufferCount = 1;
 
-    std::cout << "World: Creating descriptor pool with " << poolInfo.poolSizeCount << " pool sizes" << std::endl;
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
 
-    if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
-        std::cerr << "World: Failed to create descriptor pool" << std::endl;
-        return false;
-    }
-    
-    // Create push constant range
-    VkPushConstantRange pushConstantRange{};
-    pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(glm::ivec3) + 3 * sizeof(uint32_t); // nodePosition, nodeSize, maxVertices, maxIndices
-
-    // Create pipeline layout
-    VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
-    pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
-    pipelineLayoutInfo.setLayoutCount = 1;
-    pipelineLayoutInfo.pSetLayouts = &descriptorSetLayout;
-    pipelineLayoutInfo.pushConstantRangeCount = 1;
-    pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
-
-    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
-        std::cerr << "World: Failed to create pipeline layout" << std::endl;
-        return false;
-    }
-    
-    // Create shader module
-    std::vector<char> shaderCode;
-    try {
-        std::ifstream file("shaders/mesh_generator.comp.spv", std::ios::ate | std::ios::binary);
-        if (!file.is_open()) {
-            std::cerr << "World: Failed to open compute shader file" << std::endl;
+        if (vkAllocateCommandBuffers(device, &cmdAllocInfo, &batch.commandBuffer) != VK_SUCCESS ||
+            vkCreateFence(device, &fenceInfo, nullptr, &batch.fence) != VK_SUCCESS) {
+            destroyMeshBatches();
             return false;
         }
-        
-        size_t fileSize = (size_t)file.tellg();
-        shaderCode.resize(fileSize);
-        file.seekg(0);
-        file.read(shaderCode.data(), fileSize);
-        file.close();
-    } catch (const std::exception& e) {
-        std::cerr << "World: Failed to read compute shader file: " << e.what() << std::endl;
-        return false;
     }
-    
-    VkShaderModuleCreateInfo shaderCreateInfo{};
-    shaderCreateInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
-    shaderCreateInfo.codeSize = shaderCode.size();
-    shaderCreateInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
 
-    VkShaderModule shaderModule;
-    if (vkCreateShaderModule(device, &shaderCreateInfo, nullptr, &shaderModule) != VK_SUCCESS) {
-        std::cerr << "World: Failed to create shader module" << std::endl;
-        return false;
+    std::cout << "World: " << MESH_BATCH_COUNT << " mesh batches of " << MESH_BATCH_JOBS << " jobs" << std::endl;
+    return true;
+}
+
+void World::destroyMeshBatches() {
+    for (MeshBatch& batch : meshBatches) {
+        if (batch.state == MeshBatchState::RUNNING) {
+            vkWaitForFences(device, 1, &batch.fence, VK_TRUE, UINT64_MAX);
+        }
+        if (batch.fence != VK_NULL_HANDLE) {
+            vkDestroyFence(device, batch.fence, nullptr);
+        }
+        if (batch.commandBuffer != VK_NULL_HANDLE) {
+            vkFreeCommandBuffers(device, commandPool, 1, &batch.commandBuffer);
+        }
+        batch = MeshBatch{};
     }
-    
-    // Create compute pipeline
-    VkComputePipelineCreateInfo pipelineInfo{};
-    pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    pipelineInfo.stage.module = shaderModule;
-    pipelineInfo.stage.pName = "main";
-    pipelineInfo.layout = pipelineLayout;
-    
-    if (vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline) != VK_SUCCESS) {
-        std::cerr << "World: Failed to create compute pipeline" << std::endl;
-        vkDestroyShaderModule(device, shaderModule, nullptr);
-        return false;
+}
+
+World::MeshBatch* World::getRecordingMeshBatch() {
+    // Keep filling the batch being recorded, otherwise start on a free one
+    const bool greedy = meshingMode == MeshingMode::GREEDY;
+    for (uint32_t i = 0; i < MESH_BATCH_COUNT; ++i) {
+        MeshBatch& batch = meshBatches[i];
+        if (batch.state == MeshBatchState::RECORDING && batch.format == meshFormat &&
+            batch.greedy == greedy && !meshGenerator->isBatchFull(i)) {
+            return &batch;
+        }
     }
-    
-    // Clean up shader module
-    vkDestroyShaderModule(device, shaderModule, nullptr);
 
-    // Create command pool for compute commands
-    VkCommandPoolCreateInfo commandPoolInfo{};
-    commandPoolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
-    commandPoolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
-    commandPoolInfo.queueFamilyIndex = findComputeQueueFamily(physicalDevice);
+    for (uint32_t i = 0; i < MESH_BATCH_COUNT; ++i) {
+        MeshBatch& batch = meshBatches[i];
+        if (batch.state != MeshBatchState::FREE) continue;
 
-    if (vkCreateCommandPool(device, &commandPoolInfo, nullptr, &commandPool) != VK_SUCCESS) {
-        std::cerr << "World: Failed to create command pool" << std::endl;
-        return false;
+        meshGenerator->beginBatch(i, meshFormat == MeshFormat::QUADS, greedy);
+        batch.state = MeshBatchState::RECORDING;
+        batch.format = meshFormat;
+        batch.greedy = greedy;
+        batch.jobs.clear();
+        return &batch;
     }
+    return nullptr;
+}
 
-    // Get compute queue
-    vkGetDeviceQueue(device, findComputeQueueFamily(physicalDevice), 0, &computeQueue);
+void World::submitMeshBatches() {
+    // Runs after the frame's upload batch, whose barrier makes the voxels visible to the dispatches
+    for (uint32_t i = 0; i < MESH_BATCH_COUNT; ++i) {
+        MeshBatch& batch = meshBatches[i];
+        if (batch.state != MeshBatchState::RECORDING) continue;
 
-    std::cout << "World: Compute pipeline created successfully" << std::endl;
-    return true;
+        if (batch.jobs.empty()) {
+            batch.state = MeshBatchState::FREE;
+            continue;
+        }
+
+        VkCommandBufferBeginInfo beginInfo{};
+        beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        vkResetCommandBuffer(batch.commandBuffer, 0);
+        vkBeginCommandBuffer(batch.commandBuffer, &beginInfo);
+        meshGenerator->recordBatch(i, batch.commandBuffer);
+        vkEndCommandBuffer(batch.commandBuffer);
+
+        VkSubmitInfo submitInfo{};
+        submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        submitInfo.commandBufferCount = 1;
+        submitInfo.pCommandBuffers = &batch.commandBuffer;
+
+        vkResetFences(device, 1, &batch.fence);
+        if (vkQueueSubmit(computeQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS) {
+            std::cerr << "World: Failed to submit mesh batch" << std::endl;
+            for (const MeshJob& job : batch.jobs) {
+                auto it = pendingMeshJobs.find(job.node);
+                if (it != pendingMeshJobs.end() && it->second == job.ticket) {
+                    pendingMeshJobs.erase(it);
+                    octree.setDirty(job.node, true);  // Retry next frame
+                }
+            }
+            batch.jobs.clear();
+            batch.state = MeshBatchState::FREE;
+            continue;
+        }
+        batch.state = MeshBatchState::RUNNING;
+    }
+}
+
+void World::collectComputeMeshes() {
+    for (uint32_t i = 0; i < MESH_BATCH_COUNT; ++i) {
+        MeshBatch& batch = meshBatches[i];
+        // Slots are free again once the copies out of them have finished
+        if (batch.state == MeshBatchState::COPYING && uploadQueue->isComplete(batch.copySerial)) {
+            batch.state = MeshBatchState::FREE;
+        }
+        if (batch.state != MeshBatchState::RUNNING || vkGetFenceStatus(device, batch.fence) != VK_SUCCESS) {
+            continue;
+        }
+
+        const bool writeQuads = batch.format == MeshFormat::QUADS;
+        BufferArena& recordArena = writeQuads ? *quadArena : *vertexArena;
+        bool copied = false;
+        for (uint32_t slot = 0; slot < batch.jobs.size(); ++slot) {
+            const MeshJob& job = batch.jobs[slot];
+
+            // Node was remeshed again, released or reused since this job was recorded
+            auto it = pendingMeshJobs.find(job.node);
+            if (it == pendingMeshJobs.end() || it->second != job.ticket) continue;
+            pendingMeshJobs.erase(it);
+
+            // Crowded out of the batch's output by the nodes before it
+            const MeshGenerator::NodeResult result = meshGenerator->getResult(i, slot);
+            if (result.overflow) {
+                octree.setDirty(job.node, true);  // Retry next frame
+                continue;
+            }
+            const uint32_t quadCount = result.quadCount;
+            meshStats.visibleFaces += result.faceCount;
+            meshStats.quads += quadCount;
+
+            if (quadCount == 0) {
+                dropMesh(job.node);
+                continue;
+            }
+
+            // Copy exactly what was written into the arenas with this frame's upload batch
+            MeshData meshData{};
+            meshData.format = batch.format;
+            const uint32_t recordCount = writeQuads ? quadCount : quadCount * 4;
+            const uint32_t indexCount = writeQuads ? 0 : quadCount * 6;
+            meshData.vertices = recordArena.allocate(recordCount);
+            if (indexCount > 0) {
+                meshData.indices = indexArena->allocate(indexCount);
+            }
+            if (meshData.vertices == BufferArena::INVALID_HANDLE ||
+                (indexCount > 0 && meshData.indices == BufferArena::INVALID_HANDLE)) {
+                cleanupMeshData(meshData);
+                octree.setDirty(job.node, true);  // Retry next frame
+                continue;
+            }
+
+            uploadQueue->copy(meshGenerator->getVertexBuffer(i), result.vertexOffset,
+                              recordArena.getBuffer(recordArena.getRange(meshData.vertices).page),
+                              recordArena.getByteOffset(meshData.vertices),
+                              VkDeviceSize(recordCount) * recordArena.getStride());
+            if (indexCount > 0) {
+                uploadQueue->copy(meshGenerator->getIndexBuffer(i), result.indexOffset,
+                                  indexArena->getBuffer(indexArena->getRange(meshData.indices).page),
+                                  indexArena->getByteOffset(meshData.indices),
+                                  VkDeviceSize(indexCount) * sizeof(uint32_t));
+            }
+
+            meshData.vertexCount = quadCount * 4;
+            meshData.indexCount = quadCount * 6;
+            meshData.indexType = VK_INDEX_TYPE_UINT32;  // Written by the shader, copied as is
+            pendingMeshes.push_back({job.node, meshData, uploadQueue->getRecordingSerial()});
+            copied = true;
+        }
+
+        batch.jobs.clear();
+        batch.copySerial = uploadQueue->getRecordingSerial();
+        batch.state = copied ? MeshBatchState::COPYING : MeshBatchState::FREE;
+    }
 }
 
 uint32_t World::findComputeQueueFamily(VkPhysicalDevice physicalDevice) {
@@ -698,341 +784,294 @@ uint32_t World::findComputeQueueFamily(VkPhysicalDevice physicalDevice) {
     throw std::runtime_error("Failed to find compute queue family");
 }
 
-bool World::generateMeshForNode(OctreeNode* node) {
-    if (!node || !node->needsUpdate) return false;
+bool World::generateMeshForNode(NodeIndex node, const NodeBounds& bounds) {
+    if (node == INVALID_NODE || !octree.isDirty(node)) return false;
+
+    // Only leaves carry voxels, internal nodes are drawn through their children and
+    // drop any mesh left over from before they were split. Uniform air leaves have no
+    // faces, they are never staged or handed to a mesher.
+    // Leaves above MAX_MESH_NODE_SIZE only ever hold air (FlatOctree::canBeUniform).
+    if (!octree.isLeaf(node) || bounds.size > MAX_MESH_NODE_SIZE ||
+        (!octree.isBrick(node) && (octree.getPayload(node) & 0xFF) == 0)) {
+        dropMesh(node);
+        octree.setDirty(node, false);
+        return false;
+    }
 
-    // Create buffers for voxel data
-    const uint32_t voxelBufferSize = node->size * node->size * node->size * sizeof(uint32_t);
-    VkBuffer voxelBuffer;
-    VkDeviceMemory voxelMemory;
+    if (meshBackend == MeshBackend::CPU) {
+        return submitCpuMesh(node, bounds);
+    }
 
-    if (!createBuffer(voxelBufferSize, 
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, 
-        voxelBuffer, voxelMemory)) {
+    // Every batch is busy, the node stays dirty and is retried next frame
+    MeshBatch* batch = getRecordingMeshBatch();
+    if (!batch) {
         return false;
     }
-
-    // Create staging buffer for voxel data
-    VkBuffer stagingBuffer;
-    VkDeviceMemory stagingMemory;
-    if (!createBuffer(voxelBufferSize, 
-        VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        stagingBuffer, stagingMemory)) {
-        vkDestroyBuffer(device, voxelBuffer, nullptr);
-        vkFreeMemory(device, voxelMemory, nullptr);
+    const uint32_t batchIndex = static_cast<uint32_t>(batch - meshBatches.data());
+
+    // Voxels are staged into the node's slot with this frame's uploads. Brick leaves decode straight
+    // into the compute shader's x + y*n + z*n*n layout, any other leaf's payload covers its
+    // whole extent.
+    const uint32_t voxelCount = bounds.size * bounds.size * bounds.size;
+    const VkDeviceSize voxelBufferSize = VkDeviceSize(voxelCount) * sizeof(uint32_t);
+    uint32_t* voxelData = static_cast<uint32_t*>(uploadQueue->reserve(
+        meshGenerator->getVoxelBuffer(batchIndex), meshGenerator->getNextVoxelOffset(batchIndex), voxelBufferSize));
+    if (!voxelData) {
         return false;
     }
+    if (octree.isBrick(node)) {
+        octree.getBricks().get(octree.getPayload(node)).decode(voxelData);
+    } else {
+        std::fill(voxelData, voxelData + voxelCount, octree.getPayload(node));
+    }
 
-    // Map and fill staging buffer with voxel data
-    void* data;
-    vkMapMemory(device, stagingMemory, 0, voxelBufferSize, 0, &data);
-    uint32_t* voxelData = static_cast<uint32_t*>(data);
+    // Nothing is recorded per node, the batch's dispatches cover every node added to it
+    meshGenerator->addNode(batchIndex, bounds.size);
 
-    // Fill voxel data from node
-    if (node->isLeaf && !node->nodeData.leaf.data.empty()) {
-        // For leaf nodes, copy the voxel data directly
-        std::memcpy(voxelData, node->nodeData.leaf.data.data(), 
-                   node->nodeData.leaf.data.size() * sizeof(uint32_t));
-    } else {
-        // For internal nodes or empty nodes, fill with air voxels
-        std::memset(voxelData, 0, voxelBufferSize);
-    }
-
-    vkUnmapMemory(device, stagingMemory);
-
-    // Copy staging buffer to device local buffer
-    copyBuffer(stagingBuffer, voxelBuffer, voxelBufferSize);
-
-    // Clean up staging buffer
-    vkDestroyBuffer(device, stagingBuffer, nullptr);
-    vkFreeMemory(device, stagingMemory, nullptr);
-
-    // Create output mesh buffers
-    const uint32_t maxVertices = node->size * node->size * node->size * 24; // 24 vertices per voxel (worst case)
-    const uint32_t maxIndices = node->size * node->size * node->size * 36;  // 36 indices per voxel (worst case)
-    const uint32_t meshBufferSize = 
-        maxVertices * (8 * sizeof(float)) + // pos(3) + normal(3) + uv(2)
-        maxIndices * sizeof(uint32_t) +     // indices
-        2 * sizeof(uint32_t);               // vertex and index counts
-
-    // Create vertex buffer
-    const uint32_t vertexBufferSize = maxVertices * 8 * sizeof(float); // 8 floats per vertex
-    VkBuffer vertexBuffer;
-    VkDeviceMemory vertexMemory;
-    if (!createBuffer(vertexBufferSize,
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        vertexBuffer, vertexMemory)) {
-        vkDestroyBuffer(device, voxelBuffer, nullptr);
-        vkFreeMemory(device, voxelMemory, nullptr);
-        return false;
+    // A newer ticket supersedes any job still running for this node
+    const uint64_t ticket = nextMeshTicket++;
+    pendingMeshJobs[node] = ticket;
+    batch->jobs.push_back({node, ticket});
+    return true;
+}
+
+bool World::submitCpuMesh(NodeIndex node, const NodeBounds& bounds) {
+    // Snapshot the voxels here, workers never touch the octree
+    MeshVolume volume;
+    volume.origin = bounds.position;
+    volume.size = bounds.size;
+    volume.voxels.resize(size_t(bounds.size + 2) * (bounds.size + 2) * (bounds.size + 2));
+    octree.readVolumeWithBorder(node, bounds, volume.voxels.data());
+
+    // A newer ticket supersedes any job still running for this node
+    const uint64_t ticket = nextMeshTicket++;
+    pendingMeshJobs[node] = ticket;
+    cpuMesher->submit(node, ticket, std::move(volume));
+    return true;
+}
+
+void World::collectCpuMeshes() {
+    std::vector<CpuMeshResult> finished;
+    if (cpuMesher->collect(finished) == 0) return;
+
+    for (CpuMeshResult& result : finished) {
+        // Node was remeshed again, released or reused since this job was submitted
+        auto it = pendingMeshJobs.find(result.node);
+        if (it == pendingMeshJobs.end() || it->second != result.ticket) continue;
+        pendingMeshJobs.erase(it);
+
+        meshStats.add(result.stats);
+        const bool quads = result.format == MeshFormat::QUADS;
+        if (quads ? result.quads.empty() : result.indices.empty()) {
+            dropMesh(result.node);
+            continue;
+        }
+
+        const bool created = quads ? createQuadBuffer(result.node, result.quads)
+                                   : createMeshBuffers(result.node, result.vertices, result.indices);
+        if (!created) {
+            octree.setDirty(result.node, true);  // Retry with a fresh snapshot next frame
+        }
     }
+}
+
+bool World::createMeshBuffers(NodeIndex node, const std::vector<MeshVertex>& vertices, const std::vector<uint32_t>& indices) {
+    // Meshes with up to 64K vertices upload 16-bit indices
+    const VkIndexType indexType = selectIndexType(vertices.size());
+    const VkDeviceSize vertexBufferSize = sizeof(MeshVertex) * vertices.size();
+    const VkDeviceSize indexBufferSize = VkDeviceSize(getIndexSize(indexType)) * indices.size();
 
-    // Create index buffer
-    const uint32_t indexBufferSize = maxIndices * sizeof(uint32_t);
-    VkBuffer indexBuffer;
-    VkDeviceMemory indexMemory;
-    if (!createBuffer(indexBufferSize,
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
-        indexBuffer, indexMemory)) {
-        vkDestroyBuffer(device, voxelBuffer, nullptr);
-        vkFreeMemory(device, voxelMemory, nullptr);
-        vkDestroyBuffer(device, vertexBuffer, nullptr);
-        vkFreeMemory(device, vertexMemory, nullptr);
+    MeshData meshData{};
+    meshData.vertices = vertexArena->allocate(static_cast<uint32_t>(vertices.size()));
+    meshData.indices = indexArena->allocate(getIndexWordCount(static_cast<uint32_t>(indices.size()), indexType));
+    if (meshData.vertices == BufferArena::INVALID_HANDLE || meshData.indices == BufferArena::INVALID_HANDLE) {
+        cleanupMeshData(meshData);
         return false;
     }
 
-    // Create counter buffer
-    const uint32_t counterBufferSize = 2 * sizeof(uint32_t); // vertexCounter and indexCounter
-    VkBuffer counterBuffer;
-    VkDeviceMemory counterMemory;
-    if (!createBuffer(counterBufferSize,
-        VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
-        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-        counterBuffer, counterMemory)) {
-        vkDestroyBuffer(device, voxelBuffer, nullptr);
-        vkFreeMemory(device, voxelMemory, nullptr);
-        vkDestroyBuffer(device, vertexBuffer, nullptr);
-        vkFreeMemory(device, vertexMemory, nullptr);
-        vkDestroyBuffer(device, indexBuffer, nullptr);
-        vkFreeMemory(device, indexMemory, nullptr);
+    // Both copies join this frame's upload batch, indices are narrowed straight into the ring
+    const bool vertexStaged = uploadQueue->upload(
+        vertexArena->getBuffer(vertexArena->getRange(meshData.vertices).page),
+        vertexArena->getByteOffset(meshData.vertices), vertices.data(), vertexBufferSize);
+    void* indexData = vertexStaged ? uploadQueue->reserve(
+        indexArena->getBuffer(indexArena->getRange(meshData.indices).page),
+        indexArena->getByteOffset(meshData.indices), indexBufferSize) : nullptr;
+    if (!indexData) {
+        // A staged vertex copy may still land in the range, keep it out of reuse until then
+        if (vertexStaged) {
+            pendingMeshes.push_back({node, meshData, uploadQueue->getRecordingSerial(), true});
+        } else {
+            cleanupMeshData(meshData);
+        }
         return false;
     }
 
-    // Initialize counter buffer
-    uint32_t* counterData;
-    vkMapMemory(device, counterMemory, 0, counterBufferSize, 0, (void**)&counterData);
-    counterData[0] = 0; // vertexCounter
-    counterData[1] = 0; // indexCounter
-    vkUnmapMemory(device, counterMemory);
-
-    // Create descriptor set
-    VkDescriptorSetAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
-    allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = 1;
-    allocInfo.pSetLayouts = &descriptorSetLayout;
-
-    VkDescriptorSet descriptorSet;
-    if (vkAllocateDescriptorSets(device, &allocInfo, &descriptorSet) != VK_SUCCESS) {
-        vkDestroyBuffer(device, voxelBuffer, nullptr);
-        vkFreeMemory(device, voxelMemory, nullptr);
-        vkDestroyBuffer(device, vertexBuffer, nullptr);
-        vkFreeMemory(device, vertexMemory, nullptr);
-        vkDestroyBuffer(device, indexBuffer, nullptr);
-        vkFreeMemory(device, indexMemory, nullptr);
-        vkDestroyBuffer(device, counterBuffer, nullptr);
-        vkFreeMemory(device, counterMemory, nullptr);
-        return false;
+    if (indexType == VK_INDEX_TYPE_UINT16) {
+        std::transform(indices.begin(), indices.end(), static_cast<uint16_t*>(indexData),
+                       [](uint32_t index) { return static_cast<uint16_t>(index); });
+    } else {
+        std::memcpy(indexData, indices.data(), indexBufferSize);
     }
-    
-    // Update descriptor set
-    VkDescriptorBufferInfo voxelBufferInfo{};
-    voxelBufferInfo.buffer = voxelBuffer;
-    voxelBufferInfo.offset = 0;
-    voxelBufferInfo.range = voxelBufferSize;
-
-    VkDescriptorBufferInfo vertexBufferInfo{};
-    vertexBufferInfo.buffer = vertexBuffer;
-    vertexBufferInfo.offset = 0;
-    vertexBufferInfo.range = vertexBufferSize;
-
-    VkDescriptorBufferInfo indexBufferInfo{};
-    indexBufferInfo.buffer = indexBuffer;
-    indexBufferInfo.offset = 0;
-    indexBufferInfo.range = indexBufferSize;
-
-    VkDescriptorBufferInfo counterBufferInfo{};
-    counterBufferInfo.buffer = counterBuffer;
-    counterBufferInfo.offset = 0;
-    counterBufferInfo.range = counterBufferSize;
-
-    std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
-
-    descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[0].dstSet = descriptorSet;
-    descriptorWrites[0].dstBinding = 0;
-    descriptorWrites[0].dstArrayElement = 0;
-    descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    descriptorWrites[0].descriptorCount = 1;
-    descriptorWrites[0].pBufferInfo = &voxelBufferInfo;
-
-    descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[1].dstSet = descriptorSet;
-    descriptorWrites[1].dstBinding = 1;
-    descriptorWrites[1].dstArrayElement = 0;
-    descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    descriptorWrites[1].descriptorCount = 1;
-    descriptorWrites[1].pBufferInfo = &vertexBufferInfo;
-
-    descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[2].dstSet = descriptorSet;
-    descriptorWrites[2].dstBinding = 2;
-    descriptorWrites[2].dstArrayElement = 0;
-    descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    descriptorWrites[2].descriptorCount = 1;
-    descriptorWrites[2].pBufferInfo = &indexBufferInfo;
-
-    descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descriptorWrites[3].dstSet = descriptorSet;
-    descriptorWrites[3].dstBinding = 3;
-    descriptorWrites[3].dstArrayElement = 0;
-    descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    descriptorWrites[3].descriptorCount = 1;
-    descriptorWrites[3].pBufferInfo = &counterBufferInfo;
-
-    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
-
-    // Create command buffer
-    VkCommandBufferAllocateInfo cmdAllocInfo{};
-    cmdAllocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    cmdAllocInfo.commandPool = commandPool;
-    cmdAllocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    cmdAllocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    if (vkAllocateCommandBuffers(device, &cmdAllocInfo, &commandBuffer) != VK_SUCCESS) {
-        vkDestroyBuffer(device, voxelBuffer, nullptr);
-        vkFreeMemory(device, voxelMemory, nullptr);
-        vkDestroyBuffer(device, vertexBuffer, nullptr);
-        vkFreeMemory(device, vertexMemory, nullptr);
-        vkDestroyBuffer(device, indexBuffer, nullptr);
-        vkFreeMemory(device, indexMemory, nullptr);
-        vkDestroyBuffer(device, counterBuffer, nullptr);
-        vkFreeMemory(device, counterMemory, nullptr);
+
+    meshData.vertexCount = static_cast<uint32_t>(vertices.size());
+    meshData.indexCount = static_cast<uint32_t>(indices.size());
+    meshData.indexType = indexType;
+    pendingMeshes.push_back({node, meshData, uploadQueue->getRecordingSerial()});
+    return true;
+}
+
+bool World::createQuadBuffer(NodeIndex node, const std::vector<MeshQuad>& quads) {
+    const VkDeviceSize bufferSize = sizeof(MeshQuad) * quads.size();
+
+    // Records are read by quad.vert from the quad arena, there are no indices
+    MeshData meshData{};
+    meshData.format = MeshFormat::QUADS;
+    meshData.vertices = quadArena->allocate(static_cast<uint32_t>(quads.size()));
+    if (meshData.vertices == BufferArena::INVALID_HANDLE ||
+        !uploadQueue->upload(quadArena->getBuffer(quadArena->getRange(meshData.vertices).page),
+                             quadArena->getByteOffset(meshData.vertices), quads.data(), bufferSize)) {
+        cleanupMeshData(meshData);
         return false;
     }
 
-    // Begin command buffer
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-    // Bind pipeline and descriptor set
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, computePipeline);
-    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSet, 0, nullptr);
-
-    // Push constants
-    struct PushConstants {
-        glm::ivec3 nodePosition;
-        uint32_t nodeSize;
-        uint32_t maxVertices;
-        uint32_t maxIndices;
-    } pushConstants;
-
-    pushConstants.nodePosition = node->position;
-    pushConstants.nodeSize = node->size;
-    pushConstants.maxVertices = maxVertices;
-    pushConstants.maxIndices = maxIndices;
-
-    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(PushConstants), &pushConstants);
-
-    // Dispatch compute shader
-    const uint32_t workGroupSize = 8;
-    uint32_t groupCount = (node->size + workGroupSize - 1) / workGroupSize;
-    vkCmdDispatch(commandBuffer, groupCount, groupCount, groupCount);
-
-    // Memory barrier to ensure compute shader writes are visible
-    VkMemoryBarrier memoryBarrier{};
-    memoryBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
-    memoryBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
-    memoryBarrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_HOST_READ_BIT;
-
-    vkCmdPipelineBarrier(
-        commandBuffer,
-        VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
-        VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_HOST_BIT,
-        0,
-        1, &memoryBarrier,
-        0, nullptr,
-        0, nullptr
-    );
-
-    // End command buffer
-    vkEndCommandBuffer(commandBuffer);
-
-    // Submit command buffer
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    VkFence fence;
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    vkCreateFence(device, &fenceInfo, nullptr, &fence);
-
-    vkQueueSubmit(computeQueue, 1, &submitInfo, fence);
-    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-
-    // Clean up command buffer and fence
-    vkDestroyFence(device, fence, nullptr);
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-
-    // Get vertex and index counts from counter buffer
-    vkMapMemory(device, counterMemory, 0, counterBufferSize, 0, (void**)&counterData);
-    uint32_t vertexCount = counterData[0];
-    uint32_t indexCount = counterData[1];
-    vkUnmapMemory(device, counterMemory);
-
-    // Clean up counter buffer
-    vkDestroyBuffer(device, counterBuffer, nullptr);
-    vkFreeMemory(device, counterMemory, nullptr);
-
-    // Store mesh data in node
-    auto& meshData = meshes[node];
-    if (meshData.vertexBuffer != VK_NULL_HANDLE) {
-        cleanupMeshData(meshData);
+    meshData.vertexCount = static_cast<uint32_t>(quads.size()) * 4;
+    meshData.indexCount = static_cast<uint32_t>(quads.size()) * 6;
+    pendingMeshes.push_back({node, meshData, uploadQueue->getRecordingSerial()});
+    return true;
+}
+
+void World::replaceMesh(NodeIndex node, const MeshData& meshData) {
+    auto it = meshes.find(node);
+    if (it != meshes.end()) {
+        cleanupMeshData(it->second);
     }
+    meshes[node] = meshData;
+    meshGeneration++;
+}
 
-    meshData.vertexBuffer = vertexBuffer;
-    meshData.vertexMemory = vertexMemory;
-    meshData.indexBuffer = indexBuffer;
-    meshData.indexMemory = indexMemory;
-    meshData.vertexCount = vertexCount;
-    meshData.indexCount = indexCount;
+void World::finishUploads() {
+    // Pending meshes are in submission order, so a node's newest mesh is swapped in last
+    size_t kept = 0;
+    for (size_t i = 0; i < pendingMeshes.size(); ++i) {
+        PendingMesh& pending = pendingMeshes[i];
+        if (!uploadQueue->isComplete(pending.serial)) {
+            pendingMeshes[kept++] = pending;
+        } else if (pending.cancelled) {
+            cleanupMeshData(pending.meshData);
+        } else {
+            replaceMesh(pending.node, pending.meshData);
+        }
+    }
+    pendingMeshes.resize(kept);
+}
 
-    // Update node's mesh vector
-    node->meshes.clear();
-    node->meshes.push_back(meshData);
+bool World::createQuadDescriptorPool() {
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = MAX_QUAD_PAGES;
 
-    std::cout << "World: Generated mesh for node with " << vertexCount << " vertices and "
-              << indexCount << " indices" << std::endl;
+    // Sets are freed one at a time as arena pages are released
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+    poolInfo.maxSets = MAX_QUAD_PAGES;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
 
-    // Clean up voxel buffer
-    vkDestroyBuffer(device, voxelBuffer, nullptr);
-    vkFreeMemory(device, voxelMemory, nullptr);
+    return vkCreateDescriptorPool(device, &poolInfo, nullptr, &quadDescriptorPool) == VK_SUCCESS;
+}
 
+bool World::createMeshArenas() {
+    vertexArena = std::make_unique<BufferArena>(context, VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, sizeof(MeshVertex));
+    indexArena = std::make_unique<BufferArena>(context, VK_BUFFER_USAGE_INDEX_BUFFER_BIT, sizeof(uint32_t));
+    quadArena = std::make_unique<BufferArena>(context, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, sizeof(MeshQuad));
     return true;
 }
 
-void World::cleanupMeshData(MeshData& meshData) {
-    if (meshData.vertexBuffer != VK_NULL_HANDLE) {
-        vkDestroyBuffer(device, meshData.vertexBuffer, nullptr);
-        meshData.vertexBuffer = VK_NULL_HANDLE;
+void World::updateQuadPageSets() {
+    // A page is only released once no frame in flight reads it, so neither does its set
+    for (uint32_t page = 0; page < quadArena->getPageSlotCount(); ++page) {
+        VkBuffer buffer = quadArena->getBuffer(page);
+        if (page >= quadPageSets.size()) {
+            quadPageSets.resize(page + 1, VK_NULL_HANDLE);
+            quadPageBuffers.resize(page + 1, VK_NULL_HANDLE);
+        }
+        if (quadPageBuffers[page] == buffer) continue;
+
+        if (quadPageSets[page] != VK_NULL_HANDLE) {
+            vkFreeDescriptorSets(device, quadDescriptorPool, 1, &quadPageSets[page]);
+            quadPageSets[page] = VK_NULL_HANDLE;
+        }
+        quadPageBuffers[page] = VK_NULL_HANDLE;
+        if (buffer == VK_NULL_HANDLE) continue;
+
+        VkDescriptorSetLayout layout = renderer->getQuadSetLayout();
+        VkDescriptorSetAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+        allocInfo.descriptorPool = quadDescriptorPool;
+        allocInfo.descriptorSetCount = 1;
+        allocInfo.pSetLayouts = &layout;
+
+        if (vkAllocateDescriptorSets(device, &allocInfo, &quadPageSets[page]) != VK_SUCCESS) {
+            std::cerr << "World: Out of quad page descriptor sets" << std::endl;
+            quadPageSets[page] = VK_NULL_HANDLE;
+            continue;
+        }
+
+        VkDescriptorBufferInfo bufferInfo{};
+        bufferInfo.buffer = buffer;
+        bufferInfo.offset = 0;
+        bufferInfo.range = VK_WHOLE_SIZE;
+
+        VkWriteDescriptorSet write{};
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.dstSet = quadPageSets[page];
+        write.dstBinding = 0;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        write.descriptorCount = 1;
+        write.pBufferInfo = &bufferInfo;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+        quadPageBuffers[page] = buffer;
     }
-    if (meshData.vertexMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(device, meshData.vertexMemory, nullptr);
-        meshData.vertexMemory = VK_NULL_HANDLE;
+}
+
+void World::compactMeshArenas() {
+    // Meshes whose copies have finished are drawn from their new ranges from now on
+    BufferArena* arenas[] = {vertexArena.get(), indexArena.get(), quadArena.get()};
+    VkDeviceSize moved = 0;
+    for (BufferArena* arena : arenas) {
+        arena->advanceFrame();
+        moved += arena->finishMoves(*uploadQueue);
     }
-    if (meshData.indexBuffer != VK_NULL_HANDLE) {
-        vkDestroyBuffer(device, meshData.indexBuffer, nullptr);
-        meshData.indexBuffer = VK_NULL_HANDLE;
+    if (moved > 0) {
+        meshGeneration++;  // Ranges changed under stable handles
+        std::cout << "World: Compacted " << moved / 1024 << " KB of meshes" << std::endl;
     }
-    if (meshData.indexMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(device, meshData.indexMemory, nullptr);
-        meshData.indexMemory = VK_NULL_HANDLE;
+
+    // Each arena copies a slice of its sparsest page with the next upload batch
+    for (BufferArena* arena : arenas) {
+        arena->compact(*uploadQueue, MESH_COMPACTION_BUDGET);
     }
+}
+
+void World::cleanupMeshData(MeshData& meshData) {
+    // Ranges stay readable until the frames that may draw them have finished
+    (meshData.format == MeshFormat::QUADS ? quadArena : vertexArena)->free(meshData.vertices);
+    indexArena->free(meshData.indices);
+    meshData.vertices = BufferArena::INVALID_HANDLE;
+    meshData.indices = BufferArena::INVALID_HANDLE;
     meshData.vertexCount = 0;
     meshData.indexCount = 0;
+    meshData.indexType = VK_INDEX_TYPE_UINT32;
+    meshData.format = MeshFormat::INDEXED;
 }
 
 void World::update() {
+    // Swap in meshes whose upload batch has finished
+    if (uploadQueue) {
+        finishUploads();
+    }
+
     // Update LOD based on camera position
     if (renderer) {
         const Camera* camera = renderer->getCamera();
@@ -1043,120 +1082,24 @@ void World::update() {
         }
     }
 
-    // Optimize nodes if needed
+    // Collapse subtrees that became homogeneous since the last frame
     optimizeNodes();
-}
-
-bool World::createBuffer(uint64_t size, uint32_t usage, uint32_t properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory) {
-    VkBufferCreateInfo bufferInfo{};
-    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    bufferInfo.size = size;
-    bufferInfo.usage = usage;
-    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
-        std::cerr << "World: Failed to create buffer" << std::endl;
-        return false;
-    }
-
-    VkMemoryRequirements memRequirements;
-    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
-
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS) {
-        std::cerr << "World: Failed to allocate buffer memory" << std::endl;
-        vkDestroyBuffer(device, buffer, nullptr);
-        return false;
-    }
-
-    if (vkBindBufferMemory(device, buffer, bufferMemory, 0) != VK_SUCCESS) {
-        std::cerr << "World: Failed to bind buffer memory" << std::endl;
-        vkDestroyBuffer(device, buffer, nullptr);
-        vkFreeMemory(device, bufferMemory, nullptr);
-        return false;
-    }
-
-    return true;
-}
 
-void World::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, uint64_t size) {
-    // Create command buffer for transfer
-    VkCommandBufferAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-    allocInfo.commandPool = commandPool;
-    allocInfo.commandBufferCount = 1;
-
-    VkCommandBuffer commandBuffer;
-    if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS) {
-        std::cerr << "World: Failed to allocate command buffer for buffer copy" << std::endl;
-        return;
+    // Everything staged this frame goes out in one batch. Compaction stages its copies after
+    // it, so they go out with the next batch and only read data earlier batches wrote.
+    if (uploadQueue) {
+        uploadQueue->flush();
     }
 
-    // Begin command buffer
-    VkCommandBufferBeginInfo beginInfo{};
-    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-    vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-    // Copy buffer
-    VkBufferCopy copyRegion{};
-    copyRegion.srcOffset = 0;
-    copyRegion.dstOffset = 0;
-    copyRegion.size = size;
-    vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-    vkEndCommandBuffer(commandBuffer);
-
-    // Submit command buffer
-    VkSubmitInfo submitInfo{};
-    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-    submitInfo.commandBufferCount = 1;
-    submitInfo.pCommandBuffers = &commandBuffer;
-
-    // Create fence to ensure copy completes before function returns
-    VkFenceCreateInfo fenceInfo{};
-    fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-    
-    VkFence fence;
-    if (vkCreateFence(device, &fenceInfo, nullptr, &fence) != VK_SUCCESS) {
-        std::cerr << "World: Failed to create fence for buffer copy" << std::endl;
-        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-        return;
+    // Recycle ranges of replaced meshes and empty sparse pages, then bind any new quad pages
+    if (vertexArena && uploadQueue) {
+        compactMeshArenas();
+        updateQuadPageSets();
     }
 
-    // Submit and wait
-    if (vkQueueSubmit(computeQueue, 1, &submitInfo, fence) != VK_SUCCESS) {
-        std::cerr << "World: Failed to submit buffer copy command" << std::endl;
-        vkDestroyFence(device, fence, nullptr);
-        vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-        return;
-    }
-
-    vkWaitForFences(device, 1, &fence, VK_TRUE, UINT64_MAX);
-
-    // Cleanup
-    vkDestroyFence(device, fence, nullptr);
-    vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
+    // Dispatches go out last, after the batch carrying their voxel data
+    submitMeshBatches();
 }
 
-uint32_t World::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) {
-    VkPhysicalDeviceMemoryProperties memProperties;
-    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
-
-    for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++) {
-        if ((typeFilter & (1 << i)) && 
-            (memProperties.memoryTypes[i].propertyFlags & properties) == properties) {
-            return i;
-        }
-    }
-
-    throw std::runtime_error("Failed to find suitable memory type");
-}
 } // namespace voxceleron 
 
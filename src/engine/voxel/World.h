@@ -1,22 +1,41 @@
 #pragma once
 
+#include <array>
 #include <memory>
 #include <vector>
 #include <unordered_map>
 #include <glm/glm.hpp>
 #include <vulkan/vulkan.h>
 #include "VoxelTypes.h"
+#include "FlatOctree.h"
+#include "MeshTypes.h"
+#include "CpuMesher.h"
 #include "../vulkan/core/Vertex.h"
 
 namespace voxceleron {
 
 class Camera;
 class WorldRenderer;
+struct RenderTarget;
 class VulkanContext;
+class UploadQueue;
+class MeshGenerator;
 
 // Maximum level of detail for the octree
 static constexpr uint32_t MAX_LEVEL = 16;
 
+// Brick edge length as a power of two, leaves at brick level hold palette-compressed voxels
+static constexpr uint32_t BRICK_SIZE_LOG2 = DEFAULT_BRICK_SIZE_LOG2;
+
+// Largest node edge length the compute mesher is given in one dispatch
+static constexpr uint32_t MAX_MESH_NODE_SIZE = 1u << BRICK_SIZE_LOG2;
+
+// Where leaf meshes are built
+enum class MeshBackend {
+    COMPUTE,  // MeshGenerator, every node of a batch in the same dispatches
+    CPU       // CpuMesher worker pool, results uploaded as they finish
+};
+
 // LOD constants
 struct LODParameters {
     float baseDistance = 100.0f;     // Distance for LOD level 0
@@ -33,16 +52,26 @@ public:
     // Core world manipulation
     void setVoxel(const glm::ivec3& pos, const Voxel& voxel);
     Voxel getVoxel(const glm::ivec3& pos) const;
+
+    // Batched edits/queries over count positions, much cheaper than per-voxel calls
+    void setVoxels(const glm::ivec3* positions, const Voxel* voxels, size_t count);
+    void getVoxels(const glm::ivec3* positions, Voxel* voxels, size_t count) const;
+
+    // Region edits, box corners are inclusive. Covered subtrees collapse to uniform nodes.
+    void fillBox(const glm::ivec3& min, const glm::ivec3& max, const Voxel& voxel);
+    void fillSphere(const glm::ivec3& center, float radius, const Voxel& voxel);
+    void replaceType(const glm::ivec3& min, const glm::ivec3& max, uint32_t fromType, const Voxel& voxel);
+    void clearRegion(const glm::ivec3& min, const glm::ivec3& max);
     
     // LOD and mesh generation
     void updateLOD(const glm::vec3& viewerPos);
     void generateMeshes(const glm::vec3& viewerPos);
-    bool generateMeshForNode(OctreeNode* node);
+    bool generateMeshForNode(NodeIndex node, const NodeBounds& bounds);
     
     // Node management
-    bool optimizeNodes();
-    void subdivideNode(OctreeNode* node);
-    void optimizeNode(OctreeNode* node);
+    bool optimizeNodes();  // Collapses homogeneous subtrees left behind by recent edits
+    void subdivideNode(NodeIndex node);
+    void optimizeNode(NodeIndex node);
     
     // Statistics and memory
     size_t getMemoryUsage() const;
@@ -60,74 +89,169 @@ public:
 
     // Rendering
     void prepareFrame(const Camera& camera);
-    void render(VkCommandBuffer commandBuffer);
+    void recordCulling(VkCommandBuffer commandBuffer);  // Before the render pass begins
+    bool usesSecondaryCommandBuffers() const;  // Render pass contents render() needs
+    void render(VkCommandBuffer commandBuffer, const RenderTarget& target);
     
     // Debug visualization
     void setDebugVisualization(bool enabled);
     bool isDebugVisualizationEnabled() const;
 
+    // Meshing backend and mode, switching only affects nodes meshed afterwards
+    void setMeshBackend(MeshBackend backend, MeshingMode mode = MeshingMode::GREEDY);
+    MeshBackend getMeshBackend() const { return meshBackend; }
+    MeshingMode getMeshingMode() const { return meshingMode; }
+
+    // QUADS stores one record per face drawn by vertex pulling, applies to nodes meshed afterwards
+    void setMeshFormat(MeshFormat format);
+    MeshFormat getMeshFormat() const { return meshFormat; }
+
+    // Faces and quads of every mesh generated since the last reset
+    const MeshStats& getMeshStats() const { return meshStats; }
+    void resetMeshStats() { meshStats = MeshStats{}; }
+
     // LOD parameters
     void setLODParameters(const LODParameters& params) { lodParams = params; }
     const LODParameters& getLODParameters() const { return lodParams; }
 
     // Getters
-    const OctreeNode* getRoot() const { return root.get(); }
-    OctreeNode* getRoot() { return root.get(); }
+    const FlatOctree& getOctree() const { return octree; }
+    const MeshData* findMesh(NodeIndex node) const;
+    const std::unordered_map<NodeIndex, MeshData>& getMeshes() const { return meshes; }
+    // Changes whenever a mesh is added, removed or moved within its arena
+    uint64_t getMeshGeneration() const { return meshGeneration; }
+    const BufferArena& getVertexArena() const { return *vertexArena; }
+    const BufferArena& getIndexArena() const { return *indexArena; }
+    const BufferArena& getQuadArena() const { return *quadArena; }
+    VkDescriptorSet getQuadPageSet(uint32_t page) const {
+        return page < quadPageSets.size() ? quadPageSets[page] : VK_NULL_HANDLE;
+    }
     
 private:
     // Octree management
-    std::unique_ptr<OctreeNode> root;
-    const OctreeNode* findNode(const glm::ivec3& pos) const;
-    OctreeNode* findNode(const glm::ivec3& pos, bool create = false);
+    FlatOctree octree;
+    NodeIndex findNode(const glm::ivec3& pos, NodeBounds* bounds = nullptr) const;
+    void releaseMeshes(NodeIndex node);
+    void dropMesh(NodeIndex node);  // Frees the node's mesh and forgets any CPU job in flight for it
+    void releaseStaleMeshes();  // Meshes of nodes the octree released on its own
 
     // Memory management
-    MemoryPool<OctreeNode> nodePool;
-    std::unordered_map<OctreeNode*, std::unique_ptr<MeshCacheEntry>> meshCache;
+    std::unordered_map<NodeIndex, std::unique_ptr<MeshCacheEntry>> meshCache;
     void cleanupOldCacheEntries();
     
-    // LOD management
+    // LOD management. Desired levels only change where a node's distance to the viewer crosses
+    // a power of two, so a pass runs when the viewer enters another cell and descends only into
+    // subtrees whose distances from the last and the new position straddle one. Edits leave
+    // nodes no pass has seen, the next pass after one visits the whole tree.
+    static constexpr float LOD_CELL_SIZE = float(MAX_MESH_NODE_SIZE);
     LODParameters lodParams;
+    glm::ivec3 lodCell;      // Viewer cell of the last pass
+    glm::vec3 lodViewerPos;  // Viewer position of the last pass
+    bool lodStale;           // No pass yet or the tree was edited since
+    void updateNodeLOD(NodeIndex node, const NodeBounds& bounds, const glm::vec3& viewerPos, bool full);
     float calculateNodeLOD(const glm::vec3& nodePos, float nodeSize, const glm::vec3& viewerPos);
-    bool shouldGenerateMesh(OctreeNode* node, const glm::vec3& viewerPos);
+    bool shouldGenerateMesh(NodeIndex node, const glm::vec3& viewerPos);
     
     // Vulkan resources
     VulkanContext* context;
     VkDevice device;
     VkPhysicalDevice physicalDevice;
-    VkDescriptorPool descriptorPool;
-    VkDescriptorSetLayout descriptorSetLayout;
-    VkPipelineLayout pipelineLayout;
-    VkPipeline computePipeline;
     VkQueue computeQueue;
     VkCommandPool commandPool;
     
     // Mesh data
-    struct MeshData {
-        VkBuffer vertexBuffer;
-        VkDeviceMemory vertexMemory;
-        VkBuffer indexBuffer;
-        VkDeviceMemory indexMemory;
-        uint32_t vertexCount;
-        uint32_t indexCount;
-    };
-    std::unordered_map<OctreeNode*, MeshData> meshes;
+    std::unordered_map<NodeIndex, MeshData> meshes;
+    uint64_t meshGeneration;
+    std::vector<NodeIndex> meshQueue;  // Dirty nodes waiting for a mesh, failures carry over
+
+    // CPU meshing
+    MeshBackend meshBackend;
+    MeshingMode meshingMode;
+    MeshFormat meshFormat;
+    MeshStats meshStats;
+    std::unique_ptr<CpuMesher> cpuMesher;
+    std::unordered_map<NodeIndex, uint64_t> pendingMeshJobs;  // Latest ticket submitted per node, either backend
+    uint64_t nextMeshTicket;
+    bool submitCpuMesh(NodeIndex node, const NodeBounds& bounds);
+    void collectCpuMeshes();
 
     // Mesh generation
-    void addCubeToMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, const Voxel& voxel);
-    bool createMeshBuffers(OctreeNode* node, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices);
+    bool createMeshBuffers(NodeIndex node, const std::vector<MeshVertex>& vertices, const std::vector<uint32_t>& indices);
+    bool createQuadBuffer(NodeIndex node, const std::vector<MeshQuad>& quads);
+    void replaceMesh(NodeIndex node, const MeshData& meshData);
+
+    // Every voxel and mesh upload is staged in this ring and copied by one batch per frame
+    std::unique_ptr<UploadQueue> uploadQueue;
+
+    // Uploaded meshes wait here until their batch has finished, the node keeps drawing its
+    // previous mesh meanwhile
+    struct PendingMesh {
+        NodeIndex node;
+        MeshData meshData;
+        uint64_t serial;         // Upload batch the mesh's data goes out with
+        bool cancelled = false;  // Node dropped its mesh, freed once the batch is done
+    };
+    std::vector<PendingMesh> pendingMeshes;
+    void finishUploads();
+
+    // Compute meshing never waits on the device. Jobs are added to a batch whose voxel
+    // uploads go out with the frame's upload batch, its dispatches are submitted right after.
+    // A later frame reads the counters once the fence has signaled and copies the exact
+    // results out of the batch with its upload batch, the batch is reused when that finished.
+    // MeshGenerator owns the batches' buffers, World schedules them.
+    static constexpr uint32_t MESH_BATCH_COUNT = 3;  // Recording, running and copying
+    static constexpr uint32_t MESH_BATCH_JOBS = 16;  // Nodes meshed by one batch's dispatches
+    static constexpr uint32_t MESH_BATCH_QUADS = 4;  // Output per batch, in worst-case nodes
+    enum class MeshBatchState {
+        FREE,
+        RECORDING,
+        RUNNING,
+        COPYING
+    };
+    struct MeshJob {
+        NodeIndex node;
+        uint64_t ticket;
+    };
+    struct MeshBatch {
+        MeshBatchState state = MeshBatchState::FREE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        MeshFormat format = MeshFormat::INDEXED;  // Shared by every job, the pipelines differ
+        bool greedy = false;
+        std::vector<MeshJob> jobs;                // Indexed by the job's MeshGenerator slot
+        uint64_t copySerial = 0;                  // Upload batch copying the results out
+    };
+    std::array<MeshBatch, MESH_BATCH_COUNT> meshBatches;
+    std::unique_ptr<MeshGenerator> meshGenerator;
+    bool createMeshGenerator();
+    bool createMeshBatches();
+    void destroyMeshBatches();
+    MeshBatch* getRecordingMeshBatch();
+    void submitMeshBatches();
+    void collectComputeMeshes();
+
+    // Every mesh lives in these arenas, so the renderer binds buffers per page instead of per node
+    static constexpr VkDeviceSize MESH_COMPACTION_BUDGET = VkDeviceSize(4) << 20;  // Bytes moved per frame
+    std::unique_ptr<BufferArena> vertexArena;  // MeshVertex records
+    std::unique_ptr<BufferArena> indexArena;   // 32-bit index words
+    std::unique_ptr<BufferArena> quadArena;    // MeshQuad records
+    bool createMeshArenas();
+    void compactMeshArenas();
+
+    // One descriptor set per quad arena page binds its records to quad.vert
+    static constexpr uint32_t MAX_QUAD_PAGES = 64;
+    VkDescriptorPool quadDescriptorPool;
+    std::vector<VkDescriptorSet> quadPageSets;
+    std::vector<VkBuffer> quadPageBuffers;  // Page buffer each set was written for
+    bool createQuadDescriptorPool();
+    void updateQuadPageSets();
 
     // Rendering
     std::unique_ptr<WorldRenderer> renderer;
     
     // Vulkan helpers
     void createTestScene();
-    bool createComputePipeline();
-    bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage,
-                     VkMemoryPropertyFlags properties, VkBuffer& buffer,
-                     VkDeviceMemory& bufferMemory);
-    void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
     void cleanupMeshData(MeshData& meshData);
-    uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
     uint32_t findComputeQueueFamily(VkPhysicalDevice physicalDevice);
 
     // Debug
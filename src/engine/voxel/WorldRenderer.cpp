@@ -7,25 +7,32 @@
 #include <glm/gtx/vector_angle.hpp>
 #include <iostream>
 #include <algorithm>
+#include <cstring>
 
 namespace voxceleron {
 
 WorldRenderer::WorldRenderer()
     : device(VK_NULL_HANDLE)
     , physicalDevice(VK_NULL_HANDLE)
-    , debugVisualization(false)
-    , currentCamera(nullptr)
+    , allocator(nullptr)
     , pipelineLayout(VK_NULL_HANDLE)
     , graphicsPipeline(VK_NULL_HANDLE)
+    , quadPipelineLayout(VK_NULL_HANDLE)
+    , quadPipeline(VK_NULL_HANDLE)
+    , quadSetLayout(VK_NULL_HANDLE)
+    , drawIndexedIndirectCount(nullptr)
+    , gpuDrawsRecorded(false)
+    , debugVisualization(false)
+    , currentCamera(nullptr)
+    , currentWorld(nullptr)
     , viewProjection(1.0f)
-    , cameraPosition(0.0f) {
+    , cameraPosition(0.0f)
+    , quadIndexBuffer(VK_NULL_HANDLE) {
     std::cout << "WorldRenderer: Creating world renderer instance" << std::endl;
 
     // Initialize debug mesh resources
     debugMesh.vertexBuffer = VK_NULL_HANDLE;
-    debugMesh.vertexMemory = VK_NULL_HANDLE;
     debugMesh.indexBuffer = VK_NULL_HANDLE;
-    debugMesh.indexMemory = VK_NULL_HANDLE;
     debugMesh.descriptorSet = VK_NULL_HANDLE;
     debugMesh.vertexCount = 0;
     debugMesh.indexCount = 0;
@@ -37,6 +44,9 @@ WorldRenderer::WorldRenderer()
     settings.enableFrustumCulling = true;
     settings.enableLOD = true;
     settings.enableOcclusion = true;
+    settings.enableGpuCulling = true;
+    settings.enableParallelRecording = true;
+    settings.minDrawsPerRecorder = 256;
 }
 
 WorldRenderer::~WorldRenderer() {
@@ -44,71 +54,85 @@ WorldRenderer::~WorldRenderer() {
     cleanup();
 }
 
-bool WorldRenderer::initialize(VkDevice device, VkPhysicalDevice physicalDevice) {
+bool WorldRenderer::initialize(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator* allocator,
+                               uint32_t graphicsQueueFamily) {
     std::cout << "WorldRenderer: Starting initialization..." << std::endl;
     this->device = device;
     this->physicalDevice = physicalDevice;
+    this->allocator = allocator;
+
+    // Culling resources come first, their draw set is part of both pipeline layouts
+    drawCuller = std::make_unique<DrawCuller>(device, allocator);
+    if (!drawCuller->initialize()) {
+        std::cerr << "WorldRenderer: Failed to initialize draw culler" << std::endl;
+        return false;
+    }
+
+    // Only loaded if the context enabled the extension, along with the indirect draw features
+    drawIndexedIndirectCount = reinterpret_cast<PFN_vkCmdDrawIndexedIndirectCountKHR>(
+        vkGetDeviceProcAddr(device, "vkCmdDrawIndexedIndirectCountKHR"));
+    std::cout << "WorldRenderer: GPU culling " << (drawIndexedIndirectCount ? "available" : "unsupported") << std::endl;
 
-    // Create pipeline layout
+    // Create pipeline layouts, both pipelines take the camera and node origin as push constants
+    // and read origins of GPU-culled draws from the draw set
     VkPushConstantRange pushConstantRange{};
     pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
     pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(glm::mat4);  // Model matrix
+    pushConstantRange.size = sizeof(DrawConstants);  // View projection, node origin and scale
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
     pipelineLayoutInfo.pushConstantRangeCount = 1;
     pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
+    VkDescriptorSetLayout drawSetLayout = drawCuller->getDrawSetLayout();
+    pipelineLayoutInfo.setLayoutCount = 1;
+    pipelineLayoutInfo.pSetLayouts = &drawSetLayout;
+
     std::cout << "WorldRenderer: Creating pipeline layout..." << std::endl;
     if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
         std::cerr << "WorldRenderer: Failed to create pipeline layout" << std::endl;
         return false;
     }
 
-    // Create graphics pipeline
-    std::cout << "WorldRenderer: Creating graphics pipeline..." << std::endl;
-    VkShaderModule vertShaderModule = createShaderModule("shaders/basic.vert.spv");
-    VkShaderModule fragShaderModule = createShaderModule("shaders/basic.frag.spv");
-    
-    if (!vertShaderModule || !fragShaderModule) {
-        std::cerr << "WorldRenderer: Failed to create shader modules" << std::endl;
+    // QUADS meshes bind their records as a storage buffer read by quad.vert
+    VkDescriptorSetLayoutBinding quadBinding{};
+    quadBinding.binding = 0;
+    quadBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    quadBinding.descriptorCount = 1;
+    quadBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+
+    VkDescriptorSetLayoutCreateInfo quadSetLayoutInfo{};
+    quadSetLayoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+    quadSetLayoutInfo.bindingCount = 1;
+    quadSetLayoutInfo.pBindings = &quadBinding;
+
+    if (vkCreateDescriptorSetLayout(device, &quadSetLayoutInfo, nullptr, &quadSetLayout) != VK_SUCCESS) {
+        std::cerr << "WorldRenderer: Failed to create quad descriptor set layout" << std::endl;
         return false;
     }
 
-    VkPipelineShaderStageCreateInfo shaderStages[2] = {};
-    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
-    shaderStages[0].module = vertShaderModule;
-    shaderStages[0].pName = "main";
-
-    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
-    shaderStages[1].module = fragShaderModule;
-    shaderStages[1].pName = "main";
+    // The draw set stays at set 0, so it stays bound across both pipelines
+    const VkDescriptorSetLayout quadSetLayouts[2] = {drawSetLayout, quadSetLayout};
+    pipelineLayoutInfo.setLayoutCount = 2;
+    pipelineLayoutInfo.pSetLayouts = quadSetLayouts;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &quadPipelineLayout) != VK_SUCCESS) {
+        std::cerr << "WorldRenderer: Failed to create quad pipeline layout" << std::endl;
+        return false;
+    }
 
-    // Vertex input state
+    // Indexed meshes read packed vertices as attributes
     VkVertexInputBindingDescription bindingDescription{};
     bindingDescription.binding = 0;
-    bindingDescription.stride = sizeof(float) * 8; // pos(3) + normal(3) + uv(2)
+    bindingDescription.stride = sizeof(MeshVertex); // Two packed words, unpacked in basic.vert
     bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
 
-    std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-    // Position
+    std::array<VkVertexInputAttributeDescription, 1> attributeDescriptions{};
+    // Packed position/normal/occlusion and voxel
     attributeDescriptions[0].binding = 0;
     attributeDescriptions[0].location = 0;
-    attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
+    attributeDescriptions[0].format = VK_FORMAT_R32G32_UINT;
     attributeDescriptions[0].offset = 0;
-    // Normal
-    attributeDescriptions[1].binding = 0;
-    attributeDescriptions[1].location = 1;
-    attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-    attributeDescriptions[1].offset = sizeof(float) * 3;
-    // UV
-    attributeDescriptions[2].binding = 0;
-    attributeDescriptions[2].location = 2;
-    attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-    attributeDescriptions[2].offset = sizeof(float) * 6;
 
     VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
     vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -117,6 +141,60 @@ bool WorldRenderer::initialize(VkDevice device, VkPhysicalDevice physicalDevice)
     vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
     vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 
+    // Quad meshes pull everything from their storage buffer
+    VkPipelineVertexInputStateCreateInfo quadInputInfo{};
+    quadInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
+
+    std::cout << "WorldRenderer: Creating graphics pipelines..." << std::endl;
+    if (!createGraphicsPipeline("shaders/basic.vert.spv", vertexInputInfo, pipelineLayout, graphicsPipeline) ||
+        !createGraphicsPipeline("shaders/quad.vert.spv", quadInputInfo, quadPipelineLayout, quadPipeline)) {
+        return false;
+    }
+
+    if (!createQuadIndexBuffer()) {
+        std::cerr << "WorldRenderer: Failed to create quad index buffer" << std::endl;
+        return false;
+    }
+
+    if (!createDebugResources()) {
+        std::cerr << "WorldRenderer: Failed to create debug resources" << std::endl;
+        return false;
+    }
+
+    if (!createRecorders(graphicsQueueFamily)) {
+        std::cerr << "WorldRenderer: Failed to create command recorders" << std::endl;
+        return false;
+    }
+    std::cout << "WorldRenderer: Recording draws on up to " << recordPools[0].size() << " threads" << std::endl;
+
+    std::cout << "WorldRenderer: Initialization complete" << std::endl;
+    return true;
+}
+
+bool WorldRenderer::createGraphicsPipeline(const std::string& vertexShader,
+                                           const VkPipelineVertexInputStateCreateInfo& vertexInput,
+                                           VkPipelineLayout layout, VkPipeline& pipeline) {
+    VkShaderModule vertShaderModule = createShaderModule(vertexShader);
+    VkShaderModule fragShaderModule = createShaderModule("shaders/basic.frag.spv");
+    
+    if (!vertShaderModule || !fragShaderModule) {
+        std::cerr << "WorldRenderer: Failed to create shader modules" << std::endl;
+        if (vertShaderModule) vkDestroyShaderModule(device, vertShaderModule, nullptr);
+        if (fragShaderModule) vkDestroyShaderModule(device, fragShaderModule, nullptr);
+        return false;
+    }
+
+    VkPipelineShaderStageCreateInfo shaderStages[2] = {};
+    shaderStages[0].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[0].stage = VK_SHADER_STAGE_VERTEX_BIT;
+    shaderStages[0].module = vertShaderModule;
+    shaderStages[0].pName = "main";
+
+    shaderStages[1].sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    shaderStages[1].stage = VK_SHADER_STAGE_FRAGMENT_BIT;
+    shaderStages[1].module = fragShaderModule;
+    shaderStages[1].pName = "main";
+
     // Input assembly
     VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
     inputAssembly.sType = VK_STRUCTURE_TYPE_PIPELINE_INPUT_ASSEMBLY_STATE_CREATE_INFO;
@@ -182,7 +260,7 @@ bool WorldRenderer::initialize(VkDevice device, VkPhysicalDevice physicalDevice)
     pipelineInfo.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
     pipelineInfo.stageCount = 2;
     pipelineInfo.pStages = shaderStages;
-    pipelineInfo.pVertexInputState = &vertexInputInfo;
+    pipelineInfo.pVertexInputState = &vertexInput;
     pipelineInfo.pInputAssemblyState = &inputAssembly;
     pipelineInfo.pViewportState = &viewportState;
     pipelineInfo.pRasterizationState = &rasterizer;
@@ -190,12 +268,12 @@ bool WorldRenderer::initialize(VkDevice device, VkPhysicalDevice physicalDevice)
     pipelineInfo.pDepthStencilState = &depthStencil;
     pipelineInfo.pColorBlendState = &colorBlending;
     pipelineInfo.pDynamicState = &dynamicState;
-    pipelineInfo.layout = pipelineLayout;
+    pipelineInfo.layout = layout;
     pipelineInfo.renderPass = context->getRenderPass();
     pipelineInfo.subpass = 0;
     pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS) {
+    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) != VK_SUCCESS) {
         std::cerr << "WorldRenderer: Failed to create graphics pipeline" << std::endl;
         vkDestroyShaderModule(device, vertShaderModule, nullptr);
         vkDestroyShaderModule(device, fragShaderModule, nullptr);
@@ -206,15 +284,68 @@ bool WorldRenderer::initialize(VkDevice device, VkPhysicalDevice physicalDevice)
     vkDestroyShaderModule(device, vertShaderModule, nullptr);
     vkDestroyShaderModule(device, fragShaderModule, nullptr);
 
-    if (!createDebugResources()) {
-        std::cerr << "WorldRenderer: Failed to create debug resources" << std::endl;
+    return true;
+}
+
+bool WorldRenderer::createQuadIndexBuffer() {
+    // Six indices per quad splitting it along corners 0-2, the same for every QUADS mesh.
+    // Draws cover QUADS_PER_DRAW quads and move on with vertexOffset, so 16 bits suffice.
+    std::vector<uint16_t> indices;
+    indices.reserve(QUADS_PER_DRAW * 6);
+    for (uint32_t quad = 0; quad < QUADS_PER_DRAW; ++quad) {
+        const uint16_t base = static_cast<uint16_t>(quad * 4);
+        for (uint16_t corner : {0, 1, 2, 0, 2, 3}) {
+            indices.push_back(static_cast<uint16_t>(base + corner));
+        }
+    }
+    return createHostBuffer(indices.data(), indices.size() * sizeof(uint16_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                            quadIndexBuffer, quadIndexAllocation);
+}
+
+bool WorldRenderer::createHostBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+                                     VkBuffer& buffer, MemoryAllocation& allocation) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
         return false;
     }
 
-    std::cout << "WorldRenderer: Initialization complete" << std::endl;
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+    // Written once from the host, prefer memory the GPU reads at full speed
+    if (!allocator->allocate(memRequirements,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            allocation) &&
+        !allocator->allocate(memRequirements,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, allocation)) {
+        destroyBuffer(buffer, allocation);
+        return false;
+    }
+
+    if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        destroyBuffer(buffer, allocation);
+        return false;
+    }
+
+    std::memcpy(allocation.mapped, data, size);
     return true;
 }
 
+void WorldRenderer::destroyBuffer(VkBuffer& buffer, MemoryAllocation& allocation) {
+    if (buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+    }
+    if (allocator) {
+        allocator->free(allocation);
+    }
+}
+
 VkShaderModule WorldRenderer::createShaderModule(const std::string& filename) {
     std::cout << "WorldRenderer: Loading shader " << filename << std::endl;
     
@@ -253,6 +384,7 @@ void WorldRenderer::cleanup() {
     cleanupDebugResources();
 
     if (device != VK_NULL_HANDLE) {
+        destroyRecorders();
         if (graphicsPipeline != VK_NULL_HANDLE) {
             vkDestroyPipeline(device, graphicsPipeline, nullptr);
             graphicsPipeline = VK_NULL_HANDLE;
@@ -261,7 +393,22 @@ void WorldRenderer::cleanup() {
             vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
             pipelineLayout = VK_NULL_HANDLE;
         }
+        if (quadPipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, quadPipeline, nullptr);
+            quadPipeline = VK_NULL_HANDLE;
+        }
+        if (quadPipelineLayout != VK_NULL_HANDLE) {
+            vkDestroyPipelineLayout(device, quadPipelineLayout, nullptr);
+            quadPipelineLayout = VK_NULL_HANDLE;
+        }
+        if (quadSetLayout != VK_NULL_HANDLE) {
+            vkDestroyDescriptorSetLayout(device, quadSetLayout, nullptr);
+            quadSetLayout = VK_NULL_HANDLE;
+        }
+        destroyBuffer(quadIndexBuffer, quadIndexAllocation);
+        drawCuller.reset();
     }
+    drawIndexedIndirectCount = nullptr;
 
     device = VK_NULL_HANDLE;
     physicalDevice = VK_NULL_HANDLE;
@@ -271,129 +418,289 @@ void WorldRenderer::cleanup() {
 void WorldRenderer::prepareFrame(const Camera& camera, World& world) {
     // Update camera data
     currentCamera = &camera;
-    viewProjection = camera.getProjectionMatrix(camera.getFov()) * camera.getViewMatrix();
+    currentWorld = &world;
+    viewProjection = camera.getViewProjectionMatrix();
     cameraPosition = camera.getPosition();
 
+    // Occluders are gathered for this view, both culling paths test against them
+    if (settings.enableOcclusion) {
+        occlusionBuffer.build(world, viewProjection, camera.getFrustum(), cameraPosition);
+    } else {
+        occlusionBuffer.clear();
+    }
+
+    // The GPU path culls every mesh itself, the octree walk only feeds debug boxes then
+    if (isGpuCullingActive() && !debugVisualization) {
+        visibleNodes.clear();
+        renderQueue.clear();
+        return;
+    }
+
     // Update visible nodes
     updateVisibleNodes(camera, world);
+    buildRenderQueue(world);
+}
+
+bool WorldRenderer::isGpuCullingActive() const {
+    return settings.enableGpuCulling && drawIndexedIndirectCount != nullptr && drawCuller;
+}
+
+void WorldRenderer::recordCulling(VkCommandBuffer commandBuffer) {
+    gpuDrawsRecorded = false;
+    if (!drawCuller) return;
+
+    // Advances even when unused, so a frame's culling buffers are never rewritten in flight
+    drawCuller->beginFrame();
+    if (!isGpuCullingActive() || !currentCamera || !currentWorld) return;
+
+    gpuDrawsRecorded = drawCuller->recordCulling(commandBuffer, *currentWorld, currentCamera->getFrustum(),
+                                                 settings.cullingMargin, settings.enableFrustumCulling,
+                                                 settings.enableOcclusion ? &occlusionBuffer : nullptr);
 }
 
-void WorldRenderer::recordCommands(VkCommandBuffer commandBuffer) {
-    // Sort nodes by distance (back-to-front for transparency)
-    std::sort(visibleNodes.begin(), visibleNodes.end(),
-        [](const RenderNode& a, const RenderNode& b) {
-            return a.distance > b.distance;
+bool WorldRenderer::usesSecondaryCommandBuffers() const {
+    return settings.enableParallelRecording && !recordPools[0].empty();
+}
+
+void WorldRenderer::recordCommands(VkCommandBuffer commandBuffer, const RenderTarget& target) {
+    if (!usesSecondaryCommandBuffers()) {
+        recordDraws(commandBuffer, target, 0, renderQueue.size(), true);
+        return;
+    }
+
+    // Pipeline::beginFrame waited for this frame's previous submission, its buffers are free
+    const uint32_t frame = target.frameIndex % FRAMES_IN_FLIGHT;
+    for (VkCommandPool pool : recordPools[frame]) {
+        vkResetCommandPool(device, pool, 0);
+    }
+
+    // Indirect draws are a handful of commands, only the CPU-culled queue is split
+    const size_t drawCount = gpuDrawsRecorded ? 0 : renderQueue.size();
+    const size_t minDraws = std::max<size_t>(settings.minDrawsPerRecorder, 1);
+    const size_t rangeCount = std::clamp<size_t>((drawCount + minDraws - 1) / minDraws, 1, recordPools[frame].size());
+    const size_t rangeSize = (drawCount + rangeCount - 1) / rangeCount;
+
+    // The calling thread takes the last range, which also draws the debug boxes on top
+    recordResults.assign(rangeCount, 0);
+    for (size_t i = 0; i + 1 < rangeCount; ++i) {
+        recordPool.submit([this, &target, frame, i, rangeSize, drawCount]() {
+            const size_t first = std::min(i * rangeSize, drawCount);
+            const size_t last = std::min(first + rangeSize, drawCount);
+            recordResults[i] = recordSecondary(recordBuffers[frame][i], target, first, last, false);
         });
+    }
+    const size_t lastRange = rangeCount - 1;
+    recordResults[lastRange] = recordSecondary(recordBuffers[frame][lastRange], target,
+                                               std::min(lastRange * rangeSize, drawCount), drawCount, true);
+    recordPool.waitIdle();
 
-    // Record commands for each visible node
-    for (const auto& node : visibleNodes) {
-        if (node.isVisible) {
-            recordNodeCommands(commandBuffer, node);
+    if (std::find(recordResults.begin(), recordResults.end(), 0) != recordResults.end()) {
+        std::cerr << "WorldRenderer: Failed to record secondary command buffers" << std::endl;
+        return;
+    }
+    vkCmdExecuteCommands(commandBuffer, static_cast<uint32_t>(rangeCount), recordBuffers[frame].data());
+}
+
+void WorldRenderer::recordDraws(VkCommandBuffer commandBuffer, const RenderTarget& target, size_t first, size_t last,
+                                bool lastRange) {
+    // Dynamic state is not inherited by secondary command buffers, every buffer sets its own
+    VkViewport viewport{};
+    viewport.width = static_cast<float>(target.extent.width);
+    viewport.height = static_cast<float>(target.extent.height);
+    viewport.maxDepth = 1.0f;
+    VkRect2D scissor{};
+    scissor.extent = target.extent;
+    vkCmdSetViewport(commandBuffer, 0, 1, &viewport);
+    vkCmdSetScissor(commandBuffer, 0, 1, &scissor);
+
+    if (drawCuller) {
+        // Set 0 is the same in both layouts, GPU-culled draws read their origins from it
+        VkDescriptorSet drawSet = drawCuller->getDrawSet();
+        vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout,
+                                0, 1, &drawSet, 0, nullptr);
+    }
+
+    BoundState bound;
+    if (gpuDrawsRecorded) {
+        recordIndirectCommands(commandBuffer, bound);
+    } else {
+        // Already in state and front-to-back order
+        for (size_t i = first; i < last; ++i) {
+            recordNodeCommands(commandBuffer, visibleNodes[renderQueue.getItem(i)], bound);
         }
     }
 
     // Record debug visualization if enabled
-    if (debugVisualization) {
-        recordDebugCommands(commandBuffer);
+    if (lastRange && debugVisualization) {
+        recordDebugCommands(commandBuffer, bound);
     }
 }
 
-void WorldRenderer::updateVisibleNodes(const Camera& camera, World& world) {
-    visibleNodes.clear();
+bool WorldRenderer::recordSecondary(VkCommandBuffer commandBuffer, const RenderTarget& target, size_t first,
+                                    size_t last, bool lastRange) {
+    VkCommandBufferInheritanceInfo inheritance{};
+    inheritance.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+    inheritance.renderPass = target.renderPass;
+    inheritance.subpass = 0;
+    inheritance.framebuffer = target.framebuffer;
 
-    if (!world.getRoot()) {
-        return;
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+    beginInfo.pInheritanceInfo = &inheritance;
+
+    if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS) {
+        return false;
     }
+    recordDraws(commandBuffer, target, first, last, lastRange);
+    return vkEndCommandBuffer(commandBuffer) == VK_SUCCESS;
+}
+
+void WorldRenderer::updateVisibleNodes(const Camera& camera, World& world) {
+    visibleNodes.clear();
 
     // Get camera frustum for culling
     const auto& frustum = camera.getFrustum();
 
-    // Start with root node
-    frustumCullNode(world.getRoot(), frustum);
-
-    // Sort nodes by priority
-    std::sort(visibleNodes.begin(), visibleNodes.end(),
-        [this](const RenderNode& a, const RenderNode& b) {
-            return calculateNodePriority(a) > calculateNodePriority(b);
-        });
+    // Start with root node, the walk classifies every node's children together
+    const FlatOctree& octree = world.getOctree();
+    const NodeBounds rootBounds = octree.getRootBounds();
+    FrustumTest rootTest = FRUSTUM_INSIDE;
+    if (settings.enableFrustumCulling) {
+        const float half = rootBounds.size * 0.5f;
+        const glm::vec3 center = glm::vec3(rootBounds.position) + glm::vec3(half);
+        const FrustumBoxes root{&center.x, &center.y, &center.z, &half, &half, &half, 1};
+        classifyBoxes(frustum, root, settings.cullingMargin, &rootTest);
+    }
+    frustumCullNode(world, octree.getRoot(), rootBounds, frustum, rootTest);
 
-    // Limit number of visible nodes
+    // Limit number of visible nodes, keeping the highest priority ones. Draw order is up to
+    // the render queue, so they need not be sorted.
     if (visibleNodes.size() > settings.maxVisibleNodes) {
+        std::nth_element(visibleNodes.begin(), visibleNodes.begin() + settings.maxVisibleNodes, visibleNodes.end(),
+            [](const RenderNode& a, const RenderNode& b) {
+                return a.priority > b.priority;
+            });
         visibleNodes.resize(settings.maxVisibleNodes);
     }
 }
 
-void WorldRenderer::frustumCullNode(const OctreeNode* node, const Camera::Frustum& frustum) {
-    if (!node) return;
+void WorldRenderer::buildRenderQueue(const World& world) {
+    renderQueue.clear();
+    renderQueue.reserve(visibleNodes.size());
+
+    const BufferArena& vertexArena = world.getVertexArena();
+    const BufferArena& indexArena = world.getIndexArena();
+    const BufferArena& quadArena = world.getQuadArena();
+    for (size_t i = 0; i < visibleNodes.size(); ++i) {
+        const RenderNode& node = visibleNodes[i];
+        if (!node.isVisible || !node.mesh || node.mesh->vertices == BufferArena::INVALID_HANDLE) continue;
+
+        // Keyed by the pipeline and arena pages recordNodeCommands binds
+        const MeshData& mesh = *node.mesh;
+        uint64_t key;
+        if (mesh.format == MeshFormat::QUADS) {
+            key = RenderQueue::makeKey(QUEUE_PIPELINE_QUADS, quadArena.getRange(mesh.vertices).page, 0, node.distance);
+        } else {
+            if (mesh.indices == BufferArena::INVALID_HANDLE) continue;
+            key = RenderQueue::makeKey(QUEUE_PIPELINE_INDEXED, vertexArena.getRange(mesh.vertices).page,
+                                       indexArena.getRange(mesh.indices).page, node.distance);
+        }
+        renderQueue.push(key, static_cast<uint32_t>(i));
+    }
+    renderQueue.sort();
+}
+
+void WorldRenderer::frustumCullNode(const World& world, NodeIndex node, const NodeBounds& bounds,
+                                    const Camera::Frustum& frustum, FrustumTest test) {
+    if (node == INVALID_NODE || test == FRUSTUM_OUTSIDE) return;
 
     // Calculate node bounds
-    glm::vec3 center = glm::vec3(node->position) + glm::vec3(node->size / 2.0f);
-    float radius = node->size * 0.5f * settings.cullingMargin;
+    glm::vec3 center = glm::vec3(bounds.position) + glm::vec3(bounds.size / 2.0f);
 
     // Calculate distance to camera
     glm::vec3 toCenter = center - cameraPosition;
     float distance = glm::length(toCenter);
 
-    // Check if node is visible
-    bool visible = !settings.enableFrustumCulling || isNodeVisible(node, frustum);
-
-    if (visible) {
-        // Calculate appropriate LOD level
-        uint32_t lodLevel = settings.enableLOD ? 
-            calculateLODLevel(node, distance) : node->level;
+    // Hidden behind occluders means its whole subtree is too
+    if (settings.enableOcclusion) {
+        const glm::vec3 min(bounds.position);
+        if (occlusionBuffer.isOccluded(min, min + glm::vec3(static_cast<float>(bounds.size)))) {
+            return;
+        }
+    }
 
-        // Add to visible nodes
-        visibleNodes.push_back({
-            node,
-            distance,
-            lodLevel,
-            true
-        });
+    // Calculate appropriate LOD level
+    uint32_t lodLevel = settings.enableLOD ?
+        calculateLODLevel(bounds, distance) : bounds.level;
+
+    // Add to visible nodes
+    visibleNodes.push_back({
+        node,
+        bounds,
+        world.findMesh(node),
+        distance,
+        lodLevel,
+        true,
+        calculateNodePriority(bounds, distance)
+    });
+
+    // Recursively check children if this isn't a leaf and we need more detail
+    const FlatOctree& octree = world.getOctree();
+    if (octree.isLeaf(node) || lodLevel <= bounds.level) {
+        return;
+    }
 
-        // Recursively check children if this isn't a leaf and we need more detail
-        if (!node->isLeaf && lodLevel > node->level) {
-            for (uint8_t i = 0; i < 8; ++i) {
-                if (node->childMask & (1 << i)) {
-                    frustumCullNode(node->nodeData.internal.children[i].get(), frustum);
-                }
-            }
+    NodeIndex children[8];
+    NodeBounds childBounds[8];
+    uint32_t childCount = 0;
+    const uint8_t childMask = octree.getChildMask(node);
+    for (uint8_t i = 0; i < 8; ++i) {
+        if (childMask & (1 << i)) {
+            children[childCount] = octree.getChild(node, i);
+            childBounds[childCount] = FlatOctree::getChildBounds(bounds, i);
+            childCount++;
         }
     }
-}
 
-bool WorldRenderer::isNodeVisible(const OctreeNode* node, const Camera::Frustum& frustum) const {
-    // Calculate node bounds
-    glm::vec3 center = glm::vec3(node->position) + glm::vec3(node->size / 2.0f);
-    float radius = node->size * 0.5f * settings.cullingMargin;
-
-    // Check against each frustum plane
-    for (int i = 0; i < 6; ++i) {
-        const auto& plane = frustum.planes[i];
-        float distance = glm::dot(glm::vec3(plane), center) + plane.w;
-        if (distance < -radius) {
-            return false;
+    // Everything inside a node fully inside the frustum is too, so only straddling nodes
+    // test their children, all of them in one batch
+    FrustumTest childTests[8];
+    std::fill(childTests, childTests + childCount, FRUSTUM_INSIDE);
+    if (test == FRUSTUM_INTERSECTS) {
+        float centerX[8], centerY[8], centerZ[8], extent[8];
+        for (uint32_t i = 0; i < childCount; ++i) {
+            const float half = childBounds[i].size * 0.5f;
+            centerX[i] = childBounds[i].position.x + half;
+            centerY[i] = childBounds[i].position.y + half;
+            centerZ[i] = childBounds[i].position.z + half;
+            extent[i] = half;
         }
+        const FrustumBoxes boxes{centerX, centerY, centerZ, extent, extent, extent, childCount};
+        classifyBoxes(frustum, boxes, settings.cullingMargin, childTests);
     }
 
-    return true;
+    for (uint32_t i = 0; i < childCount; ++i) {
+        frustumCullNode(world, children[i], childBounds[i], frustum, childTests[i]);
+    }
 }
 
-uint32_t WorldRenderer::calculateLODLevel(const OctreeNode* node, float distance) const {
+uint32_t WorldRenderer::calculateLODLevel(const NodeBounds& bounds, float distance) const {
     // Base LOD on distance and node size
-    float factor = distance / (node->size * settings.lodDistanceFactor);
+    float factor = distance / (bounds.size * settings.lodDistanceFactor);
     uint32_t level = static_cast<uint32_t>(glm::log2(factor));
     return glm::clamp(level, 0u, 8u); // Using 8 as MAX_LEVEL
 }
 
-float WorldRenderer::calculateNodePriority(const RenderNode& node) const {
+float WorldRenderer::calculateNodePriority(const NodeBounds& bounds, float distance) const {
     // Priority based on distance and size
-    float sizeFactor = node.node->size / static_cast<float>(1 << 8); // Using 8 as MAX_LEVEL
-    return sizeFactor / (node.distance + 1.0f);
+    float sizeFactor = bounds.size / static_cast<float>(1 << 8); // Using 8 as MAX_LEVEL
+    return sizeFactor / (distance + 1.0f);
 }
 
-void WorldRenderer::recordNodeCommands(VkCommandBuffer commandBuffer, const RenderNode& node) {
+void WorldRenderer::recordNodeCommands(VkCommandBuffer commandBuffer, const RenderNode& node, BoundState& bound) {
     // Skip if node has no mesh data
-    if (!node.node || !node.isVisible) {
+    if (node.node == INVALID_NODE || !node.isVisible) {
         std::cout << "WorldRenderer: Skipping invisible or null node" << std::endl;
         return;
     }
@@ -405,67 +712,177 @@ void WorldRenderer::recordNodeCommands(VkCommandBuffer commandBuffer, const Rend
     }
 
     // Try to find mesh data
-    const auto& meshes = node.node->getMeshes();
-    if (meshes.empty()) {
+    if (!node.mesh) {
         std::cout << "WorldRenderer: Node has no meshes" << std::endl;
         return;
     }
 
-    if (!meshes[0].vertexBuffer || !meshes[0].indexBuffer) {
+    const auto& mesh = *node.mesh;
+    const bool quads = mesh.format == MeshFormat::QUADS;
+    if (mesh.vertices == BufferArena::INVALID_HANDLE || (!quads && mesh.indices == BufferArena::INVALID_HANDLE)) {
         std::cout << "WorldRenderer: Mesh buffers are null" << std::endl;
         return;
     }
 
-    const auto& mesh = meshes[0];
     if (mesh.vertexCount == 0 || mesh.indexCount == 0) {
         std::cout << "WorldRenderer: Mesh has no vertices or indices" << std::endl;
         return;
     }
 
-    std::cout << "WorldRenderer: Drawing mesh with " << mesh.vertexCount << " vertices and "
-              << mesh.indexCount << " indices" << std::endl;
+    // Vertices are relative to the node, push its origin. Mesh units are whole voxels.
+    DrawConstants constants{viewProjection, glm::vec4(glm::vec3(node.bounds.position), 1.0f)};
+
+    if (quads) {
+        // Quads are pulled from the page's storage buffer through the shared index buffer.
+        // gl_VertexIndex includes vertexOffset, so it selects both the mesh's range in the
+        // page and the next batch of QUADS_PER_DRAW quads.
+        const BufferArena::Range& range = currentWorld->getQuadArena().getRange(mesh.vertices);
+        VkDescriptorSet quadSet = currentWorld->getQuadPageSet(range.page);
+        if (quadSet == VK_NULL_HANDLE) {
+            std::cout << "WorldRenderer: Quad page has no descriptor set" << std::endl;
+            return;
+        }
 
-    // Bind pipeline and vertex/index buffers
-    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        if (bound.pipeline != quadPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, quadPipeline);
+            bound.pipeline = quadPipeline;
+        }
+        if (bound.quadSet != quadSet) {
+            vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, quadPipelineLayout,
+                                    1, 1, &quadSet, 0, nullptr);
+            bound.quadSet = quadSet;
+        }
+        if (bound.indexBuffer != quadIndexBuffer || bound.indexType != VK_INDEX_TYPE_UINT16) {
+            vkCmdBindIndexBuffer(commandBuffer, quadIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+            bound.indexBuffer = quadIndexBuffer;
+            bound.indexType = VK_INDEX_TYPE_UINT16;
+        }
+        vkCmdPushConstants(commandBuffer, quadPipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
+                          0, sizeof(DrawConstants), &constants);
 
-    VkDeviceSize offset = 0;
-    VkBuffer vertexBuffers[] = {mesh.vertexBuffer};
-    VkDeviceSize offsets[] = {0};
-    vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-    vkCmdBindIndexBuffer(commandBuffer, mesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-
-    // Calculate and push model matrix
-    glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(node.node->position));
-    model = glm::scale(model, glm::vec3(node.node->size));
-    
-    // Push model matrix as push constant
+        const uint32_t quadCount = mesh.indexCount / 6;
+        for (uint32_t first = 0; first < quadCount; first += QUADS_PER_DRAW) {
+            const uint32_t count = std::min(QUADS_PER_DRAW, quadCount - first);
+            vkCmdDrawIndexed(commandBuffer, count * 6, 1, 0, static_cast<int32_t>((range.first + first) * 4), 0);
+        }
+    } else {
+        // Vertices and indices live in arena pages, the draw offsets select the mesh's ranges
+        const BufferArena& vertexArena = currentWorld->getVertexArena();
+        const BufferArena& indexArena = currentWorld->getIndexArena();
+        const BufferArena::Range& vertexRange = vertexArena.getRange(mesh.vertices);
+        const BufferArena::Range& indexRange = indexArena.getRange(mesh.indices);
+        VkBuffer vertexBuffer = vertexArena.getBuffer(vertexRange.page);
+        VkBuffer indexBuffer = indexArena.getBuffer(indexRange.page);
+
+        if (bound.pipeline != graphicsPipeline) {
+            vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+            bound.pipeline = graphicsPipeline;
+        }
+        if (bound.vertexBuffer != vertexBuffer) {
+            VkDeviceSize offset = 0;
+            vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+            bound.vertexBuffer = vertexBuffer;
+        }
+        if (bound.indexBuffer != indexBuffer || bound.indexType != mesh.indexType) {
+            vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, mesh.indexType);
+            bound.indexBuffer = indexBuffer;
+            bound.indexType = mesh.indexType;
+        }
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
+                          0, sizeof(DrawConstants), &constants);
+
+        // The index arena counts 32-bit words, 16-bit indices start at twice the word offset
+        const uint32_t firstIndex = mesh.indexType == VK_INDEX_TYPE_UINT16 ? indexRange.first * 2 : indexRange.first;
+        vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, firstIndex, static_cast<int32_t>(vertexRange.first), 0);
+    }
+}
+
+void WorldRenderer::recordIndirectCommands(VkCommandBuffer commandBuffer, BoundState& bound) {
+    // One push for all groups, origin.w = 0 makes the shaders read the draw record's origin
+    DrawConstants constants{viewProjection, glm::vec4(0.0f)};
     vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT,
-                      0, sizeof(glm::mat4), &model);
+                       0, sizeof(DrawConstants), &constants);
+
+    const BufferArena& vertexArena = currentWorld->getVertexArena();
+    const BufferArena& indexArena = currentWorld->getIndexArena();
+    const std::vector<DrawCuller::Group>& groups = drawCuller->getGroups();
+    const VkBuffer commands = drawCuller->getCommandBuffer();
+    const VkBuffer counts = drawCuller->getCountBuffer();
+
+    for (uint32_t i = 0; i < groups.size(); ++i) {
+        const DrawCuller::Group& group = groups[i];
+        if (group.format == MeshFormat::QUADS) {
+            VkDescriptorSet quadSet = currentWorld->getQuadPageSet(group.vertexPage);
+            if (quadSet == VK_NULL_HANDLE) continue;
+
+            if (bound.pipeline != quadPipeline) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, quadPipeline);
+                bound.pipeline = quadPipeline;
+            }
+            if (bound.quadSet != quadSet) {
+                vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, quadPipelineLayout,
+                                        1, 1, &quadSet, 0, nullptr);
+                bound.quadSet = quadSet;
+            }
+            if (bound.indexBuffer != quadIndexBuffer || bound.indexType != VK_INDEX_TYPE_UINT16) {
+                vkCmdBindIndexBuffer(commandBuffer, quadIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
+                bound.indexBuffer = quadIndexBuffer;
+                bound.indexType = VK_INDEX_TYPE_UINT16;
+            }
+        } else {
+            VkBuffer vertexBuffer = vertexArena.getBuffer(group.vertexPage);
+            VkBuffer indexBuffer = indexArena.getBuffer(group.indexPage);
+            if (vertexBuffer == VK_NULL_HANDLE || indexBuffer == VK_NULL_HANDLE) continue;
+
+            if (bound.pipeline != graphicsPipeline) {
+                vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+                bound.pipeline = graphicsPipeline;
+            }
+            if (bound.vertexBuffer != vertexBuffer) {
+                VkDeviceSize offset = 0;
+                vkCmdBindVertexBuffers(commandBuffer, 0, 1, &vertexBuffer, &offset);
+                bound.vertexBuffer = vertexBuffer;
+            }
+            if (bound.indexBuffer != indexBuffer || bound.indexType != group.indexType) {
+                vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, group.indexType);
+                bound.indexBuffer = indexBuffer;
+                bound.indexType = group.indexType;
+            }
+        }
 
-    // Draw the mesh
-    vkCmdDrawIndexed(commandBuffer, mesh.indexCount, 1, 0, 0, 0);
-    
-    std::cout << "WorldRenderer: Successfully recorded draw commands for node" << std::endl;
+        // The culling pass wrote the group's surviving draws and their count
+        drawIndexedIndirectCount(commandBuffer, commands, VkDeviceSize(group.firstCommand) * sizeof(VkDrawIndexedIndirectCommand),
+                                 counts, VkDeviceSize(i) * sizeof(uint32_t), group.recordCount,
+                                 sizeof(VkDrawIndexedIndirectCommand));
+    }
 }
 
-void WorldRenderer::recordDebugCommands(VkCommandBuffer commandBuffer) {
+void WorldRenderer::recordDebugCommands(VkCommandBuffer commandBuffer, BoundState& bound) {
     if (!debugMesh.vertexBuffer || !debugMesh.indexBuffer) {
         return;
     }
 
+    // The cube is packed like indexed meshes, whatever the range drew last
+    if (bound.pipeline != graphicsPipeline) {
+        vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+        bound.pipeline = graphicsPipeline;
+    }
+
     // Bind debug mesh buffers
     VkDeviceSize offset = 0;
     vkCmdBindVertexBuffers(commandBuffer, 0, 1, &debugMesh.vertexBuffer, &offset);
-    vkCmdBindIndexBuffer(commandBuffer, debugMesh.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+    vkCmdBindIndexBuffer(commandBuffer, debugMesh.indexBuffer, 0, VK_INDEX_TYPE_UINT16);
+    bound.vertexBuffer = debugMesh.vertexBuffer;
+    bound.indexBuffer = debugMesh.indexBuffer;
+    bound.indexType = VK_INDEX_TYPE_UINT16;
 
     // Draw debug visualization for each visible node
     for (const auto& node : visibleNodes) {
-        if (node.isVisible && node.node) {
-            // Update push constants with node transform
-            glm::mat4 model = glm::translate(glm::mat4(1.0f), glm::vec3(node.node->position));
-            model = glm::scale(model, glm::vec3(node.node->size));
+        if (node.isVisible && node.node != INVALID_NODE) {
+            // Unit cube scaled to the node extent
+            DrawConstants constants{viewProjection, glm::vec4(glm::vec3(node.bounds.position), static_cast<float>(node.bounds.size))};
             vkCmdPushConstants(commandBuffer, pipelineLayout, 
-                VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(glm::mat4), &model);
+                VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(DrawConstants), &constants);
 
             // Draw debug mesh
             vkCmdDrawIndexed(commandBuffer, debugMesh.indexCount, 1, 0, 0, 0);
@@ -474,21 +891,22 @@ void WorldRenderer::recordDebugCommands(VkCommandBuffer commandBuffer) {
 }
 
 bool WorldRenderer::createDebugResources() {
-    // Create cube mesh for debug visualization
-    std::vector<float> vertices = {
+    // Create unit cube mesh for debug visualization, packed like node meshes
+    const uint32_t white = 0xFFFFFF01;
+    std::vector<MeshVertex> vertices = {
         // Front face
-        -0.5f, -0.5f,  0.5f,
-         0.5f, -0.5f,  0.5f,
-         0.5f,  0.5f,  0.5f,
-        -0.5f,  0.5f,  0.5f,
+        MeshVertex::pack(glm::uvec3(0, 0, 1), 4, VERTEX_OCCLUSION_NONE, white),
+        MeshVertex::pack(glm::uvec3(1, 0, 1), 4, VERTEX_OCCLUSION_NONE, white),
+        MeshVertex::pack(glm::uvec3(1, 1, 1), 4, VERTEX_OCCLUSION_NONE, white),
+        MeshVertex::pack(glm::uvec3(0, 1, 1), 4, VERTEX_OCCLUSION_NONE, white),
         // Back face
-        -0.5f, -0.5f, -0.5f,
-         0.5f, -0.5f, -0.5f,
-         0.5f,  0.5f, -0.5f,
-        -0.5f,  0.5f, -0.5f,
+        MeshVertex::pack(glm::uvec3(0, 0, 0), 5, VERTEX_OCCLUSION_NONE, white),
+        MeshVertex::pack(glm::uvec3(1, 0, 0), 5, VERTEX_OCCLUSION_NONE, white),
+        MeshVertex::pack(glm::uvec3(1, 1, 0), 5, VERTEX_OCCLUSION_NONE, white),
+        MeshVertex::pack(glm::uvec3(0, 1, 0), 5, VERTEX_OCCLUSION_NONE, white),
     };
 
-    std::vector<uint32_t> indices = {
+    std::vector<uint16_t> indices = {
         // Front face
         0, 1, 2, 2, 3, 0,
         // Back face
@@ -503,29 +921,18 @@ bool WorldRenderer::createDebugResources() {
         4, 5, 1, 1, 0, 4
     };
 
-    debugMesh.vertexCount = static_cast<uint32_t>(vertices.size()) / 3;
+    debugMesh.vertexCount = static_cast<uint32_t>(vertices.size());
     debugMesh.indexCount = static_cast<uint32_t>(indices.size());
 
-    // Create vertex buffer
-    VkBufferCreateInfo vertexBufferInfo{};
-    vertexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    vertexBufferInfo.size = vertices.size() * sizeof(float);
-    vertexBufferInfo.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT;
-    vertexBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    if (vkCreateBuffer(device, &vertexBufferInfo, nullptr, &debugMesh.vertexBuffer) != VK_SUCCESS) {
+    // Small and static, written straight into host-visible memory
+    if (!createHostBuffer(vertices.data(), vertices.size() * sizeof(MeshVertex), VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+                          debugMesh.vertexBuffer, debugMesh.vertexAllocation)) {
         std::cerr << "Failed to create debug mesh vertex buffer" << std::endl;
         return false;
     }
 
-    // Create index buffer
-    VkBufferCreateInfo indexBufferInfo{};
-    indexBufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-    indexBufferInfo.size = indices.size() * sizeof(uint32_t);
-    indexBufferInfo.usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT;
-    indexBufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-    if (vkCreateBuffer(device, &indexBufferInfo, nullptr, &debugMesh.indexBuffer) != VK_SUCCESS) {
+    if (!createHostBuffer(indices.data(), indices.size() * sizeof(uint16_t), VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
+                          debugMesh.indexBuffer, debugMesh.indexAllocation)) {
         std::cerr << "Failed to create debug mesh index buffer" << std::endl;
         return false;
     }
@@ -533,26 +940,53 @@ bool WorldRenderer::createDebugResources() {
     return true;
 }
 
-void WorldRenderer::cleanupDebugResources() {
-    if (debugMesh.vertexBuffer != VK_NULL_HANDLE) {
-        vkDestroyBuffer(device, debugMesh.vertexBuffer, nullptr);
-        debugMesh.vertexBuffer = VK_NULL_HANDLE;
-    }
-
-    if (debugMesh.vertexMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(device, debugMesh.vertexMemory, nullptr);
-        debugMesh.vertexMemory = VK_NULL_HANDLE;
+bool WorldRenderer::createRecorders(uint32_t graphicsQueueFamily) {
+    // One recorder per worker plus the calling thread
+    const uint32_t recorderCount = recordPool.getThreadCount() + 1;
+
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;  // Reset as a whole every frame
+    poolInfo.queueFamilyIndex = graphicsQueueFamily;
+
+    VkCommandBufferAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+    allocInfo.commandBufferCount = 1;
+
+    for (uint32_t frame = 0; frame < FRAMES_IN_FLIGHT; ++frame) {
+        recordPools[frame].assign(recorderCount, VK_NULL_HANDLE);
+        recordBuffers[frame].assign(recorderCount, VK_NULL_HANDLE);
+        for (uint32_t i = 0; i < recorderCount; ++i) {
+            if (vkCreateCommandPool(device, &poolInfo, nullptr, &recordPools[frame][i]) != VK_SUCCESS) {
+                return false;
+            }
+            allocInfo.commandPool = recordPools[frame][i];
+            if (vkAllocateCommandBuffers(device, &allocInfo, &recordBuffers[frame][i]) != VK_SUCCESS) {
+                return false;
+            }
+        }
     }
+    return true;
+}
 
-    if (debugMesh.indexBuffer != VK_NULL_HANDLE) {
-        vkDestroyBuffer(device, debugMesh.indexBuffer, nullptr);
-        debugMesh.indexBuffer = VK_NULL_HANDLE;
+void WorldRenderer::destroyRecorders() {
+    recordPool.waitIdle();
+    for (uint32_t frame = 0; frame < FRAMES_IN_FLIGHT; ++frame) {
+        // Destroying a pool frees its command buffers
+        for (VkCommandPool pool : recordPools[frame]) {
+            if (pool != VK_NULL_HANDLE) {
+                vkDestroyCommandPool(device, pool, nullptr);
+            }
+        }
+        recordPools[frame].clear();
+        recordBuffers[frame].clear();
     }
+}
 
-    if (debugMesh.indexMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(device, debugMesh.indexMemory, nullptr);
-        debugMesh.indexMemory = VK_NULL_HANDLE;
-    }
+void WorldRenderer::cleanupDebugResources() {
+    destroyBuffer(debugMesh.vertexBuffer, debugMesh.vertexAllocation);
+    destroyBuffer(debugMesh.indexBuffer, debugMesh.indexAllocation);
 }
 
 } // namespace voxceleron 
\ No newline at end of file
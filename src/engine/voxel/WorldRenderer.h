@@ -2,14 +2,30 @@
 
 #include <vulkan/vulkan.h>
 #include <glm/glm.hpp>
+#include <array>
 #include <vector>
 #include <memory>
 #include "../core/Camera.h"
+#include "../core/ThreadPool.h"
+#include "FlatOctree.h"
+#include "MeshTypes.h"
+#include "DrawCuller.h"
+#include "OcclusionBuffer.h"
+#include "FrustumCulling.h"
+#include "RenderQueue.h"
 
 namespace voxceleron {
 
 class World;
-class OctreeNode;
+
+// Where a frame's draws go. Secondary command buffers continue this render pass and
+// framebuffer, and are reused once the frame in flight they were recorded for finishes.
+struct RenderTarget {
+    VkRenderPass renderPass;
+    VkFramebuffer framebuffer;
+    VkExtent2D extent;
+    uint32_t frameIndex;  // Frame in flight, its previous submission must have finished
+};
 
 class WorldRenderer {
 public:
@@ -21,13 +37,17 @@ public:
         bool enableFrustumCulling = true;   // Enable/disable frustum culling
         bool enableLOD = true;              // Enable/disable LOD system
         bool enableOcclusion = true;        // Enable/disable occlusion culling
+        bool enableGpuCulling = true;       // Cull on the GPU and draw indirectly where supported
+        bool enableParallelRecording = true;  // Record draws into secondary command buffers on worker threads
+        uint32_t minDrawsPerRecorder = 256;   // Smaller ranges are not worth another thread
     };
 
     WorldRenderer();
     ~WorldRenderer();
 
     // Initialization
-    bool initialize(VkDevice device, VkPhysicalDevice physicalDevice);
+    bool initialize(VkDevice device, VkPhysicalDevice physicalDevice, MemoryAllocator* allocator,
+                    uint32_t graphicsQueueFamily);
     void cleanup();
 
     // Settings
@@ -36,7 +56,14 @@ public:
 
     // Rendering
     void prepareFrame(const Camera& camera, World& world);
-    void recordCommands(VkCommandBuffer commandBuffer);
+    // Records the frame's GPU culling pass, once per frame and outside the render pass
+    void recordCulling(VkCommandBuffer commandBuffer);
+    // Records the frame's draws inside the render pass. With parallel recording they go to
+    // secondary command buffers executed from commandBuffer, so the render pass must have
+    // begun with VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS when this returns true.
+    bool usesSecondaryCommandBuffers() const;
+    void recordCommands(VkCommandBuffer commandBuffer, const RenderTarget& target);
+    bool isGpuCullingActive() const;
 
     // Debug visualization
     void setDebugVisualization(bool enabled) { debugVisualization = enabled; }
@@ -45,56 +72,121 @@ public:
     // Camera access
     const Camera* getCamera() const { return currentCamera; }
 
+    // Layout of the descriptor set every QUADS mesh binds its records with
+    VkDescriptorSetLayout getQuadSetLayout() const { return quadSetLayout; }
+
 private:
     // Core components
     VkDevice device;
     VkPhysicalDevice physicalDevice;
+    MemoryAllocator* allocator;
     VkPipelineLayout pipelineLayout;
     VkPipeline graphicsPipeline;  // Graphics pipeline for mesh rendering
+    VkPipelineLayout quadPipelineLayout;
+    VkPipeline quadPipeline;            // quad.vert, pulls MeshQuad records of QUADS meshes
+    VkDescriptorSetLayout quadSetLayout;
+    std::unique_ptr<DrawCuller> drawCuller;
+    PFN_vkCmdDrawIndexedIndirectCountKHR drawIndexedIndirectCount;  // Null without VK_KHR_draw_indirect_count
+    bool gpuDrawsRecorded;  // This frame's draws come from drawCuller
+    OcclusionBuffer occlusionBuffer;  // Rebuilt every frame while occlusion culling is enabled
     Settings settings;
     bool debugVisualization;
     const Camera* currentCamera;  // Current camera being used for rendering
+    const World* currentWorld;    // Owns the mesh arenas draws resolve their ranges in
 
     // Rendering data
     struct RenderNode {
-        const OctreeNode* node;
+        NodeIndex node;
+        NodeBounds bounds;        // Node extent, derived during the octree walk
+        const MeshData* mesh;     // Mesh generated for the node, if any
         float distance;    // Distance to camera
         uint32_t lodLevel; // Actual LOD level to use
         bool isVisible;    // Whether node is visible
+        float priority;    // calculateNodePriority, computed once during the walk
     };
     std::vector<RenderNode> visibleNodes;
 
+    // Pipeline bits of the render queue's keys, in the order their draws are recorded
+    enum QueuePipeline : uint32_t {
+        QUEUE_PIPELINE_INDEXED = 0,  // graphicsPipeline
+        QUEUE_PIPELINE_QUADS = 1,    // quadPipeline
+    };
+    RenderQueue renderQueue;  // Visible nodes with meshes in draw order, indices into visibleNodes
+
+    // Per-draw push constants, matches basic.vert and quad.vert
+    struct DrawConstants {
+        glm::mat4 viewProjection;
+        glm::vec4 origin;  // xyz node origin, w world units per mesh unit, 0 for the draw record's origin
+    };
+
     // Transformation matrices
     glm::mat4 viewProjection;
     glm::vec3 cameraPosition;
 
     // Culling and LOD
     void updateVisibleNodes(const Camera& camera, World& world);
-    void frustumCullNode(const OctreeNode* node, const Camera::Frustum& frustum);
-    bool isNodeVisible(const OctreeNode* node, const Camera::Frustum& frustum) const;
-    uint32_t calculateLODLevel(const OctreeNode* node, float distance) const;
-    float calculateNodePriority(const RenderNode& node) const;
-
-    // Command recording
-    void recordNodeCommands(VkCommandBuffer commandBuffer, const RenderNode& node);
-    void recordDebugCommands(VkCommandBuffer commandBuffer);
+    void buildRenderQueue(const World& world);
+    void frustumCullNode(const World& world, NodeIndex node, const NodeBounds& bounds, const Camera::Frustum& frustum,
+                         FrustumTest test);
+    uint32_t calculateLODLevel(const NodeBounds& bounds, float distance) const;
+    float calculateNodePriority(const NodeBounds& bounds, float distance) const;
+
+    // Command recording. Meshes share arena pages, so state is only rebound when it changes.
+    // Every command buffer being recorded tracks its own.
+    struct BoundState {
+        VkPipeline pipeline = VK_NULL_HANDLE;
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        VkIndexType indexType = VK_INDEX_TYPE_UINT32;
+        VkDescriptorSet quadSet = VK_NULL_HANDLE;
+    };
+    void recordDraws(VkCommandBuffer commandBuffer, const RenderTarget& target, size_t first, size_t last,
+                     bool lastRange);
+    bool recordSecondary(VkCommandBuffer commandBuffer, const RenderTarget& target, size_t first, size_t last,
+                         bool lastRange);
+    void recordNodeCommands(VkCommandBuffer commandBuffer, const RenderNode& node, BoundState& bound);
+    void recordIndirectCommands(VkCommandBuffer commandBuffer, BoundState& bound);
+    void recordDebugCommands(VkCommandBuffer commandBuffer, BoundState& bound);
+
+    // Parallel recording: a command pool and secondary command buffer per recorder and frame
+    // in flight. Each recorder is used by one job at a time, so its pool needs no lock.
+    // Workers record all ranges of the render queue but the last, the calling thread that one.
+    static constexpr uint32_t FRAMES_IN_FLIGHT = DrawCuller::FRAMES_IN_FLIGHT;
+    std::array<std::vector<VkCommandPool>, FRAMES_IN_FLIGHT> recordPools;
+    std::array<std::vector<VkCommandBuffer>, FRAMES_IN_FLIGHT> recordBuffers;
+    std::vector<uint8_t> recordResults;  // Per range, whether its secondary recorded
+    bool createRecorders(uint32_t graphicsQueueFamily);
+    void destroyRecorders();
 
     // Vulkan resources
     struct {
         VkBuffer vertexBuffer;
-        VkDeviceMemory vertexMemory;
+        MemoryAllocation vertexAllocation;
         VkBuffer indexBuffer;
-        VkDeviceMemory indexMemory;
+        MemoryAllocation indexAllocation;
         VkDescriptorSet descriptorSet;
         uint32_t vertexCount;
         uint32_t indexCount;
     } debugMesh;
 
+    // Shared index buffer of QUADS meshes, one draw covers up to 65536 vertices
+    static constexpr uint32_t QUADS_PER_DRAW = DrawCuller::QUADS_PER_DRAW;
+    VkBuffer quadIndexBuffer;
+    MemoryAllocation quadIndexAllocation;
+
     // Vulkan helpers
+    bool createGraphicsPipeline(const std::string& vertexShader, const VkPipelineVertexInputStateCreateInfo& vertexInput,
+                                VkPipelineLayout layout, VkPipeline& pipeline);
+    bool createQuadIndexBuffer();
+    bool createHostBuffer(const void* data, VkDeviceSize size, VkBufferUsageFlags usage,
+                          VkBuffer& buffer, MemoryAllocation& allocation);
+    void destroyBuffer(VkBuffer& buffer, MemoryAllocation& allocation);
     bool createDebugResources();
     void cleanupDebugResources();
     VkShaderModule createShaderModule(const std::string& filename);
 
+    ThreadPool recordPool;  // Declared last so workers stop before the members they read go away
+
     // Prevent copying
     WorldRenderer(const WorldRenderer&) = delete;
     WorldRenderer& operator=(const WorldRenderer&) = delete;
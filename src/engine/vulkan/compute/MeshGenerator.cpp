@@ -1,26 +1,23 @@
 #include "MeshGenerator.h"
-#include "../core/VulkanDevice.h"
-#include "../core/VulkanBuffer.h"
-#include "../core/VulkanDescriptorSet.h"
-#include "../core/VulkanPipeline.h"
+#include "../core/VulkanContext.h"
+#include "../../voxel/MeshTypes.h"
+#include <algorithm>
 #include <iostream>
 #include <fstream>
-#include <stdexcept>
-#include <array>
 
 namespace voxceleron {
 
-MeshGenerator::MeshGenerator(VulkanDevice* device)
-    : device(device)
-    , computePipeline(VK_NULL_HANDLE)
-    , pipelineLayout(VK_NULL_HANDLE)
+MeshGenerator::MeshGenerator(VulkanContext* context)
+    : context(context)
+    , device(context->getDevice())
+    , maxNodeSize(0)
+    , maxNodesPerBatch(0)
+    , quadCapacity(0)
     , descriptorSetLayout(VK_NULL_HANDLE)
     , descriptorPool(VK_NULL_HANDLE)
-    , descriptorSets()
-    , currentBufferSet(0)
-    , workgroupSizeX(8)
-    , workgroupSizeY(8)
-    , workgroupSizeZ(8) {
+    , pipelineLayout(VK_NULL_HANDLE)
+    , meshPipelines{}
+    , scanPipeline(VK_NULL_HANDLE) {
 }
 
 MeshGenerator::~MeshGenerator() {
@@ -28,49 +25,20 @@ MeshGenerator::~MeshGenerator() {
 }
 
 bool MeshGenerator::initialize(const MeshGeneratorCreateInfo& createInfo) {
-    std::cout << "MeshGenerator: Starting initialization..." << std::endl;
-    
-    workgroupSizeX = createInfo.workgroupSizeX;
-    workgroupSizeY = createInfo.workgroupSizeY;
-    workgroupSizeZ = createInfo.workgroupSizeZ;
-
-    std::cout << "MeshGenerator: Using workgroup sizes: " << workgroupSizeX << "x" << workgroupSizeY << "x" << workgroupSizeZ << std::endl;
-
-    // 1. Create descriptor set layout first
-    std::cout << "MeshGenerator: Creating descriptor set layout..." << std::endl;
-    if (!createDescriptorSetLayout()) {
-        std::cerr << "Failed to create descriptor set layout" << std::endl;
-        return false;
-    }
+    maxNodeSize = createInfo.maxNodeSize;
+    maxNodesPerBatch = createInfo.maxNodesPerBatch;
+    quadCapacity = std::max(createInfo.quadCapacity, getMaxQuadCount(maxNodeSize));
 
-    // 2. Create descriptor pool
-    std::cout << "MeshGenerator: Creating descriptor pool for " << createInfo.maxNodesInFlight << " nodes..." << std::endl;
-    if (!createDescriptorPool(createInfo.maxNodesInFlight)) {
-        std::cerr << "Failed to create descriptor pool" << std::endl;
+    if (!createDescriptorSetLayout() || !createDescriptorPool(createInfo.batchCount)) {
+        std::cerr << "MeshGenerator: Failed to create descriptors" << std::endl;
+        cleanup();
         return false;
     }
 
-    // 3. Create buffers
-    std::cout << "MeshGenerator: Creating buffers..." << std::endl;
-    if (!createBuffers(createInfo)) {
-        std::cerr << "Failed to create buffers" << std::endl;
-        return false;
-    }
-
-    // 4. Allocate and update descriptor sets
-    std::cout << "MeshGenerator: Allocating and updating descriptor sets..." << std::endl;
-    if (!allocateDescriptorSets()) {
-        std::cerr << "Failed to allocate descriptor sets" << std::endl;
-        return false;
-    }
-
-    // 5. Create pipeline layout
-    std::cout << "MeshGenerator: Creating pipeline layout..." << std::endl;
     VkPushConstantRange pushConstantRange{};
     pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
     pushConstantRange.offset = 0;
-    pushConstantRange.size = sizeof(glm::ivec3) + 3 * sizeof(uint32_t);
-    std::cout << "MeshGenerator: Push constant size: " << pushConstantRange.size << " bytes" << std::endl;
+    pushConstantRange.size = sizeof(PushConstants);
 
     VkPipelineLayoutCreateInfo pipelineLayoutInfo{};
     pipelineLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -79,323 +47,327 @@ bool MeshGenerator::initialize(const MeshGeneratorCreateInfo& createInfo) {
     pipelineLayoutInfo.pushConstantRangeCount = 1;
     pipelineLayoutInfo.pPushConstantRanges = &pushConstantRange;
 
-    if (descriptorSetLayout == VK_NULL_HANDLE) {
-        std::cerr << "ERROR: Descriptor set layout is null before pipeline layout creation!" << std::endl;
+    if (vkCreatePipelineLayout(device, &pipelineLayoutInfo, nullptr, &pipelineLayout) != VK_SUCCESS) {
+        std::cerr << "MeshGenerator: Failed to create pipeline layout" << std::endl;
+        cleanup();
         return false;
     }
-    std::cout << "MeshGenerator: Using descriptor set layout: " << descriptorSetLayout << std::endl;
 
-    VkResult result = vkCreatePipelineLayout(device->getDevice(), &pipelineLayoutInfo, nullptr, &pipelineLayout);
-    if (result != VK_SUCCESS) {
-        std::cerr << "Failed to create pipeline layout: " << result << std::endl;
+    // The output format is a specialization, the meshing mode a separate shader
+    if (!createPipeline("shaders/mesh_generator.comp.spv", false, meshPipelines[0]) ||
+        !createPipeline("shaders/mesh_generator.comp.spv", true, meshPipelines[1]) ||
+        !createPipeline("shaders/mesh_generator_optimized.comp.spv", false, meshPipelines[2]) ||
+        !createPipeline("shaders/mesh_generator_optimized.comp.spv", true, meshPipelines[3]) ||
+        !createPipeline("shaders/mesh_generator_scan.comp.spv", false, scanPipeline)) {
+        cleanup();
         return false;
     }
-    std::cout << "MeshGenerator: Created pipeline layout: " << pipelineLayout << std::endl;
 
-    // 6. Create compute pipeline last
-    std::cout << "MeshGenerator: Creating compute pipeline..." << std::endl;
-    if (!createComputePipeline()) {
-        std::cerr << "Failed to create compute pipeline" << std::endl;
-        return false;
+    batches.resize(createInfo.batchCount);
+    for (Batch& batch : batches) {
+        if (!createBatch(batch)) {
+            std::cerr << "MeshGenerator: Failed to create batch buffers" << std::endl;
+            cleanup();
+            return false;
+        }
     }
 
-    std::cout << "MeshGenerator: Initialization complete" << std::endl;
+    std::cout << "MeshGenerator: " << batches.size() << " batches of " << maxNodesPerBatch
+              << " nodes sharing " << quadCapacity << " quads" << std::endl;
     return true;
 }
 
 void MeshGenerator::cleanup() {
-    if (device) {
-        device->waitIdle();
-
-        // Clear buffer sets first
-        bufferSets.clear();
-
-        // Free descriptor sets before destroying the pool
-        if (descriptorPool != VK_NULL_HANDLE && !descriptorSets.empty()) {
-            vkFreeDescriptorSets(
-                device->getDevice(),
-                descriptorPool,
-                static_cast<uint32_t>(descriptorSets.size()),
-                descriptorSets.data()
-            );
-            descriptorSets.clear();
-        }
+    if (device == VK_NULL_HANDLE) return;
+
+    // Descriptor sets go away with their pool
+    for (Batch& batch : batches) {
+        context->destroyBuffer(batch.voxelBuffer, batch.voxelAllocation);
+        context->destroyBuffer(batch.vertexBuffer, batch.vertexAllocation);
+        context->destroyBuffer(batch.indexBuffer, batch.indexAllocation);
+        context->destroyBuffer(batch.counterBuffer, batch.counterAllocation);
+        context->destroyBuffer(batch.nodeBuffer, batch.nodeAllocation);
+    }
+    batches.clear();
 
-        // Destroy descriptor pool
-        if (descriptorPool != VK_NULL_HANDLE) {
-            vkDestroyDescriptorPool(device->getDevice(), descriptorPool, nullptr);
-            descriptorPool = VK_NULL_HANDLE;
+    for (VkPipeline& pipeline : meshPipelines) {
+        if (pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, pipeline, nullptr);
+            pipeline = VK_NULL_HANDLE;
         }
+    }
 
-        // Destroy pipeline layout
-        if (pipelineLayout != VK_NULL_HANDLE) {
-            vkDestroyPipelineLayout(device->getDevice(), pipelineLayout, nullptr);
-            pipelineLayout = VK_NULL_HANDLE;
-        }
+    if (scanPipeline != VK_NULL_HANDLE) {
+        vkDestroyPipeline(device, scanPipeline, nullptr);
+        scanPipeline = VK_NULL_HANDLE;
+    }
 
-        // Destroy compute pipeline
-        if (computePipeline != VK_NULL_HANDLE) {
-            vkDestroyPipeline(device->getDevice(), computePipeline, nullptr);
-            computePipeline = VK_NULL_HANDLE;
-        }
+    if (pipelineLayout != VK_NULL_HANDLE) {
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        pipelineLayout = VK_NULL_HANDLE;
+    }
 
-        // Destroy descriptor set layout
-        if (descriptorSetLayout != VK_NULL_HANDLE) {
-            vkDestroyDescriptorSetLayout(device->getDevice(), descriptorSetLayout, nullptr);
-            descriptorSetLayout = VK_NULL_HANDLE;
-        }
+    if (descriptorPool != VK_NULL_HANDLE) {
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        descriptorPool = VK_NULL_HANDLE;
+    }
+
+    if (descriptorSetLayout != VK_NULL_HANDLE) {
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        descriptorSetLayout = VK_NULL_HANDLE;
     }
 }
 
-bool MeshGenerator::createDescriptorPool(uint32_t maxSets) {
-    std::array<VkDescriptorPoolSize, 4> poolSizes{};
-    poolSizes[0].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    poolSizes[0].descriptorCount = maxSets; // Voxel buffer
-    poolSizes[1].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    poolSizes[1].descriptorCount = maxSets; // Vertex buffer
-    poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    poolSizes[2].descriptorCount = maxSets; // Index buffer
-    poolSizes[3].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-    poolSizes[3].descriptorCount = maxSets; // Counter buffer
+void MeshGenerator::beginBatch(uint32_t batch, bool writeQuads, bool greedy) {
+    Batch& state = batches[batch];
+    state.nodeCount = 0;
+    state.largestNode = 0;
+    state.writeQuads = writeQuads;
+    state.greedy = greedy;
+}
 
-    VkDescriptorPoolCreateInfo poolInfo{};
-    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
-    poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
-    poolInfo.pPoolSizes = poolSizes.data();
-    poolInfo.maxSets = maxSets;
-    poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_FREE_DESCRIPTOR_SET_BIT;
+VkDeviceSize MeshGenerator::getNextVoxelOffset(uint32_t batch) const {
+    // Fixed slots for the largest node, nodes never share voxel words
+    const VkDeviceSize slotWords = VkDeviceSize(maxNodeSize) * maxNodeSize * maxNodeSize;
+    return batches[batch].nodeCount * slotWords * sizeof(uint32_t);
+}
 
-    if (vkCreateDescriptorPool(device->getDevice(), &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS) {
-        return false;
-    }
+uint32_t MeshGenerator::addNode(uint32_t batch, uint32_t nodeSize) {
+    Batch& state = batches[batch];
+    const uint32_t voxelOffset = static_cast<uint32_t>(getNextVoxelOffset(batch) / sizeof(uint32_t));
+    const uint32_t slot = state.nodeCount++;
+    state.largestNode = std::max(state.largestNode, nodeSize);
 
-    return true;
-}
+    // Both buffers are host-coherent and only read by the batch's next submission
+    NodeInfo* nodes = static_cast<NodeInfo*>(state.nodeAllocation.mapped);
+    nodes[slot].voxelOffset = voxelOffset;
+    nodes[slot].nodeSize = nodeSize;
 
-bool MeshGenerator::createDescriptorSetLayout() {
-    std::array<VkDescriptorSetLayoutBinding, 4> bindings{};
+    NodeCounters* counters = static_cast<NodeCounters*>(state.counterAllocation.mapped);
+    counters[slot] = NodeCounters{};
+    return slot;
+}
 
-    // Ensure all pImmutableSamplers are nullptr first
-    for (auto& binding : bindings) {
-        binding.pImmutableSamplers = nullptr;
-        binding.descriptorCount = 1;
-        binding.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
-    }
+void MeshGenerator::recordBatch(uint32_t batch, VkCommandBuffer commandBuffer) const {
+    const Batch& state = batches[batch];
+    if (state.nodeCount == 0) return;
+
+    PushConstants pushConstants{};
+    pushConstants.nodeCount = state.nodeCount;
+    pushConstants.groupsPerAxis = (state.largestNode + CULLED_GROUP_SIZE - 1) / CULLED_GROUP_SIZE;
+    pushConstants.quadCapacity = quadCapacity;
+    pushConstants.countOnly = 1;
+
+    // The greedy mesher runs a workgroup per slice and face direction of every node, the
+    // culled mesher a slab of 8^3 workgroups per node along z
+    auto dispatchMesher = [&]() {
+        vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                           sizeof(PushConstants), &pushConstants);
+        if (state.greedy) {
+            vkCmdDispatch(commandBuffer, state.largestNode, 6, state.nodeCount);
+        } else {
+            vkCmdDispatch(commandBuffer, pushConstants.groupsPerAxis, pushConstants.groupsPerAxis,
+                          pushConstants.groupsPerAxis * state.nodeCount);
+        }
+    };
+
+    VkMemoryBarrier computeBarrier{};
+    computeBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    computeBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    computeBarrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+
+    VkPipeline meshPipeline = getMeshPipeline(state.greedy, state.writeQuads);
+    vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1,
+                            &state.descriptorSet, 0, nullptr);
+
+    // Count every node's quads
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshPipeline);
+    dispatchMesher();
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &computeBarrier, 0, nullptr, 0, nullptr);
+
+    // Give every node its output range
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, scanPipeline);
+    vkCmdPushConstants(commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0,
+                       sizeof(PushConstants), &pushConstants);
+    vkCmdDispatch(commandBuffer, 1, 1, 1);
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         0, 1, &computeBarrier, 0, nullptr, 0, nullptr);
+
+    // Write the quads into the ranges
+    pushConstants.countOnly = 0;
+    vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, meshPipeline);
+    dispatchMesher();
+
+    // Counters are read on the host, the meshes are copied out of the output afterwards
+    VkMemoryBarrier outputBarrier{};
+    outputBarrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    outputBarrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    outputBarrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_HOST_BIT,
+                         0, 1, &outputBarrier, 0, nullptr, 0, nullptr);
+}
 
-    // Binding 0: Voxel buffer (read-only)
-    bindings[0].binding = 0;
-    bindings[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+MeshGenerator::NodeResult MeshGenerator::getResult(uint32_t batch, uint32_t slot) const {
+    const Batch& state = batches[batch];
+    const NodeCounters& counters = static_cast<const NodeCounters*>(state.counterAllocation.mapped)[slot];
 
-    // Binding 1: Vertex buffer (read/write)
-    bindings[1].binding = 1;
-    bindings[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    NodeResult result{};
+    result.overflow = counters.quadBase == QUAD_BASE_OVERFLOW;
+    if (result.overflow) return result;
 
-    // Binding 2: Index buffer (read/write)
-    bindings[2].binding = 2;
-    bindings[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    const VkDeviceSize recordSize = state.writeQuads ? sizeof(MeshQuad) : 4 * sizeof(MeshVertex);
+    result.quadCount = counters.quadCount;
+    result.faceCount = state.greedy ? counters.faceCount : counters.quadCount;
+    result.vertexOffset = VkDeviceSize(counters.quadBase) * recordSize;
+    result.indexOffset = VkDeviceSize(counters.quadBase) * 6 * sizeof(uint32_t);
+    return result;
+}
 
-    // Binding 3: Counter buffer (read/write)
-    // This must match the shader's declaration: layout(std430, binding = 3) buffer CounterBuffer
-    bindings[3].binding = 3;
-    bindings[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+bool MeshGenerator::createDescriptorSetLayout() {
+    // Voxels, vertices, indices, counters and the node table
+    std::array<VkDescriptorSetLayoutBinding, 5> bindings{};
+    for (uint32_t i = 0; i < bindings.size(); ++i) {
+        bindings[i].binding = i;
+        bindings[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        bindings[i].descriptorCount = 1;
+        bindings[i].stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+    }
 
     VkDescriptorSetLayoutCreateInfo layoutInfo{};
     layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
     layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
     layoutInfo.pBindings = bindings.data();
-    layoutInfo.flags = 0; // No special flags needed
 
-    VkResult result = vkCreateDescriptorSetLayout(device->getDevice(), &layoutInfo, nullptr, &descriptorSetLayout);
-    if (result != VK_SUCCESS) {
-        std::cerr << "Failed to create descriptor set layout: " << result << std::endl;
-        return false;
-    }
+    return vkCreateDescriptorSetLayout(device, &layoutInfo, nullptr, &descriptorSetLayout) == VK_SUCCESS;
+}
 
-    std::cout << "Successfully created descriptor set layout with 4 bindings" << std::endl;
-    return true;
+bool MeshGenerator::createDescriptorPool(uint32_t maxSets) {
+    VkDescriptorPoolSize poolSize{};
+    poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+    poolSize.descriptorCount = maxSets * 5;
+
+    VkDescriptorPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+    poolInfo.maxSets = maxSets;
+    poolInfo.poolSizeCount = 1;
+    poolInfo.pPoolSizes = &poolSize;
+
+    return vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) == VK_SUCCESS;
 }
 
-bool MeshGenerator::createComputePipeline() {
-    std::cout << "Creating compute pipeline..." << std::endl;
-    
-    // Load and validate shader
+bool MeshGenerator::createPipeline(const std::string& shaderPath, bool writeQuads, VkPipeline& pipeline) {
     std::vector<char> shaderCode;
-    if (!loadShaderFile("shaders/mesh_generator.comp.spv", shaderCode)) {
-        std::cerr << "Failed to load compute shader" << std::endl;
+    if (!loadShaderFile(shaderPath, shaderCode)) {
         return false;
     }
-    std::cout << "Loaded compute shader successfully" << std::endl;
 
-    // Create shader module
     VkShaderModuleCreateInfo createInfo{};
     createInfo.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
     createInfo.codeSize = shaderCode.size();
     createInfo.pCode = reinterpret_cast<const uint32_t*>(shaderCode.data());
 
     VkShaderModule shaderModule;
-    VkResult moduleResult = vkCreateShaderModule(device->getDevice(), &createInfo, nullptr, &shaderModule);
-    if (moduleResult != VK_SUCCESS) {
-        std::cerr << "Failed to create shader module: " << moduleResult << std::endl;
+    if (vkCreateShaderModule(device, &createInfo, nullptr, &shaderModule) != VK_SUCCESS) {
+        std::cerr << "MeshGenerator: Failed to create shader module for " << shaderPath << std::endl;
         return false;
     }
-    std::cout << "Created shader module successfully" << std::endl;
 
-    // Configure shader stage
-    VkPipelineShaderStageCreateInfo shaderStageInfo{};
-    shaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-    shaderStageInfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-    shaderStageInfo.module = shaderModule;
-    shaderStageInfo.pName = "main";
+    // WRITE_QUADS (constant_id 0) selects the output format, the scan has no such constant
+    const VkBool32 writeQuadsValue = writeQuads ? VK_TRUE : VK_FALSE;
+    VkSpecializationMapEntry specializationEntry{0, 0, sizeof(VkBool32)};
+    VkSpecializationInfo specializationInfo{};
+    specializationInfo.mapEntryCount = 1;
+    specializationInfo.pMapEntries = &specializationEntry;
+    specializationInfo.dataSize = sizeof(VkBool32);
+    specializationInfo.pData = &writeQuadsValue;
 
-    // Create compute pipeline
     VkComputePipelineCreateInfo pipelineInfo{};
     pipelineInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-    pipelineInfo.stage = shaderStageInfo;
+    pipelineInfo.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+    pipelineInfo.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+    pipelineInfo.stage.module = shaderModule;
+    pipelineInfo.stage.pName = "main";
+    pipelineInfo.stage.pSpecializationInfo = &specializationInfo;
     pipelineInfo.layout = pipelineLayout;
-    pipelineInfo.flags = VK_PIPELINE_CREATE_DISABLE_OPTIMIZATION_BIT; // Add for debugging
-    
-    // Validate pipeline layout
-    if (pipelineLayout == VK_NULL_HANDLE) {
-        std::cerr << "Pipeline layout is null!" << std::endl;
-        vkDestroyShaderModule(device->getDevice(), shaderModule, nullptr);
-        return false;
-    }
-    
-    std::cout << "Creating compute pipeline with layout: " << pipelineLayout << std::endl;
-    VkResult result = vkCreateComputePipelines(device->getDevice(), VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &computePipeline);
-    
-    // Cleanup shader module
-    vkDestroyShaderModule(device->getDevice(), shaderModule, nullptr);
-
-    if (result != VK_SUCCESS) {
-        std::cerr << "Failed to create compute pipeline: " << result << std::endl;
-        return false;
+
+    const bool created = vkCreateComputePipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &pipeline) == VK_SUCCESS;
+    if (!created) {
+        std::cerr << "MeshGenerator: Failed to create compute pipeline from " << shaderPath << std::endl;
     }
 
-    std::cout << "Created compute pipeline successfully" << std::endl;
-    return true;
+    vkDestroyShaderModule(device, shaderModule, nullptr);
+    return created;
 }
 
-bool MeshGenerator::createBuffers(const MeshGeneratorCreateInfo& createInfo) {
-    for (uint32_t i = 0; i < createInfo.maxNodesInFlight; ++i) {
-        auto bufferSet = std::make_unique<BufferSet>();
+bool MeshGenerator::createBatch(Batch& batch) {
+    // Voxel slots hold the largest node, the output holds quadCapacity quads of either format
+    const VkDeviceSize voxelBytes = VkDeviceSize(maxNodesPerBatch) * maxNodeSize * maxNodeSize * maxNodeSize * sizeof(uint32_t);
+    const VkDeviceSize vertexBytes = VkDeviceSize(quadCapacity) * std::max(4 * sizeof(MeshVertex), sizeof(MeshQuad));
+    const VkDeviceSize indexBytes = VkDeviceSize(quadCapacity) * 6 * sizeof(uint32_t);
+    const VkDeviceSize counterBytes = VkDeviceSize(maxNodesPerBatch) * sizeof(NodeCounters);
+    const VkDeviceSize nodeBytes = VkDeviceSize(maxNodesPerBatch) * sizeof(NodeInfo);
 
-        // Create voxel buffer
-        bufferSet->voxelBuffer = std::make_unique<VulkanBuffer>(
-            device,
-            MAX_VOXELS * sizeof(uint32_t),
+    if (!context->createBuffer(voxelBytes,
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-
-        // Create vertex buffer
-        bufferSet->vertexBuffer = std::make_unique<VulkanBuffer>(
-            device,
-            MAX_VERTICES * sizeof(float) * 3,
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            batch.voxelBuffer, batch.voxelAllocation) ||
+        !context->createBuffer(vertexBytes,
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-
-        // Create index buffer
-        bufferSet->indexBuffer = std::make_unique<VulkanBuffer>(
-            device,
-            MAX_INDICES * sizeof(uint32_t),
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            batch.vertexBuffer, batch.vertexAllocation) ||
+        !context->createBuffer(indexBytes,
             VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-
-        // Create counter buffer
-        bufferSet->counterBuffer = std::make_unique<VulkanBuffer>(
-            device,
-            sizeof(uint32_t) * 2,  // One for vertex count, one for index count
-            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
-        );
-
-        bufferSets.push_back(std::move(bufferSet));
+            VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+            batch.indexBuffer, batch.indexAllocation) ||
+        !context->createBuffer(counterBytes,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            batch.counterBuffer, batch.counterAllocation) ||
+        !context->createBuffer(nodeBytes,
+            VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            batch.nodeBuffer, batch.nodeAllocation)) {
+        return false;
     }
 
-    return true;
-}
-
-bool MeshGenerator::allocateDescriptorSets() {
-    std::vector<VkDescriptorSetLayout> layouts(bufferSets.size(), descriptorSetLayout);
-
     VkDescriptorSetAllocateInfo allocInfo{};
     allocInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
     allocInfo.descriptorPool = descriptorPool;
-    allocInfo.descriptorSetCount = static_cast<uint32_t>(layouts.size());
-    allocInfo.pSetLayouts = layouts.data();
+    allocInfo.descriptorSetCount = 1;
+    allocInfo.pSetLayouts = &descriptorSetLayout;
 
-    descriptorSets.resize(layouts.size());
-    if (vkAllocateDescriptorSets(device->getDevice(), &allocInfo, descriptorSets.data()) != VK_SUCCESS) {
-        std::cerr << "Failed to allocate descriptor sets" << std::endl;
+    if (vkAllocateDescriptorSets(device, &allocInfo, &batch.descriptorSet) != VK_SUCCESS) {
         return false;
     }
 
-    // Update descriptor sets
-    for (size_t i = 0; i < bufferSets.size(); i++) {
-        std::array<VkDescriptorBufferInfo, 4> bufferInfos{};
-        std::array<VkWriteDescriptorSet, 4> descriptorWrites{};
-
-        // Voxel buffer
-        bufferInfos[0].buffer = bufferSets[i]->voxelBuffer->getBuffer();
-        bufferInfos[0].offset = 0;
-        bufferInfos[0].range = VK_WHOLE_SIZE;
-
-        descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[0].dstSet = descriptorSets[i];
-        descriptorWrites[0].dstBinding = 0;
-        descriptorWrites[0].dstArrayElement = 0;
-        descriptorWrites[0].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorWrites[0].descriptorCount = 1;
-        descriptorWrites[0].pBufferInfo = &bufferInfos[0];
-
-        // Vertex buffer
-        bufferInfos[1].buffer = bufferSets[i]->vertexBuffer->getBuffer();
-        bufferInfos[1].offset = 0;
-        bufferInfos[1].range = VK_WHOLE_SIZE;
-
-        descriptorWrites[1].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[1].dstSet = descriptorSets[i];
-        descriptorWrites[1].dstBinding = 1;
-        descriptorWrites[1].dstArrayElement = 0;
-        descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorWrites[1].descriptorCount = 1;
-        descriptorWrites[1].pBufferInfo = &bufferInfos[1];
-
-        // Index buffer
-        bufferInfos[2].buffer = bufferSets[i]->indexBuffer->getBuffer();
-        bufferInfos[2].offset = 0;
-        bufferInfos[2].range = VK_WHOLE_SIZE;
-
-        descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[2].dstSet = descriptorSets[i];
-        descriptorWrites[2].dstBinding = 2;
-        descriptorWrites[2].dstArrayElement = 0;
-        descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorWrites[2].descriptorCount = 1;
-        descriptorWrites[2].pBufferInfo = &bufferInfos[2];
-
-        // Counter buffer
-        bufferInfos[3].buffer = bufferSets[i]->counterBuffer->getBuffer();
-        bufferInfos[3].offset = 0;
-        bufferInfos[3].range = VK_WHOLE_SIZE;
-
-        descriptorWrites[3].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-        descriptorWrites[3].dstSet = descriptorSets[i];
-        descriptorWrites[3].dstBinding = 3;
-        descriptorWrites[3].dstArrayElement = 0;
-        descriptorWrites[3].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
-        descriptorWrites[3].descriptorCount = 1;
-        descriptorWrites[3].pBufferInfo = &bufferInfos[3];
-
-        vkUpdateDescriptorSets(device->getDevice(), static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
+    // The whole batch binds once, nodes find their data through the node table
+    const std::array<VkDescriptorBufferInfo, 5> bufferInfos = {{
+        {batch.voxelBuffer, 0, VK_WHOLE_SIZE},
+        {batch.vertexBuffer, 0, VK_WHOLE_SIZE},
+        {batch.indexBuffer, 0, VK_WHOLE_SIZE},
+        {batch.counterBuffer, 0, VK_WHOLE_SIZE},
+        {batch.nodeBuffer, 0, VK_WHOLE_SIZE},
+    }};
+    std::array<VkWriteDescriptorSet, 5> descriptorWrites{};
+    for (uint32_t i = 0; i < descriptorWrites.size(); ++i) {
+        descriptorWrites[i].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        descriptorWrites[i].dstSet = batch.descriptorSet;
+        descriptorWrites[i].dstBinding = i;
+        descriptorWrites[i].dstArrayElement = 0;
+        descriptorWrites[i].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+        descriptorWrites[i].descriptorCount = 1;
+        descriptorWrites[i].pBufferInfo = &bufferInfos[i];
     }
-
+    vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
     return true;
 }
 
+VkPipeline MeshGenerator::getMeshPipeline(bool greedy, bool writeQuads) const {
+    return meshPipelines[(greedy ? 2 : 0) + (writeQuads ? 1 : 0)];
+}
+
 bool MeshGenerator::loadShaderFile(const std::string& filename, std::vector<char>& buffer) {
     std::ifstream file(filename, std::ios::ate | std::ios::binary);
     if (!file.is_open()) {
@@ -420,22 +392,7 @@ bool MeshGenerator::loadShaderFile(const std::string& filename, std::vector<char
         return false;
     }
 
-    std::cout << "Successfully loaded shader file: " << filename << " (size: " << fileSize << " bytes)" << std::endl;
     return true;
 }
 
-bool MeshGenerator::generateMesh(
-    const void* inputData,
-    size_t inputSize,
-    uint32_t lodLevel,
-    float lodTransitionFactor,
-    const float* position,
-    float size,
-    void* outputData,
-    size_t* outputSize
-) {
-    // TODO: Implement mesh generation
-    return false;
-}
-
-} // namespace voxceleron
\ No newline at end of file
+} // namespace voxceleron
@@ -1,80 +1,125 @@
 #pragma once
 
 #include <vulkan/vulkan.h>
+#include <array>
 #include <vector>
-#include <memory>
-#include <glm/glm.hpp>
 #include <string>
-#include "../core/VulkanDevice.h"
-#include "../core/VulkanBuffer.h"
-#include "../core/VulkanDescriptorSet.h"
+#include "../core/MemoryAllocator.h"
 
 namespace voxceleron {
 
-class VulkanDevice;
-class VulkanBuffer;
-class VulkanDescriptorSet;
+class VulkanContext;
 
 struct MeshGeneratorCreateInfo {
-    uint32_t maxVerticesPerNode;
-    uint32_t maxNodesInFlight;
-    uint32_t workgroupSizeX;
-    uint32_t workgroupSizeY;
-    uint32_t workgroupSizeZ;
+    uint32_t maxNodeSize;       // Largest node edge length, every voxel slot is sized for it
+    uint32_t maxNodesPerBatch;
+    uint32_t batchCount;        // Batches that can be recorded or in flight at once
+    uint32_t quadCapacity;      // Output quads shared by a batch's nodes, at least one worst-case node
 };
 
+// GPU mesher for many nodes at once. Each batch meshes all its nodes with three dispatches:
+// the mesher counts every node's quads, a scan gives each node its range of the batch's
+// shared output, and the mesher runs again to write the quads into those ranges. Workgroups
+// find their node from gl_WorkGroupID, so the dispatch count no longer grows with the nodes.
+// Nodes that do not fit the output are reported as overflowed and have to be resubmitted.
 class MeshGenerator {
 public:
-    MeshGenerator(VulkanDevice* device);
+    struct NodeResult {
+        uint32_t quadCount;
+        uint32_t faceCount;         // Visible unit faces before merging, quadCount for the culled mesher
+        VkDeviceSize vertexOffset;  // Bytes into getVertexBuffer, vertices or quad records
+        VkDeviceSize indexOffset;   // Bytes into getIndexBuffer, indices are relative to the node
+        bool overflow;              // Did not fit the batch's output, nothing was written
+    };
+
+    explicit MeshGenerator(VulkanContext* context);
     ~MeshGenerator();
 
     bool initialize(const MeshGeneratorCreateInfo& createInfo);
-    void cleanup();
-
-    bool generateMesh(
-        const void* inputData,
-        size_t inputSize,
-        uint32_t lodLevel,
-        float lodTransitionFactor,
-        const float* position,
-        float size,
-        void* outputData,
-        size_t* outputSize
-    );
+    void cleanup();  // Every batch must have finished
+
+    // Starts recording nodes into batch, whose previous results are no longer needed. All nodes
+    // of a batch share the output format and the meshing mode.
+    void beginBatch(uint32_t batch, bool writeQuads, bool greedy);
+    // Where the next node's nodeSize^3 voxel words go, x + y*n + z*n*n. Stage them there,
+    // then add the node.
+    VkBuffer getVoxelBuffer(uint32_t batch) const { return batches[batch].voxelBuffer; }
+    VkDeviceSize getNextVoxelOffset(uint32_t batch) const;
+    uint32_t addNode(uint32_t batch, uint32_t nodeSize);  // Returns the node's slot
+    uint32_t getNodeCount(uint32_t batch) const { return batches[batch].nodeCount; }
+    bool isBatchFull(uint32_t batch) const { return batches[batch].nodeCount == maxNodesPerBatch; }
+
+    // Records the batch's dispatches. Voxel uploads must be visible to compute shaders before
+    // it runs. Afterwards the output is ready for transfer reads and the counters for the host.
+    void recordBatch(uint32_t batch, VkCommandBuffer commandBuffer) const;
+
+    // Valid once the recorded commands have finished
+    NodeResult getResult(uint32_t batch, uint32_t slot) const;
+    VkBuffer getVertexBuffer(uint32_t batch) const { return batches[batch].vertexBuffer; }
+    VkBuffer getIndexBuffer(uint32_t batch) const { return batches[batch].indexBuffer; }
 
 private:
-    struct BufferSet {
-        std::unique_ptr<VulkanBuffer> voxelBuffer;
-        std::unique_ptr<VulkanBuffer> vertexBuffer;
-        std::unique_ptr<VulkanBuffer> indexBuffer;
-        std::unique_ptr<VulkanBuffer> counterBuffer;
+    // Mirror the shaders' MeshNode and NodeCounters
+    struct NodeInfo {
+        uint32_t voxelOffset;  // In words
+        uint32_t nodeSize;
+    };
 
-        BufferSet() {}
+    struct NodeCounters {
+        uint32_t quadCount;
+        uint32_t faceCount;
+        uint32_t emitted;
+        uint32_t quadBase;  // QUAD_BASE_OVERFLOW if the node did not fit
     };
 
-    static constexpr uint32_t MAX_BUFFER_SETS = 16;
-    static constexpr uint32_t MAX_VOXELS = 512 * 512 * 512;
-    static constexpr uint32_t MAX_VERTICES = MAX_VOXELS * 24;  // 24 vertices per voxel (worst case)
-    static constexpr uint32_t MAX_INDICES = MAX_VERTICES * 1.5; // Assuming triangles
+    struct PushConstants {
+        uint32_t nodeCount;
+        uint32_t groupsPerAxis;
+        uint32_t quadCapacity;
+        uint32_t countOnly;
+    };
+
+    struct Batch {
+        VkBuffer voxelBuffer = VK_NULL_HANDLE;
+        MemoryAllocation voxelAllocation;
+        VkBuffer vertexBuffer = VK_NULL_HANDLE;   // Packed vertices or quad records
+        MemoryAllocation vertexAllocation;
+        VkBuffer indexBuffer = VK_NULL_HANDLE;
+        MemoryAllocation indexAllocation;
+        VkBuffer counterBuffer = VK_NULL_HANDLE;  // Host-visible NodeCounters per slot
+        MemoryAllocation counterAllocation;
+        VkBuffer nodeBuffer = VK_NULL_HANDLE;     // Host-visible NodeInfo per slot
+        MemoryAllocation nodeAllocation;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        uint32_t nodeCount = 0;
+        uint32_t largestNode = 0;
+        bool writeQuads = false;
+        bool greedy = false;
+    };
+
+    static constexpr uint32_t QUAD_BASE_OVERFLOW = UINT32_MAX;
+    static constexpr uint32_t CULLED_GROUP_SIZE = 8;  // local_size of mesh_generator.comp
+
+    VulkanContext* context;
+    VkDevice device;
+    uint32_t maxNodeSize;
+    uint32_t maxNodesPerBatch;
+    uint32_t quadCapacity;
 
-    VulkanDevice* device;
-    VkPipeline computePipeline;
-    VkPipelineLayout pipelineLayout;
     VkDescriptorSetLayout descriptorSetLayout;
     VkDescriptorPool descriptorPool;
-    std::vector<std::unique_ptr<BufferSet>> bufferSets;
-    std::vector<VkDescriptorSet> descriptorSets;
-    size_t currentBufferSet;
-    uint32_t workgroupSizeX;
-    uint32_t workgroupSizeY;
-    uint32_t workgroupSizeZ;
+    VkPipelineLayout pipelineLayout;
+    // Culled and greedy mesher, each writing indexed vertices or quad records
+    std::array<VkPipeline, 4> meshPipelines;
+    VkPipeline scanPipeline;
+    std::vector<Batch> batches;
 
     bool createDescriptorSetLayout();
-    bool createComputePipeline();
-    bool createBuffers(const MeshGeneratorCreateInfo& createInfo);
     bool createDescriptorPool(uint32_t maxSets);
-    bool allocateDescriptorSets();
+    bool createPipeline(const std::string& shaderPath, bool writeQuads, VkPipeline& pipeline);
+    bool createBatch(Batch& batch);
+    VkPipeline getMeshPipeline(bool greedy, bool writeQuads) const;
     bool loadShaderFile(const std::string& filename, std::vector<char>& buffer);
 };
 
-} // namespace voxceleron 
\ No newline at end of file
+} // namespace voxceleron
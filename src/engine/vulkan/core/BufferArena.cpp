@@ -0,0 +1,258 @@
+#include "BufferArena.h"
+#include "VulkanContext.h"
+#include "UploadQueue.h"
+#include <algorithm>
+#include <iostream>
+
+namespace voxceleron {
+
+namespace {
+
+// Pages below this fill are emptied into the others
+constexpr uint64_t COMPACT_FILL_DIVISOR = 4;
+
+} // namespace
+
+BufferArena::BufferArena(VulkanContext* context, VkBufferUsageFlags usage, uint32_t stride, VkDeviceSize pageSize)
+    : context(context)
+    , usage(usage | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT)
+    , stride(std::max<uint32_t>(stride, 1))
+    , pageSize(pageSize)
+    , frame(0)
+    , movedBytes(0) {
+}
+
+BufferArena::~BufferArena() {
+    // The device must be idle, retired ranges go away with their pages
+    for (std::unique_ptr<Page>& page : pages) {
+        if (page) {
+            context->destroyBuffer(page->buffer, page->allocation);
+        }
+    }
+}
+
+BufferArena::Handle BufferArena::allocate(uint32_t count) {
+    if (count == 0) return INVALID_HANDLE;
+
+    Range range{};
+    uint32_t tlsfRange = TlsfAllocator::INVALID_RANGE;
+    bool allocated = false;
+    for (uint32_t i = 0; i < pages.size() && !allocated; ++i) {
+        allocated = pages[i] && !pages[i]->draining && allocateFrom(i, count, range, tlsfRange);
+    }
+    if (!allocated) {
+        const uint32_t page = createPage(count);
+        allocated = page != UINT32_MAX && allocateFrom(page, count, range, tlsfRange);
+    }
+    if (!allocated) {
+        // Out of memory for another page, a page being emptied is better than failing
+        for (uint32_t i = 0; i < pages.size() && !allocated; ++i) {
+            if (pages[i] && pages[i]->draining && allocateFrom(i, count, range, tlsfRange)) {
+                pages[i]->draining = false;
+                allocated = true;
+            }
+        }
+    }
+    if (!allocated) return INVALID_HANDLE;
+
+    Handle handle;
+    if (!freeSlots.empty()) {
+        handle = freeSlots.back();
+        freeSlots.pop_back();
+    } else {
+        handle = static_cast<Handle>(slots.size());
+        slots.emplace_back();
+    }
+    slots[handle].range = range;
+    slots[handle].tlsfRange = tlsfRange;
+    slots[handle].live = true;
+    pages[range.page]->liveCount++;
+    return handle;
+}
+
+void BufferArena::free(Handle handle) {
+    if (handle == INVALID_HANDLE || handle >= slots.size() || !slots[handle].live) return;
+
+    Slot& slot = slots[handle];
+    if (slot.moving) {
+        for (PendingMove& move : pendingMoves) {
+            move.cancelled = move.cancelled || move.handle == handle;
+        }
+    }
+    pages[slot.range.page]->liveCount--;
+    retire(slot.range.page, slot.tlsfRange, slot.range.count);
+    slot = Slot{};
+    freeSlots.push_back(handle);
+}
+
+void BufferArena::advanceFrame() {
+    frame++;
+
+    // Ranges freed RETIRE_FRAMES ago are no longer read by any frame
+    auto expired = std::partition(retired.begin(), retired.end(),
+        [this](const RetiredRange& range) { return range.frame + RETIRE_FRAMES > frame; });
+    for (auto it = expired; it != retired.end(); ++it) {
+        Page& page = *pages[it->page];
+        page.ranges.free(it->tlsfRange);
+        page.retiredCount--;
+    }
+    retired.erase(expired, retired.end());
+
+    // Pages emptied by compaction give their memory back
+    for (std::unique_ptr<Page>& page : pages) {
+        if (page && page->draining && page->ranges.isEmpty() && page->retiredCount == 0) {
+            context->destroyBuffer(page->buffer, page->allocation);
+            page.reset();
+        }
+    }
+}
+
+bool BufferArena::needsCompaction() const {
+    return findSparsestPage() != UINT32_MAX;
+}
+
+VkDeviceSize BufferArena::compact(UploadQueue& uploads, VkDeviceSize maxBytes) {
+    const uint32_t source = findSparsestPage();
+    if (source == UINT32_MAX) return 0;
+    pages[source]->draining = true;
+
+    VkDeviceSize staged = 0;
+    for (Handle handle = 0; handle < slots.size() && staged < maxBytes; ++handle) {
+        Slot& slot = slots[handle];
+        if (!slot.live || slot.moving || slot.range.page != source) continue;
+
+        // Only pages that stay are targets, the source is on its way out
+        Range target{};
+        uint32_t tlsfRange = TlsfAllocator::INVALID_RANGE;
+        bool allocated = false;
+        for (uint32_t i = 0; i < pages.size() && !allocated; ++i) {
+            allocated = i != source && pages[i] && !pages[i]->draining &&
+                        allocateFrom(i, slot.range.count, target, tlsfRange);
+        }
+        if (!allocated) break;
+
+        const VkDeviceSize bytes = VkDeviceSize(slot.range.count) * stride;
+        uploads.copy(pages[source]->buffer, VkDeviceSize(slot.range.first) * stride,
+                     pages[target.page]->buffer, VkDeviceSize(target.first) * stride, bytes);
+        pendingMoves.push_back({handle, target, tlsfRange, uploads.getRecordingSerial()});
+        slot.moving = true;
+        staged += bytes;
+    }
+    return staged;
+}
+
+VkDeviceSize BufferArena::finishMoves(UploadQueue& uploads) {
+    VkDeviceSize moved = 0;
+    size_t kept = 0;
+    for (size_t i = 0; i < pendingMoves.size(); ++i) {
+        const PendingMove& move = pendingMoves[i];
+        if (!uploads.isComplete(move.serial)) {
+            pendingMoves[kept++] = move;
+            continue;
+        }
+
+        // Nothing reads the target of a cancelled move once its copy is done
+        if (move.cancelled) {
+            pages[move.target.page]->ranges.free(move.tlsfRange);
+            continue;
+        }
+
+        // Frames in flight still draw from the old range
+        Slot& slot = slots[move.handle];
+        retire(slot.range.page, slot.tlsfRange, slot.range.count);
+        pages[slot.range.page]->liveCount--;
+        pages[move.target.page]->liveCount++;
+        slot.range = move.target;
+        slot.tlsfRange = move.tlsfRange;
+        slot.moving = false;
+        moved += VkDeviceSize(move.target.count) * stride;
+    }
+    pendingMoves.resize(kept);
+
+    movedBytes += moved;
+    return moved;
+}
+
+BufferArena::Stats BufferArena::getStats() const {
+    Stats stats;
+    for (const std::unique_ptr<Page>& page : pages) {
+        if (!page) continue;
+        stats.pageCount++;
+        stats.pageBytes += page->ranges.getSize() * stride;
+    }
+    for (const Slot& slot : slots) {
+        if (!slot.live) continue;
+        stats.allocationCount++;
+        stats.usedBytes += VkDeviceSize(slot.range.count) * stride;
+    }
+    for (const RetiredRange& range : retired) {
+        stats.retiredBytes += VkDeviceSize(range.count) * stride;
+    }
+    stats.movedBytes = movedBytes;
+    return stats;
+}
+
+bool BufferArena::allocateFrom(uint32_t page, uint32_t count, Range& range, uint32_t& tlsfRange) {
+    uint64_t first;
+    tlsfRange = pages[page]->ranges.allocate(count, 1, first);
+    if (tlsfRange == TlsfAllocator::INVALID_RANGE) return false;
+
+    range.page = page;
+    range.first = static_cast<uint32_t>(first);
+    range.count = count;
+    return true;
+}
+
+uint32_t BufferArena::createPage(uint32_t minElements) {
+    // Meshes larger than a page get a page of their own size
+    const uint32_t elements = static_cast<uint32_t>(std::max<VkDeviceSize>(pageSize / stride, minElements));
+    auto page = std::make_unique<Page>(elements);
+    if (!context->createBuffer(VkDeviceSize(elements) * stride, usage, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
+                               page->buffer, page->allocation)) {
+        std::cerr << "BufferArena: Failed to create a page of " << elements << " elements" << std::endl;
+        return UINT32_MAX;
+    }
+
+    auto freeSlot = std::find(pages.begin(), pages.end(), nullptr);
+    if (freeSlot != pages.end()) {
+        *freeSlot = std::move(page);
+        return static_cast<uint32_t>(freeSlot - pages.begin());
+    }
+    pages.push_back(std::move(page));
+    return static_cast<uint32_t>(pages.size() - 1);
+}
+
+void BufferArena::retire(uint32_t page, uint32_t tlsfRange, uint32_t count) {
+    retired.push_back({page, tlsfRange, count, frame});
+    pages[page]->retiredCount++;
+}
+
+uint32_t BufferArena::findSparsestPage() const {
+    // A page already being emptied is finished first
+    uint32_t sparsest = UINT32_MAX;
+    uint64_t sparsestUsed = UINT64_MAX;
+    uint64_t freeElements = 0;
+    uint32_t openPages = 0;
+    for (uint32_t i = 0; i < pages.size(); ++i) {
+        if (!pages[i]) continue;
+        const TlsfAllocator& ranges = pages[i]->ranges;
+        if (pages[i]->draining) {
+            if (pages[i]->liveCount > 0) return i;
+            continue;
+        }
+        openPages++;
+        freeElements += ranges.getSize() - ranges.getUsedSize();
+        if (ranges.getUsedSize() < ranges.getSize() / COMPACT_FILL_DIVISOR && ranges.getUsedSize() < sparsestUsed) {
+            sparsest = i;
+            sparsestUsed = ranges.getUsedSize();
+        }
+    }
+    if (sparsest == UINT32_MAX || openPages < 2) return UINT32_MAX;
+
+    // Worth it only when the other pages can take everything the sparse one holds
+    const TlsfAllocator& ranges = pages[sparsest]->ranges;
+    const uint64_t othersFree = freeElements - (ranges.getSize() - ranges.getUsedSize());
+    return othersFree >= sparsestUsed ? sparsest : UINT32_MAX;
+}
+
+} // namespace voxceleron
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "MemoryAllocator.h"
+#include "TlsfAllocator.h"
+
+namespace voxceleron {
+
+class VulkanContext;
+class UploadQueue;
+
+// Ranges of fixed-stride elements packed into a few large device-local buffers (pages), so
+// many meshes share one bind. Offsets are in elements. Handles stay valid while compaction
+// moves their ranges between pages, draws look the current range up every frame. A moved
+// handle keeps its old range until the upload batch copying it has finished.
+// Freed ranges are only reused once the frames that may still read them have finished.
+class BufferArena {
+public:
+    using Handle = uint32_t;
+    static constexpr Handle INVALID_HANDLE = UINT32_MAX;
+    static constexpr VkDeviceSize DEFAULT_PAGE_SIZE = VkDeviceSize(32) << 20;
+    static constexpr uint32_t RETIRE_FRAMES = 2;  // Frames the renderer keeps in flight
+
+    struct Range {
+        uint32_t page;
+        uint32_t first;  // Element offset within the page
+        uint32_t count;
+    };
+
+    struct Stats {
+        uint32_t pageCount = 0;
+        VkDeviceSize pageBytes = 0;
+        uint32_t allocationCount = 0;
+        VkDeviceSize usedBytes = 0;
+        VkDeviceSize retiredBytes = 0;   // Freed but possibly still read by frames in flight
+        VkDeviceSize movedBytes = 0;     // Moved by compaction since creation
+    };
+
+    // usage is combined with transfer source and destination for uploads and compaction
+    BufferArena(VulkanContext* context, VkBufferUsageFlags usage, uint32_t stride,
+                VkDeviceSize pageSize = DEFAULT_PAGE_SIZE);
+    ~BufferArena();
+
+    BufferArena(const BufferArena&) = delete;
+    BufferArena& operator=(const BufferArena&) = delete;
+
+    // Opens a new page when the open ones are full, INVALID_HANDLE if that fails
+    Handle allocate(uint32_t count);
+    void free(Handle handle);  // Ignores INVALID_HANDLE
+
+    const Range& getRange(Handle handle) const { return slots[handle].range; }
+    VkDeviceSize getByteOffset(Handle handle) const { return VkDeviceSize(slots[handle].range.first) * stride; }
+    VkBuffer getBuffer(uint32_t page) const { return page < pages.size() && pages[page] ? pages[page]->buffer : VK_NULL_HANDLE; }
+    uint32_t getPageSlotCount() const { return static_cast<uint32_t>(pages.size()); }  // Includes released pages
+    uint32_t getStride() const { return stride; }
+
+    // Call once per frame: releases retired ranges and pages left empty by compaction
+    void advanceFrame();
+
+    // True when a sparse page could be emptied into the others
+    bool needsCompaction() const;
+    // Stages copies moving up to maxBytes out of the sparsest page into the recording upload
+    // batch. Ranges written by that batch are not read, so call it after the frame's flush.
+    // Returns the bytes staged.
+    VkDeviceSize compact(UploadQueue& uploads, VkDeviceSize maxBytes);
+    // Points handles at the ranges their finished copies went to and retires the old ranges.
+    // Returns the bytes moved, draws built from the previous ranges must be rebuilt if any.
+    VkDeviceSize finishMoves(UploadQueue& uploads);
+
+    Stats getStats() const;
+
+private:
+    struct Page {
+        VkBuffer buffer = VK_NULL_HANDLE;
+        MemoryAllocation allocation;
+        TlsfAllocator ranges;
+        uint32_t liveCount = 0;     // Ranges owned by a handle
+        uint32_t retiredCount = 0;  // Ranges waiting for their frames to finish
+        bool draining = false;      // Being emptied by compaction, takes no new ranges
+
+        explicit Page(uint32_t elements) : ranges(elements) {}
+    };
+
+    struct Slot {
+        Range range{};
+        uint32_t tlsfRange = TlsfAllocator::INVALID_RANGE;
+        bool live = false;
+        bool moving = false;  // Has a PendingMove
+    };
+
+    // Copy staged by compaction, the handle switches over once its batch has finished
+    struct PendingMove {
+        Handle handle;
+        Range target;
+        uint32_t tlsfRange;
+        uint64_t serial;         // Upload batch the copy goes out with
+        bool cancelled = false;  // Handle freed meanwhile, the target is released
+    };
+
+    struct RetiredRange {
+        uint32_t page;
+        uint32_t tlsfRange;
+        uint32_t count;
+        uint64_t frame;  // Frame the range was freed in
+    };
+
+    VulkanContext* context;
+    VkBufferUsageFlags usage;
+    uint32_t stride;
+    VkDeviceSize pageSize;
+    uint64_t frame;
+    VkDeviceSize movedBytes;
+
+    std::vector<std::unique_ptr<Page>> pages;  // Null slots are reused
+    std::vector<Slot> slots;
+    std::vector<Handle> freeSlots;
+    std::vector<RetiredRange> retired;
+    std::vector<PendingMove> pendingMoves;
+
+    bool allocateFrom(uint32_t page, uint32_t count, Range& range, uint32_t& tlsfRange);
+    uint32_t createPage(uint32_t minElements);
+    void retire(uint32_t page, uint32_t tlsfRange, uint32_t count);
+    uint32_t findSparsestPage() const;
+};
+
+} // namespace voxceleron
@@ -0,0 +1,202 @@
+#include "MemoryAllocator.h"
+#include <algorithm>
+#include <iostream>
+
+namespace voxceleron {
+
+MemoryAllocator::MemoryAllocator(std::unique_ptr<MemoryBackend> backend, const VkPhysicalDeviceMemoryProperties& properties,
+                                 VkDeviceSize nonCoherentAtomSize, VkDeviceSize blockSize)
+    : backend(std::move(backend))
+    , nonCoherentAtomSize(std::max<VkDeviceSize>(nonCoherentAtomSize, 1)) {
+    types.resize(properties.memoryTypeCount);
+    for (uint32_t i = 0; i < properties.memoryTypeCount; ++i) {
+        // Small heaps (such as the host-visible part of VRAM) get proportionally smaller blocks
+        const VkDeviceSize heapSize = properties.memoryHeaps[properties.memoryTypes[i].heapIndex].size;
+        types[i].properties = properties.memoryTypes[i].propertyFlags;
+        types[i].blockSize = heapSize / 8 > 0 ? std::min(blockSize, heapSize / 8) : blockSize;
+    }
+}
+
+MemoryAllocator::~MemoryAllocator() {
+    if (stats.allocationCount > 0) {
+        std::cerr << "MemoryAllocator: " << stats.allocationCount << " allocations still live at shutdown" << std::endl;
+    }
+
+    for (MemoryType& type : types) {
+        for (std::unique_ptr<Block>& block : type.blocks) {
+            if (!block) continue;
+            if (block->mapped) {
+                backend->unmap(block->memory);
+            }
+            backend->free(block->memory);
+        }
+    }
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const {
+    for (uint32_t i = 0; i < types.size(); ++i) {
+        if ((typeBits & (1u << i)) && (types[i].properties & properties) == properties) {
+            return i;
+        }
+    }
+    return UINT32_MAX;
+}
+
+bool MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                               MemoryAllocation& allocation) {
+    std::lock_guard<std::mutex> lock(mutex);
+    allocation = MemoryAllocation{};
+    if (requirements.size == 0) return false;
+
+    for (uint32_t i = 0; i < types.size(); ++i) {
+        if (!(requirements.memoryTypeBits & (1u << i)) || (types[i].properties & properties) != properties) continue;
+
+        VkDeviceSize size = requirements.size;
+        VkDeviceSize alignment = std::max<VkDeviceSize>(requirements.alignment, 1);
+        const VkMemoryPropertyFlags flags = types[i].properties;
+        if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT)) {
+            alignment = std::max(alignment, nonCoherentAtomSize);
+            size = (size + nonCoherentAtomSize - 1) / nonCoherentAtomSize * nonCoherentAtomSize;
+        }
+
+        // Large requests would waste most of a block, and blocks may fail where less memory succeeds
+        const bool allocated = size > types[i].blockSize / 2
+            ? allocateDedicated(i, size, allocation)
+            : allocateFromType(i, size, alignment, allocation) || allocateDedicated(i, size, allocation);
+        if (allocated) {
+            stats.allocationCount++;
+            stats.usedBytes += size;
+            return true;
+        }
+    }
+    return false;
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation) {
+    if (!allocation.isValid()) return;
+
+    std::lock_guard<std::mutex> lock(mutex);
+    MemoryType& type = types[allocation.memoryType];
+    stats.allocationCount--;
+    stats.usedBytes -= allocation.size;
+
+    if (allocation.block == DEDICATED_BLOCK) {
+        if (allocation.mapped) {
+            backend->unmap(allocation.memory);
+        }
+        backend->free(allocation.memory);
+        stats.blockCount--;
+        stats.blockBytes -= allocation.size;
+        stats.dedicatedCount--;
+        stats.dedicatedBytes -= allocation.size;
+        allocation = MemoryAllocation{};
+        return;
+    }
+
+    std::unique_ptr<Block>& block = type.blocks[allocation.block];
+    block->ranges.free(allocation.range);
+
+    // Keep one block per type around so a type that empties and refills doesn't churn
+    const size_t liveBlocks = std::count_if(type.blocks.begin(), type.blocks.end(),
+                                            [](const std::unique_ptr<Block>& b) { return b != nullptr; });
+    if (block->ranges.isEmpty() && liveBlocks > 1) {
+        if (block->mapped) {
+            backend->unmap(block->memory);
+        }
+        backend->free(block->memory);
+        stats.blockCount--;
+        stats.blockBytes -= block->ranges.getSize();
+        block.reset();
+    }
+    allocation = MemoryAllocation{};
+}
+
+MemoryStats MemoryAllocator::getStats() const {
+    std::lock_guard<std::mutex> lock(mutex);
+    return stats;
+}
+
+VkDeviceSize MemoryAllocator::getBlockSize(uint32_t memoryType) const {
+    return memoryType < types.size() ? types[memoryType].blockSize : 0;
+}
+
+bool MemoryAllocator::allocateFromType(uint32_t memoryType, VkDeviceSize size, VkDeviceSize alignment,
+                                       MemoryAllocation& allocation) {
+    MemoryType& type = types[memoryType];
+
+    const auto allocateFrom = [&](uint32_t index) {
+        Block& block = *type.blocks[index];
+        VkDeviceSize offset;
+        const uint32_t range = block.ranges.allocate(size, alignment, offset);
+        if (range == TlsfAllocator::INVALID_RANGE) return false;
+
+        allocation.memory = block.memory;
+        allocation.offset = offset;
+        allocation.size = size;
+        allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + offset : nullptr;
+        allocation.memoryType = memoryType;
+        allocation.block = index;
+        allocation.range = range;
+        return true;
+    };
+
+    uint32_t freeSlot = UINT32_MAX;
+    for (uint32_t i = 0; i < type.blocks.size(); ++i) {
+        if (!type.blocks[i]) {
+            freeSlot = std::min(freeSlot, i);
+        } else if (allocateFrom(i)) {
+            return true;
+        }
+    }
+
+    // Every block is full, open a new one
+    VkDeviceMemory memory;
+    if (!backend->allocate(memoryType, type.blockSize, memory)) return false;
+
+    void* mapped = mapMemory(memoryType, memory);
+    if ((type.properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !mapped) {
+        backend->free(memory);
+        return false;
+    }
+
+    if (freeSlot == UINT32_MAX) {
+        freeSlot = static_cast<uint32_t>(type.blocks.size());
+        type.blocks.emplace_back();
+    }
+    type.blocks[freeSlot] = std::make_unique<Block>(memory, mapped, type.blockSize);
+    stats.blockCount++;
+    stats.blockBytes += type.blockSize;
+    return allocateFrom(freeSlot);
+}
+
+bool MemoryAllocator::allocateDedicated(uint32_t memoryType, VkDeviceSize size, MemoryAllocation& allocation) {
+    VkDeviceMemory memory;
+    if (!backend->allocate(memoryType, size, memory)) return false;
+
+    void* mapped = mapMemory(memoryType, memory);
+    if ((types[memoryType].properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !mapped) {
+        backend->free(memory);
+        return false;
+    }
+
+    allocation.memory = memory;
+    allocation.offset = 0;
+    allocation.size = size;
+    allocation.mapped = mapped;
+    allocation.memoryType = memoryType;
+    allocation.block = DEDICATED_BLOCK;
+    allocation.range = TlsfAllocator::INVALID_RANGE;
+
+    stats.blockCount++;
+    stats.blockBytes += size;
+    stats.dedicatedCount++;
+    stats.dedicatedBytes += size;
+    return true;
+}
+
+void* MemoryAllocator::mapMemory(uint32_t memoryType, VkDeviceMemory memory) {
+    if (!(types[memoryType].properties & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)) return nullptr;
+    return backend->map(memory);
+}
+
+} // namespace voxceleron
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "TlsfAllocator.h"
+
+namespace voxceleron {
+
+// Source of device memory objects. VulkanMemoryBackend forwards to the device, tests can
+// substitute a fake that hands out host memory.
+class MemoryBackend {
+public:
+    virtual ~MemoryBackend() = default;
+
+    virtual bool allocate(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory& memory) = 0;
+    virtual void free(VkDeviceMemory memory) = 0;
+    virtual void* map(VkDeviceMemory memory) = 0;  // Whole object, null on failure
+    virtual void unmap(VkDeviceMemory memory) = 0;
+};
+
+// A range of device memory. Buffers bind at memory + offset, host-visible ranges are
+// persistently mapped and must never be mapped through vkMapMemory.
+struct MemoryAllocation {
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+    void* mapped = nullptr;      // Host pointer to offset, null unless host-visible
+    uint32_t memoryType = UINT32_MAX;
+    uint32_t block = UINT32_MAX; // Block within the memory type, DEDICATED_BLOCK for own memory
+    uint32_t range = TlsfAllocator::INVALID_RANGE;
+
+    bool isValid() const { return memory != VK_NULL_HANDLE; }
+};
+
+struct MemoryStats {
+    uint32_t blockCount = 0;      // Device memory objects, blocks and dedicated allocations
+    uint64_t blockBytes = 0;      // Bytes allocated from the device
+    uint32_t allocationCount = 0; // Live allocations
+    uint64_t usedBytes = 0;       // Bytes handed out, excluding alignment padding
+    uint32_t dedicatedCount = 0;  // Allocations too large to share a block
+    uint64_t dedicatedBytes = 0;
+};
+
+// Sub-allocates buffers from large blocks per memory type, so the engine makes a handful
+// of vkAllocateMemory calls instead of one per buffer. Requests larger than half a block
+// get their own memory object. Thread-safe.
+class MemoryAllocator {
+public:
+    static constexpr uint32_t DEDICATED_BLOCK = UINT32_MAX - 1;
+    static constexpr VkDeviceSize DEFAULT_BLOCK_SIZE = VkDeviceSize(64) << 20;
+
+    // nonCoherentAtomSize aligns ranges in host-visible, non-coherent memory so they can be
+    // flushed on their own
+    MemoryAllocator(std::unique_ptr<MemoryBackend> backend, const VkPhysicalDeviceMemoryProperties& properties,
+                    VkDeviceSize nonCoherentAtomSize, VkDeviceSize blockSize = DEFAULT_BLOCK_SIZE);
+    ~MemoryAllocator();
+
+    MemoryAllocator(const MemoryAllocator&) = delete;
+    MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+    // Tries every memory type that allows the requirements and has all properties.
+    // allocation is left empty on failure.
+    bool allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+                  MemoryAllocation& allocation);
+    void free(MemoryAllocation& allocation);  // Resets allocation, empty allocations are ignored
+
+    // First memory type allowed by typeBits with all properties, UINT32_MAX if none
+    uint32_t findMemoryType(uint32_t typeBits, VkMemoryPropertyFlags properties) const;
+
+    MemoryStats getStats() const;
+    VkDeviceSize getBlockSize(uint32_t memoryType) const;
+
+private:
+    struct Block {
+        VkDeviceMemory memory;
+        void* mapped;             // Base pointer for host-visible types
+        TlsfAllocator ranges;
+
+        Block(VkDeviceMemory memory, void* mapped, VkDeviceSize size)
+            : memory(memory), mapped(mapped), ranges(size) {}
+    };
+
+    struct MemoryType {
+        VkMemoryPropertyFlags properties;
+        VkDeviceSize blockSize;
+        std::vector<std::unique_ptr<Block>> blocks;  // Null slots are reused
+    };
+
+    std::unique_ptr<MemoryBackend> backend;
+    std::vector<MemoryType> types;
+    VkDeviceSize nonCoherentAtomSize;
+    MemoryStats stats;
+    mutable std::mutex mutex;
+
+    bool allocateFromType(uint32_t memoryType, VkDeviceSize size, VkDeviceSize alignment,
+                          MemoryAllocation& allocation);
+    bool allocateDedicated(uint32_t memoryType, VkDeviceSize size, MemoryAllocation& allocation);
+    void* mapMemory(uint32_t memoryType, VkDeviceMemory memory);
+};
+
+} // namespace voxceleron
@@ -0,0 +1,252 @@
+#include "TlsfAllocator.h"
+#include <algorithm>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+namespace voxceleron {
+
+namespace {
+
+// Index of the lowest set bit, bits must be non-zero
+uint32_t lowestBit(uint64_t bits) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward64(&index, bits);
+    return static_cast<uint32_t>(index);
+#else
+    return static_cast<uint32_t>(__builtin_ctzll(bits));
+#endif
+}
+
+// Index of the highest set bit, bits must be non-zero
+uint32_t highestBit(uint64_t bits) {
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanReverse64(&index, bits);
+    return static_cast<uint32_t>(index);
+#else
+    return 63u - static_cast<uint32_t>(__builtin_clzll(bits));
+#endif
+}
+
+} // namespace
+
+TlsfAllocator::TlsfAllocator(uint64_t size)
+    : size(size)
+    , usedSize(0)
+    , allocationCount(0)
+    , freeRangeCount(0)
+    , flBitmap(0) {
+    std::fill(std::begin(slBitmaps), std::end(slBitmaps), 0u);
+    for (auto& list : heads) {
+        std::fill(std::begin(list), std::end(list), INVALID_RANGE);
+    }
+    if (size > 0) {
+        insertFree(createRange(0, size));
+    }
+}
+
+void TlsfAllocator::mapping(uint64_t size, uint32_t& fl, uint32_t& sl) {
+    if (size < SL_COUNT) {
+        fl = 0;
+        sl = static_cast<uint32_t>(size);
+        return;
+    }
+    const uint32_t log2 = highestBit(size);
+    fl = log2 - SL_BITS + 1;
+    sl = static_cast<uint32_t>(size >> (log2 - SL_BITS)) - SL_COUNT;
+}
+
+bool TlsfAllocator::findFreeRange(uint64_t size, uint32_t& fl, uint32_t& sl) const {
+    // Round up to the next class boundary so every range in the class found is large enough
+    if (size >= SL_COUNT) {
+        const uint64_t step = uint64_t(1) << (highestBit(size) - SL_BITS);
+        size += step - 1;
+    }
+    mapping(size, fl, sl);
+    if (fl >= FL_COUNT) return false;
+
+    uint32_t slMap = slBitmaps[fl] & (~0u << sl);
+    if (slMap == 0) {
+        const uint64_t flMap = fl + 1 < 64 ? flBitmap & (~uint64_t(0) << (fl + 1)) : 0;
+        if (flMap == 0) return false;
+        fl = lowestBit(flMap);
+        slMap = slBitmaps[fl];
+    }
+    sl = lowestBit(slMap);
+    return true;
+}
+
+uint32_t TlsfAllocator::allocate(uint64_t size, uint64_t alignment, uint64_t& offset) {
+    if (size == 0 || size > this->size) return INVALID_RANGE;
+    alignment = std::max<uint64_t>(alignment, 1);
+
+    // Any range of at least size + alignment - 1 bytes holds an aligned block
+    const uint64_t required = size + alignment - 1;
+    uint32_t fl;
+    uint32_t sl;
+    uint32_t range = INVALID_RANGE;
+    if (findFreeRange(required, fl, sl)) {
+        range = heads[fl][sl];
+    } else {
+        // Larger classes are empty, a range in the request's own class may still fit
+        mapping(required, fl, sl);
+        if (fl >= FL_COUNT) return INVALID_RANGE;
+        for (range = heads[fl][sl]; range != INVALID_RANGE; range = ranges[range].nextFree) {
+            if (ranges[range].size >= required) break;
+        }
+        if (range == INVALID_RANGE) return INVALID_RANGE;
+    }
+    removeFree(range);
+
+    // Leading padding and the unused tail go back to the free lists
+    const uint64_t aligned = (ranges[range].offset + alignment - 1) & ~(alignment - 1);
+    if (aligned > ranges[range].offset) {
+        splitBefore(range, aligned - ranges[range].offset);
+    }
+    if (ranges[range].size > size) {
+        splitAfter(range, size);
+    }
+
+    ranges[range].free = false;
+    usedSize += size;
+    allocationCount++;
+    offset = ranges[range].offset;
+    return range;
+}
+
+void TlsfAllocator::free(uint32_t range) {
+    if (range >= ranges.size() || ranges[range].free) return;
+
+    usedSize -= ranges[range].size;
+    allocationCount--;
+
+    // Merge with free neighbours so the range is always as large as possible
+    const uint32_t prev = ranges[range].prevPhysical;
+    if (prev != INVALID_RANGE && ranges[prev].free) {
+        removeFree(prev);
+        ranges[prev].size += ranges[range].size;
+        ranges[prev].nextPhysical = ranges[range].nextPhysical;
+        if (ranges[range].nextPhysical != INVALID_RANGE) {
+            ranges[ranges[range].nextPhysical].prevPhysical = prev;
+        }
+        releaseRange(range);
+        range = prev;
+    }
+
+    const uint32_t next = ranges[range].nextPhysical;
+    if (next != INVALID_RANGE && ranges[next].free) {
+        removeFree(next);
+        ranges[range].size += ranges[next].size;
+        ranges[range].nextPhysical = ranges[next].nextPhysical;
+        if (ranges[next].nextPhysical != INVALID_RANGE) {
+            ranges[ranges[next].nextPhysical].prevPhysical = range;
+        }
+        releaseRange(next);
+    }
+
+    insertFree(range);
+}
+
+uint64_t TlsfAllocator::getLargestFreeRange() const {
+    if (flBitmap == 0) return 0;
+
+    // Only the highest non-empty class can hold the largest range
+    const uint32_t fl = highestBit(flBitmap);
+    const uint32_t sl = highestBit(slBitmaps[fl]);
+    uint64_t largest = 0;
+    for (uint32_t range = heads[fl][sl]; range != INVALID_RANGE; range = ranges[range].nextFree) {
+        largest = std::max(largest, ranges[range].size);
+    }
+    return largest;
+}
+
+uint32_t TlsfAllocator::createRange(uint64_t offset, uint64_t size) {
+    Range value{offset, size, INVALID_RANGE, INVALID_RANGE, INVALID_RANGE, INVALID_RANGE, false};
+    if (!unusedRanges.empty()) {
+        const uint32_t range = unusedRanges.back();
+        unusedRanges.pop_back();
+        ranges[range] = value;
+        return range;
+    }
+    ranges.push_back(value);
+    return static_cast<uint32_t>(ranges.size() - 1);
+}
+
+void TlsfAllocator::releaseRange(uint32_t range) {
+    ranges[range].free = false;
+    unusedRanges.push_back(range);
+}
+
+void TlsfAllocator::insertFree(uint32_t range) {
+    uint32_t fl;
+    uint32_t sl;
+    mapping(ranges[range].size, fl, sl);
+
+    const uint32_t head = heads[fl][sl];
+    ranges[range].free = true;
+    ranges[range].prevFree = INVALID_RANGE;
+    ranges[range].nextFree = head;
+    if (head != INVALID_RANGE) {
+        ranges[head].prevFree = range;
+    }
+    heads[fl][sl] = range;
+    slBitmaps[fl] |= 1u << sl;
+    flBitmap |= uint64_t(1) << fl;
+    freeRangeCount++;
+}
+
+void TlsfAllocator::removeFree(uint32_t range) {
+    uint32_t fl;
+    uint32_t sl;
+    mapping(ranges[range].size, fl, sl);
+
+    const uint32_t prev = ranges[range].prevFree;
+    const uint32_t next = ranges[range].nextFree;
+    if (prev != INVALID_RANGE) {
+        ranges[prev].nextFree = next;
+    } else {
+        heads[fl][sl] = next;
+    }
+    if (next != INVALID_RANGE) {
+        ranges[next].prevFree = prev;
+    }
+
+    if (heads[fl][sl] == INVALID_RANGE) {
+        slBitmaps[fl] &= ~(1u << sl);
+        if (slBitmaps[fl] == 0) {
+            flBitmap &= ~(uint64_t(1) << fl);
+        }
+    }
+    ranges[range].free = false;
+    freeRangeCount--;
+}
+
+void TlsfAllocator::splitBefore(uint32_t range, uint64_t length) {
+    const uint32_t before = createRange(ranges[range].offset, length);
+    ranges[before].prevPhysical = ranges[range].prevPhysical;
+    ranges[before].nextPhysical = range;
+    if (ranges[range].prevPhysical != INVALID_RANGE) {
+        ranges[ranges[range].prevPhysical].nextPhysical = before;
+    }
+    ranges[range].prevPhysical = before;
+    ranges[range].offset += length;
+    ranges[range].size -= length;
+    insertFree(before);
+}
+
+void TlsfAllocator::splitAfter(uint32_t range, uint64_t length) {
+    const uint32_t after = createRange(ranges[range].offset + length, ranges[range].size - length);
+    ranges[after].prevPhysical = range;
+    ranges[after].nextPhysical = ranges[range].nextPhysical;
+    if (ranges[range].nextPhysical != INVALID_RANGE) {
+        ranges[ranges[range].nextPhysical].prevPhysical = after;
+    }
+    ranges[range].nextPhysical = after;
+    ranges[range].size = length;
+    insertFree(after);
+}
+
+} // namespace voxceleron
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+namespace voxceleron {
+
+// Two-level segregated fit allocator over the offset range [0, size). It only hands out
+// offsets, so it can manage memory the CPU never touches. Allocation and free are O(1):
+// free ranges are binned by size class and neighbours are coalesced on free.
+class TlsfAllocator {
+public:
+    static constexpr uint32_t INVALID_RANGE = UINT32_MAX;
+
+    explicit TlsfAllocator(uint64_t size);
+
+    // Returns the range handle to pass to free(), INVALID_RANGE when no free range fits.
+    // alignment must be a power of two.
+    uint32_t allocate(uint64_t size, uint64_t alignment, uint64_t& offset);
+    void free(uint32_t range);
+
+    uint64_t getSize() const { return size; }
+    uint64_t getUsedSize() const { return usedSize; }  // Excludes alignment padding
+    uint32_t getAllocationCount() const { return allocationCount; }
+    uint32_t getFreeRangeCount() const { return freeRangeCount; }
+    uint64_t getLargestFreeRange() const;
+    bool isEmpty() const { return allocationCount == 0; }
+
+private:
+    // 32 linear subdivisions per power of two, sizes below 32 map one to one
+    static constexpr uint32_t SL_BITS = 5;
+    static constexpr uint32_t SL_COUNT = 1u << SL_BITS;
+    static constexpr uint32_t FL_COUNT = 64 - SL_BITS + 1;
+
+    struct Range {
+        uint64_t offset;
+        uint64_t size;
+        uint32_t prevPhysical;  // Neighbours by offset
+        uint32_t nextPhysical;
+        uint32_t prevFree;      // Neighbours in the size class list, free ranges only
+        uint32_t nextFree;
+        bool free;
+    };
+
+    uint64_t size;
+    uint64_t usedSize;
+    uint32_t allocationCount;
+    uint32_t freeRangeCount;
+
+    std::vector<Range> ranges;
+    std::vector<uint32_t> unusedRanges;  // Recycled slots in ranges
+
+    uint64_t flBitmap;                   // Bit fl set when any list of that class is non-empty
+    uint32_t slBitmaps[FL_COUNT];
+    uint32_t heads[FL_COUNT][SL_COUNT];
+
+    static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl);
+    bool findFreeRange(uint64_t size, uint32_t& fl, uint32_t& sl) const;
+    uint32_t createRange(uint64_t offset, uint64_t size);
+    void releaseRange(uint32_t range);
+    void insertFree(uint32_t range);
+    void removeFree(uint32_t range);
+    void splitBefore(uint32_t range, uint64_t length);      // Frees the first length bytes of range
+    void splitAfter(uint32_t range, uint64_t length);       // Frees everything past length bytes
+};
+
+} // namespace voxceleron
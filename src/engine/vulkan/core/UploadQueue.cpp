@@ -0,0 +1,240 @@
+#include "UploadQueue.h"
+#include "VulkanContext.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace voxceleron {
+
+UploadQueue::UploadQueue(VulkanContext* context, VkQueue queue, uint32_t queueFamily, VkDeviceSize ringSize)
+    : context(context)
+    , device(context->getDevice())
+    , queue(queue)
+    , queueFamily(queueFamily)
+    , regionSize((ringSize / REGION_COUNT) & ~(COPY_ALIGNMENT - 1))
+    , stagingBuffer(VK_NULL_HANDLE)
+    , commandPool(VK_NULL_HANDLE)
+    , currentRegion(0)
+    , regionOffset(0)
+    , nextSerial(1)
+    , completedSerial(0) {
+}
+
+UploadQueue::~UploadQueue() {
+    cleanup();
+}
+
+bool UploadQueue::initialize() {
+    if (!context->createBuffer(regionSize * REGION_COUNT, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
+            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+            stagingBuffer, stagingAllocation)) {
+        std::cerr << "UploadQueue: Failed to create staging ring" << std::endl;
+        return false;
+    }
+
+    // Each region's command buffer is reset and re-recorded every time the region comes around
+    VkCommandPoolCreateInfo poolInfo{};
+    poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+    poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+    poolInfo.queueFamilyIndex = queueFamily;
+    if (vkCreateCommandPool(device, &poolInfo, nullptr, &commandPool) != VK_SUCCESS) {
+        std::cerr << "UploadQueue: Failed to create command pool" << std::endl;
+        cleanup();
+        return false;
+    }
+
+    for (Region& region : regions) {
+        VkCommandBufferAllocateInfo allocInfo{};
+        allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        allocInfo.commandPool = commandPool;
+        allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        allocInfo.commandBufferCount = 1;
+
+        VkFenceCreateInfo fenceInfo{};
+        fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+
+        if (vkAllocateCommandBuffers(device, &allocInfo, &region.commandBuffer) != VK_SUCCESS ||
+            vkCreateFence(device, &fenceInfo, nullptr, &region.fence) != VK_SUCCESS) {
+            std::cerr << "UploadQueue: Failed to create region command buffer" << std::endl;
+            cleanup();
+            return false;
+        }
+    }
+
+    std::cout << "UploadQueue: " << REGION_COUNT << " staging regions of "
+              << regionSize / (1024 * 1024) << " MB" << std::endl;
+    return true;
+}
+
+void UploadQueue::cleanup() {
+    if (device == VK_NULL_HANDLE) return;
+    waitIdle();
+
+    for (Region& region : regions) {
+        if (region.fence != VK_NULL_HANDLE) {
+            vkDestroyFence(device, region.fence, nullptr);
+        }
+        region = Region{};
+    }
+
+    // Frees the region command buffers with it
+    if (commandPool != VK_NULL_HANDLE) {
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        commandPool = VK_NULL_HANDLE;
+    }
+
+    context->destroyBuffer(stagingBuffer, stagingAllocation);
+    pendingCopies.clear();
+    regionOffset = 0;
+}
+
+void* UploadQueue::reserve(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size) {
+    VkDeviceSize stagingOffset;
+    void* data = allocate(size, stagingOffset);
+    if (data) {
+        pendingCopies.push_back({stagingBuffer, dst, VkBufferCopy{stagingOffset, dstOffset, size}});
+    }
+    return data;
+}
+
+bool UploadQueue::upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size) {
+    void* staged = reserve(dst, dstOffset, size);
+    if (!staged) return false;
+    std::memcpy(staged, data, size);
+    return true;
+}
+
+void UploadQueue::copy(VkBuffer src, VkDeviceSize srcOffset, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size) {
+    if (size == 0) return;
+    pendingCopies.push_back({src, dst, VkBufferCopy{srcOffset, dstOffset, size}});
+}
+
+uint64_t UploadQueue::flush() {
+    if (pendingCopies.empty() && regionOffset == 0) {
+        return nextSerial - 1;
+    }
+
+    const uint64_t serial = nextSerial;
+    if (!submitRegion()) {
+        return nextSerial - 1;
+    }
+    beginRegion((currentRegion + 1) % REGION_COUNT);
+    return serial;
+}
+
+bool UploadQueue::isComplete(uint64_t serial) {
+    if (serial <= completedSerial) return true;
+
+    // Batches finish in submission order on the one queue, the newest signaled fence wins
+    for (const Region& region : regions) {
+        if (region.serial > completedSerial && vkGetFenceStatus(device, region.fence) == VK_SUCCESS) {
+            completedSerial = std::max(completedSerial, region.serial);
+        }
+    }
+    return serial <= completedSerial;
+}
+
+void UploadQueue::waitIdle() {
+    for (const Region& region : regions) {
+        if (region.serial > completedSerial) {
+            vkWaitForFences(device, 1, &region.fence, VK_TRUE, UINT64_MAX);
+        }
+    }
+    completedSerial = nextSerial - 1;
+}
+
+void* UploadQueue::allocate(VkDeviceSize size, VkDeviceSize& stagingOffset) {
+    if (stagingBuffer == VK_NULL_HANDLE || size == 0) return nullptr;
+    if (size > regionSize) {
+        std::cerr << "UploadQueue: Upload of " << size << " bytes exceeds the "
+                  << regionSize << " byte staging region" << std::endl;
+        return nullptr;
+    }
+
+    // A full region goes out early, the next one is free once its last batch finished
+    VkDeviceSize offset = (regionOffset + COPY_ALIGNMENT - 1) & ~(COPY_ALIGNMENT - 1);
+    if (offset + size > regionSize) {
+        stats.earlyFlushes++;
+        if (!submitRegion()) return nullptr;
+        beginRegion((currentRegion + 1) % REGION_COUNT);
+        offset = 0;
+    }
+
+    regionOffset = offset + size;
+    stagingOffset = VkDeviceSize(currentRegion) * regionSize + offset;
+    stats.bytes += size;
+    return static_cast<char*>(stagingAllocation.mapped) + stagingOffset;
+}
+
+bool UploadQueue::submitRegion() {
+    Region& region = regions[currentRegion];
+
+    VkCommandBufferBeginInfo beginInfo{};
+    beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+    beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+    vkBeginCommandBuffer(region.commandBuffer, &beginInfo);
+
+    // One copy command per source and destination pair, meshes mostly share a few arena pages
+    std::stable_sort(pendingCopies.begin(), pendingCopies.end(),
+        [](const PendingCopy& a, const PendingCopy& b) {
+            return a.src != b.src ? a.src < b.src : a.dst < b.dst;
+        });
+    std::vector<VkBufferCopy> copyRegions;
+    copyRegions.reserve(pendingCopies.size());
+    for (size_t first = 0; first < pendingCopies.size();) {
+        size_t last = first;
+        copyRegions.clear();
+        while (last < pendingCopies.size() && pendingCopies[last].src == pendingCopies[first].src &&
+               pendingCopies[last].dst == pendingCopies[first].dst) {
+            copyRegions.push_back(pendingCopies[last++].region);
+        }
+        vkCmdCopyBuffer(region.commandBuffer, pendingCopies[first].src, pendingCopies[first].dst,
+                        static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
+        first = last;
+    }
+
+    // Later transfers, dispatches and draws see the uploaded data. Arena pages are read as
+    // vertex and index buffers, and by quad.vert as storage buffers.
+    VkMemoryBarrier barrier{};
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT | VK_ACCESS_SHADER_READ_BIT |
+                            VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+    vkCmdPipelineBarrier(region.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                         VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT |
+                         VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT,
+                         0, 1, &barrier, 0, nullptr, 0, nullptr);
+    vkEndCommandBuffer(region.commandBuffer);
+
+    VkSubmitInfo submitInfo{};
+    submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+    submitInfo.commandBufferCount = 1;
+    submitInfo.pCommandBuffers = &region.commandBuffer;
+
+    vkResetFences(device, 1, &region.fence);
+    if (vkQueueSubmit(queue, 1, &submitInfo, region.fence) != VK_SUCCESS) {
+        std::cerr << "UploadQueue: Failed to submit upload batch" << std::endl;
+        vkResetCommandBuffer(region.commandBuffer, 0);
+        return false;
+    }
+
+    stats.batches++;
+    stats.copies += pendingCopies.size();
+    region.serial = nextSerial++;
+    pendingCopies.clear();
+    return true;
+}
+
+void UploadQueue::beginRegion(uint32_t index) {
+    // Usually long done, the region was last submitted REGION_COUNT flushes ago
+    Region& region = regions[index];
+    if (region.serial > completedSerial) {
+        vkWaitForFences(device, 1, &region.fence, VK_TRUE, UINT64_MAX);
+        completedSerial = region.serial;
+    }
+    vkResetCommandBuffer(region.commandBuffer, 0);
+    currentRegion = index;
+    regionOffset = 0;
+}
+
+} // namespace voxceleron
@@ -0,0 +1,94 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <vulkan/vulkan.h>
+#include "MemoryAllocator.h"
+
+namespace voxceleron {
+
+class VulkanContext;
+
+// Host-to-device uploads through one persistently mapped staging ring. The ring is split
+// into a region per frame in flight. Everything staged during a frame is copied by a single
+// command buffer when the frame is flushed, and a region is only written again once the
+// fence of the batch that last read it has signaled.
+class UploadQueue {
+public:
+    static constexpr VkDeviceSize DEFAULT_RING_SIZE = VkDeviceSize(64) << 20;
+    static constexpr uint32_t REGION_COUNT = 2;  // Frames the renderer keeps in flight
+    static constexpr VkDeviceSize COPY_ALIGNMENT = 16;
+
+    struct Stats {
+        uint64_t batches = 0;      // Command buffers submitted
+        uint64_t copies = 0;       // Copy regions recorded
+        VkDeviceSize bytes = 0;    // Bytes staged
+        uint64_t earlyFlushes = 0; // Batches submitted because a region filled up mid-frame
+    };
+
+    UploadQueue(VulkanContext* context, VkQueue queue, uint32_t queueFamily,
+                VkDeviceSize ringSize = DEFAULT_RING_SIZE);
+    ~UploadQueue();
+
+    bool initialize();
+    void cleanup();  // Waits for batches still in flight
+
+    // Reserves size bytes of staging memory that are copied to dst at dstOffset when the
+    // batch is flushed. Returns the mapped memory to write the data into, or nullptr when
+    // size exceeds a region.
+    void* reserve(VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size);
+    bool upload(VkBuffer dst, VkDeviceSize dstOffset, const void* data, VkDeviceSize size);
+
+    // Device-to-device copy recorded into the same batch, src must not be rewritten before
+    // the batch has finished
+    void copy(VkBuffer src, VkDeviceSize srcOffset, VkBuffer dst, VkDeviceSize dstOffset, VkDeviceSize size);
+
+    // Submits the copies staged since the last flush and moves on to the next region.
+    // Returns the serial of the submitted batch, or the last one if nothing was staged.
+    uint64_t flush();
+    // Serial the copies staged right now will be submitted with
+    uint64_t getRecordingSerial() const { return nextSerial; }
+    // True once every batch up to serial has finished on the device
+    bool isComplete(uint64_t serial);
+    void waitIdle();
+
+    const Stats& getStats() const { return stats; }
+
+private:
+    struct PendingCopy {
+        VkBuffer src;
+        VkBuffer dst;
+        VkBufferCopy region;
+    };
+
+    struct Region {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkFence fence = VK_NULL_HANDLE;
+        uint64_t serial = 0;  // Batch last submitted from this region, 0 if none
+    };
+
+    VulkanContext* context;
+    VkDevice device;
+    VkQueue queue;
+    uint32_t queueFamily;
+    VkDeviceSize regionSize;
+
+    VkBuffer stagingBuffer;
+    MemoryAllocation stagingAllocation;
+    VkCommandPool commandPool;
+    std::array<Region, REGION_COUNT> regions;
+
+    uint32_t currentRegion;
+    VkDeviceSize regionOffset;  // Bytes used in the current region
+    uint64_t nextSerial;
+    uint64_t completedSerial;
+    std::vector<PendingCopy> pendingCopies;
+    Stats stats;
+
+    void* allocate(VkDeviceSize size, VkDeviceSize& stagingOffset);
+    bool submitRegion();
+    void beginRegion(uint32_t region);
+};
+
+} // namespace voxceleron
@@ -4,12 +4,11 @@
 
 namespace voxceleron {
 
-VulkanBuffer::VulkanBuffer(VulkanDevice* device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
+VulkanBuffer::VulkanBuffer(VulkanDevice* device, MemoryAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties)
     : device(device)
+    , allocator(allocator)
     , buffer(VK_NULL_HANDLE)
-    , memory(VK_NULL_HANDLE)
-    , size(size)
-    , mappedData(nullptr) {
+    , size(size) {
     createBuffer(size, usage, properties);
 }
 
@@ -17,9 +16,7 @@ VulkanBuffer::~VulkanBuffer() {
     if (buffer != VK_NULL_HANDLE) {
         vkDestroyBuffer(device->getDevice(), buffer, nullptr);
     }
-    if (memory != VK_NULL_HANDLE) {
-        vkFreeMemory(device->getDevice(), memory, nullptr);
-    }
+    allocator->free(allocation);
 }
 
 void VulkanBuffer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties) {
@@ -36,48 +33,38 @@ void VulkanBuffer::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkM
     VkMemoryRequirements memRequirements;
     vkGetBufferMemoryRequirements(device->getDevice(), buffer, &memRequirements);
 
-    VkMemoryAllocateInfo allocInfo{};
-    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-    allocInfo.allocationSize = memRequirements.size;
-    allocInfo.memoryTypeIndex = device->findMemoryType(memRequirements.memoryTypeBits, properties);
-
-    if (vkAllocateMemory(device->getDevice(), &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+    if (!allocator->allocate(memRequirements, properties, allocation)) {
         vkDestroyBuffer(device->getDevice(), buffer, nullptr);
         throw std::runtime_error("Failed to allocate buffer memory");
     }
 
-    vkBindBufferMemory(device->getDevice(), buffer, memory, 0);
+    vkBindBufferMemory(device->getDevice(), buffer, allocation.memory, allocation.offset);
 }
 
 void* VulkanBuffer::map() {
-    if (!mappedData) {
-        vkMapMemory(device->getDevice(), memory, 0, size, 0, &mappedData);
-    }
-    return mappedData;
+    return allocation.mapped;
 }
 
 void VulkanBuffer::unmap() {
-    if (mappedData) {
-        vkUnmapMemory(device->getDevice(), memory);
-        mappedData = nullptr;
-    }
+    // Mapped for the allocation's lifetime, shared with other buffers in the same block
 }
 
 void VulkanBuffer::flush() {
+    // The allocator aligns non-coherent ranges to nonCoherentAtomSize
     VkMappedMemoryRange mappedRange{};
     mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = memory;
-    mappedRange.offset = 0;
-    mappedRange.size = size;
+    mappedRange.memory = allocation.memory;
+    mappedRange.offset = allocation.offset;
+    mappedRange.size = allocation.size;
     vkFlushMappedMemoryRanges(device->getDevice(), 1, &mappedRange);
 }
 
 void VulkanBuffer::invalidate() {
     VkMappedMemoryRange mappedRange{};
     mappedRange.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
-    mappedRange.memory = memory;
-    mappedRange.offset = 0;
-    mappedRange.size = size;
+    mappedRange.memory = allocation.memory;
+    mappedRange.offset = allocation.offset;
+    mappedRange.size = allocation.size;
     vkInvalidateMappedMemoryRanges(device->getDevice(), 1, &mappedRange);
 }
 
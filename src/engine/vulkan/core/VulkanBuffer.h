@@ -2,18 +2,21 @@
 
 #include <vulkan/vulkan.h>
 #include "VulkanDevice.h"
+#include "MemoryAllocator.h"
 
 namespace voxceleron {
 
 class VulkanBuffer {
 public:
-    VulkanBuffer(VulkanDevice* device, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
+    VulkanBuffer(VulkanDevice* device, MemoryAllocator* allocator, VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
     ~VulkanBuffer();
 
     VkBuffer getBuffer() const { return buffer; }
-    VkDeviceMemory getMemory() const { return memory; }
+    VkDeviceMemory getMemory() const { return allocation.memory; }
+    VkDeviceSize getOffset() const { return allocation.offset; }  // Of the buffer within getMemory()
     VkDeviceSize getSize() const { return size; }
 
+    // Host-visible memory stays mapped, map() returns the same pointer every time
     void* map();
     void unmap();
     void flush();
@@ -21,10 +24,10 @@ public:
 
 private:
     VulkanDevice* device;
+    MemoryAllocator* allocator;
     VkBuffer buffer;
-    VkDeviceMemory memory;
+    MemoryAllocation allocation;
     VkDeviceSize size;
-    void* mappedData;
 
     void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties);
 };
@@ -1,5 +1,8 @@
 #include "VulkanContext.h"
+#include "VulkanMemoryBackend.h"
 #include "../../core/Window.h"
+#include <algorithm>
+#include <cstring>
 #include <iostream>
 #include <set>
 
@@ -63,6 +66,12 @@ bool VulkanContext::initialize(Window* window) {
     }
     std::cout << "VulkanContext: Created command pool" << std::endl;
 
+    if (!createMemoryAllocator()) {
+        std::cerr << "VulkanContext: Failed to create memory allocator!" << std::endl;
+        return false;
+    }
+    std::cout << "VulkanContext: Created memory allocator" << std::endl;
+
     std::cout << "VulkanContext: Initialization complete" << std::endl;
     return true;
 }
@@ -77,6 +86,14 @@ void VulkanContext::cleanup() {
             commandPool = VK_NULL_HANDLE;
         }
 
+        // Every buffer is gone by now, the allocator frees its blocks
+        if (memoryAllocator) {
+            const MemoryStats stats = memoryAllocator->getStats();
+            std::cout << "VulkanContext: Releasing " << stats.blockCount << " memory blocks ("
+                      << stats.blockBytes / (1024 * 1024) << " MB)" << std::endl;
+            memoryAllocator.reset();
+        }
+
         // Destroy device
         vkDestroyDevice(device, nullptr);
         device = VK_NULL_HANDLE;
@@ -297,6 +314,25 @@ bool VulkanContext::createLogicalDevice() {
 
     // Device features
     VkPhysicalDeviceFeatures deviceFeatures{};
+    std::vector<const char*> enabledExtensions = deviceExtensions;
+
+    // GPU-driven culling draws many indirect commands per call, each selecting its draw
+    // record through firstInstance. Enabled together or not at all.
+    VkPhysicalDeviceFeatures supportedFeatures;
+    vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+    uint32_t extensionCount = 0;
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, nullptr);
+    std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+    vkEnumerateDeviceExtensionProperties(physicalDevice, nullptr, &extensionCount, availableExtensions.data());
+    const bool hasDrawIndirectCount = std::any_of(availableExtensions.begin(), availableExtensions.end(),
+        [](const VkExtensionProperties& extension) {
+            return std::strcmp(extension.extensionName, VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME) == 0;
+        });
+    if (hasDrawIndirectCount && supportedFeatures.multiDrawIndirect && supportedFeatures.drawIndirectFirstInstance) {
+        deviceFeatures.multiDrawIndirect = VK_TRUE;
+        deviceFeatures.drawIndirectFirstInstance = VK_TRUE;
+        enabledExtensions.push_back(VK_KHR_DRAW_INDIRECT_COUNT_EXTENSION_NAME);
+    }
 
     // Create info
     VkDeviceCreateInfo createInfo{};
@@ -306,10 +342,10 @@ bool VulkanContext::createLogicalDevice() {
     createInfo.pEnabledFeatures = &deviceFeatures;
 
     // Enable device extensions
-    createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
-    createInfo.ppEnabledExtensionNames = deviceExtensions.data();
+    createInfo.enabledExtensionCount = static_cast<uint32_t>(enabledExtensions.size());
+    createInfo.ppEnabledExtensionNames = enabledExtensions.data();
     std::cout << "Vulkan: Enabling device extensions:" << std::endl;
-    for (const auto& extension : deviceExtensions) {
+    for (const auto& extension : enabledExtensions) {
         std::cout << "  - " << extension << std::endl;
     }
 
@@ -450,4 +486,58 @@ uint32_t VulkanContext::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlag
     throw std::runtime_error("VulkanContext: Failed to find suitable memory type!");
 }
 
-} // namespace voxceleron 
\ No newline at end of file
+bool VulkanContext::createMemoryAllocator() {
+    VkPhysicalDeviceMemoryProperties memProperties;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+    VkPhysicalDeviceProperties deviceProperties;
+    vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+
+    memoryAllocator = std::make_unique<MemoryAllocator>(std::make_unique<VulkanMemoryBackend>(device), memProperties,
+                                                        deviceProperties.limits.nonCoherentAtomSize);
+    return true;
+}
+
+bool VulkanContext::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                                 VkBuffer& buffer, MemoryAllocation& allocation) {
+    VkBufferCreateInfo bufferInfo{};
+    bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+    bufferInfo.size = size;
+    bufferInfo.usage = usage;
+    bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+
+    if (vkCreateBuffer(device, &bufferInfo, nullptr, &buffer) != VK_SUCCESS) {
+        std::cerr << "VulkanContext: Failed to create buffer" << std::endl;
+        buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    VkMemoryRequirements memRequirements;
+    vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+
+    if (!memoryAllocator->allocate(memRequirements, properties, allocation)) {
+        std::cerr << "VulkanContext: Failed to allocate " << memRequirements.size << " bytes of buffer memory" << std::endl;
+        vkDestroyBuffer(device, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+        return false;
+    }
+
+    if (vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset) != VK_SUCCESS) {
+        std::cerr << "VulkanContext: Failed to bind buffer memory" << std::endl;
+        destroyBuffer(buffer, allocation);
+        return false;
+    }
+
+    return true;
+}
+
+void VulkanContext::destroyBuffer(VkBuffer& buffer, MemoryAllocation& allocation) {
+    if (buffer != VK_NULL_HANDLE) {
+        vkDestroyBuffer(device, buffer, nullptr);
+        buffer = VK_NULL_HANDLE;
+    }
+    if (memoryAllocator) {
+        memoryAllocator->free(allocation);
+    }
+}
+
+} // namespace voxceleron
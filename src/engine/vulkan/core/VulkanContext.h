@@ -2,8 +2,10 @@
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
+#include <memory>
 #include <vector>
 #include <optional>
+#include "MemoryAllocator.h"
 
 namespace voxceleron {
 
@@ -33,8 +35,12 @@ public:
     VkCommandBuffer beginSingleTimeCommands();
     bool endSingleTimeCommands(VkCommandBuffer commandBuffer);
 
-    // Memory management
+    // Memory management, every buffer's memory comes from the allocator
     uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+    MemoryAllocator* getMemoryAllocator() const { return memoryAllocator.get(); }
+    bool createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
+                      VkBuffer& buffer, MemoryAllocation& allocation);
+    void destroyBuffer(VkBuffer& buffer, MemoryAllocation& allocation);
 
     // Getters
     VkInstance getInstance() const { return instance; }
@@ -66,6 +72,9 @@ private:
     // Command pool
     VkCommandPool commandPool;
 
+    // Device memory, released before the device
+    std::unique_ptr<MemoryAllocator> memoryAllocator;
+
     // Helper functions
     bool createInstance();
     bool setupDebugMessenger();
@@ -73,6 +82,7 @@ private:
     bool createLogicalDevice();
     bool createSurface(Window* window);
     bool createCommandPool();
+    bool createMemoryAllocator();
     
     // Validation layers
     const std::vector<const char*> validationLayers = {
@@ -0,0 +1,40 @@
+#include "VulkanMemoryBackend.h"
+#include <iostream>
+
+namespace voxceleron {
+
+VulkanMemoryBackend::VulkanMemoryBackend(VkDevice device)
+    : device(device) {
+}
+
+bool VulkanMemoryBackend::allocate(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory& memory) {
+    VkMemoryAllocateInfo allocInfo{};
+    allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    allocInfo.allocationSize = size;
+    allocInfo.memoryTypeIndex = memoryType;
+
+    if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS) {
+        std::cerr << "VulkanMemoryBackend: Failed to allocate " << size << " bytes of memory type " << memoryType << std::endl;
+        memory = VK_NULL_HANDLE;
+        return false;
+    }
+    return true;
+}
+
+void VulkanMemoryBackend::free(VkDeviceMemory memory) {
+    vkFreeMemory(device, memory, nullptr);
+}
+
+void* VulkanMemoryBackend::map(VkDeviceMemory memory) {
+    void* data = nullptr;
+    if (vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &data) != VK_SUCCESS) {
+        return nullptr;
+    }
+    return data;
+}
+
+void VulkanMemoryBackend::unmap(VkDeviceMemory memory) {
+    vkUnmapMemory(device, memory);
+}
+
+} // namespace voxceleron
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include "MemoryAllocator.h"
+
+namespace voxceleron {
+
+// MemoryBackend on a real device
+class VulkanMemoryBackend : public MemoryBackend {
+public:
+    explicit VulkanMemoryBackend(VkDevice device);
+
+    bool allocate(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory& memory) override;
+    void free(VkDeviceMemory memory) override;
+    void* map(VkDeviceMemory memory) override;
+    void unmap(VkDeviceMemory memory) override;
+
+private:
+    VkDevice device;
+};
+
+} // namespace voxceleron
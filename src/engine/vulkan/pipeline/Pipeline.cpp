@@ -55,42 +55,20 @@ bool Pipeline::initialize() {
 bool Pipeline::createUniformBuffers() {
     VkDeviceSize bufferSize = sizeof(UniformBufferObject);
 
-    uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-    uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+    uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT, VK_NULL_HANDLE);
+    uniformBuffersAllocation.resize(MAX_FRAMES_IN_FLIGHT);
+    uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT, nullptr);
 
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-        VkBufferCreateInfo bufferInfo{};
-        bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
-        bufferInfo.size = bufferSize;
-        bufferInfo.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-        bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
-
-        if (vkCreateBuffer(context->getDevice(), &bufferInfo, nullptr, &uniformBuffers[i]) != VK_SUCCESS) {
+        if (!context->createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
+                VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+                uniformBuffers[i], uniformBuffersAllocation[i])) {
             setError("Failed to create uniform buffer");
             return false;
         }
 
-        VkMemoryRequirements memRequirements;
-        vkGetBufferMemoryRequirements(context->getDevice(), uniformBuffers[i], &memRequirements);
-
-        VkMemoryAllocateInfo allocInfo{};
-        allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = context->findMemoryType(
-            memRequirements.memoryTypeBits,
-            VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT
-        );
-
-        if (vkAllocateMemory(context->getDevice(), &allocInfo, nullptr, &uniformBuffersMemory[i]) != VK_SUCCESS) {
-            setError("Failed to allocate uniform buffer memory");
-            return false;
-        }
-
-        vkBindBufferMemory(context->getDevice(), uniformBuffers[i], uniformBuffersMemory[i], 0);
-
-        // Map the memory persistently
-        vkMapMemory(context->getDevice(), uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+        // Host-visible allocations are persistently mapped
+        uniformBuffersMapped[i] = uniformBuffersAllocation[i].mapped;
     }
 
     return true;
@@ -123,18 +101,10 @@ void Pipeline::cleanup() {
 
     // Clean up uniform buffers
     for (size_t i = 0; i < uniformBuffers.size(); i++) {
-        if (uniformBuffersMapped[i]) {
-            vkUnmapMemory(context->getDevice(), uniformBuffersMemory[i]);
-        }
-        if (uniformBuffers[i] != VK_NULL_HANDLE) {
-            vkDestroyBuffer(context->getDevice(), uniformBuffers[i], nullptr);
-        }
-        if (uniformBuffersMemory[i] != VK_NULL_HANDLE) {
-            vkFreeMemory(context->getDevice(), uniformBuffersMemory[i], nullptr);
-        }
+        context->destroyBuffer(uniformBuffers[i], uniformBuffersAllocation[i]);
     }
     uniformBuffers.clear();
-    uniformBuffersMemory.clear();
+    uniformBuffersAllocation.clear();
     uniformBuffersMapped.clear();
 
     // Clean up descriptor resources
@@ -148,15 +118,7 @@ void Pipeline::cleanup() {
         descriptorSetLayout = VK_NULL_HANDLE;
     }
 
-    if (vertexBuffer != VK_NULL_HANDLE) {
-        vkDestroyBuffer(context->getDevice(), vertexBuffer, nullptr);
-        vertexBuffer = VK_NULL_HANDLE;
-    }
-
-    if (vertexBufferMemory != VK_NULL_HANDLE) {
-        vkFreeMemory(context->getDevice(), vertexBufferMemory, nullptr);
-        vertexBufferMemory = VK_NULL_HANDLE;
-    }
+    context->destroyBuffer(vertexBuffer, vertexBufferAllocation);
 
     // Clean up synchronization objects
     for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
@@ -257,6 +219,11 @@ bool Pipeline::beginFrame() {
         return false;
     }
 
+    // Compute work can be recorded until the render pass begins
+    return true;
+}
+
+void Pipeline::beginRenderPass(VkSubpassContents contents) {
     // Begin render pass
     VkRenderPassBeginInfo renderPassInfo{};
     renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -270,20 +237,24 @@ bool Pipeline::beginFrame() {
     renderPassInfo.clearValueCount = 1;
     renderPassInfo.pClearValues = &clearColor;
 
-    vkCmdBeginRenderPass(commandBuffers[currentFrame], &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
-
-    // Bind the graphics pipeline
-    vkCmdBindPipeline(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+    vkCmdBeginRenderPass(commandBuffers[currentFrame], &renderPassInfo, contents);
 
     // Update and bind uniform buffer
     updateUniformBuffer(currentFrame);
 
+    // Secondary command buffers bind their own state, the primary may only execute them
+    if (contents != VK_SUBPASS_CONTENTS_INLINE) {
+        return;
+    }
+
+    // Bind the graphics pipeline
+    vkCmdBindPipeline(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+
     // Bind descriptor set
     vkCmdBindDescriptorSets(commandBuffers[currentFrame], VK_PIPELINE_BIND_POINT_GRAPHICS,
         pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
 
     // The actual mesh rendering commands will be recorded by WorldRenderer
-    return true;
 }
 
 void Pipeline::updateUniformBuffer(uint32_t currentImage) {
@@ -32,7 +32,10 @@ public:
     void cleanup();
 
     // Frame management
-    bool beginFrame();
+    bool beginFrame();        // Begins the command buffer, outside any render pass
+    // Begins the frame's render pass, call after beginFrame. With secondary command buffer
+    // contents the primary may only execute them until endFrame.
+    void beginRenderPass(VkSubpassContents contents = VK_SUBPASS_CONTENTS_INLINE);
     bool endFrame();
     bool recreateIfNeeded();
     void waitIdle();
@@ -40,6 +43,9 @@ public:
     // Getters
     VkCommandBuffer getCurrentCommandBuffer() const;
     uint32_t getCurrentImageIndex() const { return currentImageIndex; }
+    uint32_t getCurrentFrameIndex() const { return currentFrame; }  // Frame in flight
+    VkRenderPass getRenderPass() const { return renderPass; }
+    VkFramebuffer getCurrentFramebuffer() const { return framebuffers[currentImageIndex]; }
     State getState() const { return state; }
     bool isValid() const { return state == State::READY; }
     const std::string& getLastErrorMessage() const { return lastErrorMessage; }
@@ -72,7 +78,7 @@ private:
 
     // Buffer resources
     VkBuffer vertexBuffer = VK_NULL_HANDLE;
-    VkDeviceMemory vertexBufferMemory = VK_NULL_HANDLE;
+    MemoryAllocation vertexBufferAllocation;
 
     // Uniform buffer for camera matrices
     struct UniformBufferObject {
@@ -80,7 +86,7 @@ private:
         alignas(16) glm::mat4 proj;
     };
     std::vector<VkBuffer> uniformBuffers;
-    std::vector<VkDeviceMemory> uniformBuffersMemory;
+    std::vector<MemoryAllocation> uniformBuffersAllocation;
     std::vector<void*> uniformBuffersMapped;
 
     // Descriptor set resources
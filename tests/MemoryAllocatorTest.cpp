@@ -0,0 +1,231 @@
+#include "engine/vulkan/core/MemoryAllocator.h"
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+using namespace voxceleron;
+
+namespace {
+
+constexpr VkDeviceSize BLOCK_SIZE = VkDeviceSize(1) << 20;
+constexpr VkDeviceSize ATOM_SIZE = 64;
+
+// Memory types of the fake device, one heap behind all of them
+constexpr uint32_t DEVICE_LOCAL_TYPE = 0;
+constexpr uint32_t HOST_COHERENT_TYPE = 1;
+constexpr uint32_t HOST_CACHED_TYPE = 2;  // Host-visible, not coherent
+
+// Host memory standing in for device memory objects. Owned by the test, so it outlives the
+// allocator and the backend the allocator deletes, and leaks show up after both are gone.
+struct FakeDevice {
+    std::unordered_map<uintptr_t, std::vector<char>> objects;
+    uintptr_t nextObject = 1;  // Zero is VK_NULL_HANDLE
+    uint32_t allocationCount = 0;
+
+    size_t getLiveCount() const { return objects.size(); }
+    void* getData(VkDeviceMemory memory) {
+        auto it = objects.find(uintptr_t(memory));
+        return it != objects.end() ? it->second.data() : nullptr;
+    }
+};
+
+// Hands out FakeDevice memory through the MemoryBackend interface
+class FakeMemoryBackend : public MemoryBackend {
+public:
+    explicit FakeMemoryBackend(FakeDevice* device) : device(device) {}
+
+    bool allocate(uint32_t memoryType, VkDeviceSize size, VkDeviceMemory& memory) override {
+        (void)memoryType;
+        device->objects[device->nextObject].resize(static_cast<size_t>(size));
+        memory = VkDeviceMemory(device->nextObject++);
+        device->allocationCount++;
+        return true;
+    }
+
+    void free(VkDeviceMemory memory) override {
+        device->objects.erase(uintptr_t(memory));
+    }
+
+    void* map(VkDeviceMemory memory) override {
+        return device->getData(memory);
+    }
+
+    void unmap(VkDeviceMemory memory) override {
+        (void)memory;
+    }
+
+private:
+    FakeDevice* device;
+};
+
+VkPhysicalDeviceMemoryProperties makeProperties() {
+    VkPhysicalDeviceMemoryProperties properties{};
+    properties.memoryHeapCount = 1;
+    properties.memoryHeaps[0].size = VkDeviceSize(1) << 30;
+    properties.memoryTypeCount = 3;
+    properties.memoryTypes[DEVICE_LOCAL_TYPE].propertyFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+    properties.memoryTypes[HOST_COHERENT_TYPE].propertyFlags =
+        VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+    properties.memoryTypes[HOST_CACHED_TYPE].propertyFlags = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    return properties;
+}
+
+VkMemoryRequirements makeRequirements(VkDeviceSize size, VkDeviceSize alignment, uint32_t memoryType) {
+    VkMemoryRequirements requirements{};
+    requirements.size = size;
+    requirements.alignment = alignment;
+    requirements.memoryTypeBits = 1u << memoryType;
+    return requirements;
+}
+
+int failures = 0;
+
+void check(bool condition, const char* test, const char* what) {
+    if (!condition) {
+        std::cerr << test << ": " << what << std::endl;
+        failures++;
+    }
+}
+
+void testSubAllocation() {
+    const char* test = "testSubAllocation";
+    FakeDevice device;
+    {
+        MemoryAllocator allocator(std::make_unique<FakeMemoryBackend>(&device), makeProperties(), ATOM_SIZE, BLOCK_SIZE);
+
+        MemoryAllocation first, second;
+        check(allocator.allocate(makeRequirements(1000, 256, DEVICE_LOCAL_TYPE), 0, first), test, "first allocation failed");
+        check(allocator.allocate(makeRequirements(3000, 256, DEVICE_LOCAL_TYPE), 0, second), test, "second allocation failed");
+
+        check(first.memory == second.memory, test, "small allocations should share a block");
+        check(first.block == second.block && first.block != MemoryAllocator::DEDICATED_BLOCK, test, "expected a shared block");
+        check(first.offset % 256 == 0 && second.offset % 256 == 0, test, "offsets ignore the required alignment");
+        check(first.offset + first.size <= second.offset || second.offset + second.size <= first.offset, test, "ranges overlap");
+        check(first.mapped == nullptr, test, "device-local memory should not be mapped");
+        check(device.allocationCount == 1, test, "expected one device memory object");
+
+        const MemoryStats stats = allocator.getStats();
+        check(stats.blockCount == 1 && stats.blockBytes == BLOCK_SIZE, test, "expected a single block");
+        check(stats.allocationCount == 2 && stats.usedBytes == 4000, test, "wrong allocation stats");
+
+        allocator.free(first);
+        allocator.free(second);
+        check(!first.isValid() && !second.isValid(), test, "free should reset the allocation");
+        check(allocator.getStats().allocationCount == 0, test, "allocations still counted after free");
+    }
+    check(device.getLiveCount() == 0, test, "memory leaked past the allocator");
+}
+
+void testDedicatedAllocation() {
+    const char* test = "testDedicatedAllocation";
+    FakeDevice device;
+    {
+        MemoryAllocator allocator(std::make_unique<FakeMemoryBackend>(&device), makeProperties(), ATOM_SIZE, BLOCK_SIZE);
+
+        MemoryAllocation large;
+        const VkDeviceSize size = BLOCK_SIZE / 2 + 1;
+        check(allocator.allocate(makeRequirements(size, 16, HOST_COHERENT_TYPE), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, large),
+              test, "allocation failed");
+        check(large.block == MemoryAllocator::DEDICATED_BLOCK, test, "more than half a block should be dedicated");
+        check(large.offset == 0 && large.size == size, test, "dedicated allocation should own its whole object");
+        check(large.mapped == device.getData(large.memory), test, "dedicated host memory should be mapped at its base");
+
+        MemoryStats stats = allocator.getStats();
+        check(stats.dedicatedCount == 1 && stats.dedicatedBytes == size, test, "wrong dedicated stats");
+        check(stats.blockCount == 1 && device.getLiveCount() == 1, test, "expected one memory object");
+
+        allocator.free(large);
+        stats = allocator.getStats();
+        check(stats.dedicatedCount == 0 && stats.blockCount == 0, test, "dedicated stats not released");
+        check(device.getLiveCount() == 0, test, "dedicated memory should be freed at once");
+    }
+}
+
+void testAtomAlignment() {
+    const char* test = "testAtomAlignment";
+    FakeDevice device;
+    {
+        MemoryAllocator allocator(std::make_unique<FakeMemoryBackend>(&device), makeProperties(), ATOM_SIZE, BLOCK_SIZE);
+
+        // Non-coherent ranges are rounded out to whole atoms so they can be flushed on their own
+        std::vector<MemoryAllocation> cached(4);
+        for (size_t i = 0; i < cached.size(); ++i) {
+            check(allocator.allocate(makeRequirements(100 + i, 4, HOST_CACHED_TYPE), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT,
+                                     cached[i]), test, "non-coherent allocation failed");
+            check(cached[i].offset % ATOM_SIZE == 0, test, "non-coherent offset not atom aligned");
+            check(cached[i].size % ATOM_SIZE == 0 && cached[i].size >= 100 + i, test, "non-coherent size not rounded to atoms");
+            check(cached[i].mapped == static_cast<char*>(device.getData(cached[i].memory)) + cached[i].offset, test,
+                  "mapped pointer does not match the offset");
+        }
+
+        // Coherent memory keeps the requested size and alignment
+        MemoryAllocation coherent;
+        check(allocator.allocate(makeRequirements(100, 4, HOST_COHERENT_TYPE), VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT, coherent),
+              test, "coherent allocation failed");
+        check(coherent.size == 100, test, "coherent size should not be rounded");
+
+        for (MemoryAllocation& allocation : cached) {
+            allocator.free(allocation);
+        }
+        allocator.free(coherent);
+        check(allocator.getStats().usedBytes == 0, test, "used bytes not released");
+    }
+    check(device.getLiveCount() == 0, test, "memory leaked past the allocator");
+}
+
+void testBlockRelease() {
+    const char* test = "testBlockRelease";
+    FakeDevice device;
+    {
+        MemoryAllocator allocator(std::make_unique<FakeMemoryBackend>(&device), makeProperties(), ATOM_SIZE, BLOCK_SIZE);
+
+        // Quarter-block allocations until the first block is full and a second one opens
+        std::vector<MemoryAllocation> allocations;
+        while (device.allocationCount < 2 && allocations.size() < 16) {
+            allocations.emplace_back();
+            check(allocator.allocate(makeRequirements(BLOCK_SIZE / 4, 256, DEVICE_LOCAL_TYPE), 0, allocations.back()),
+                  test, "allocation failed");
+        }
+        check(allocator.getStats().blockCount == 2 && device.getLiveCount() == 2, test, "expected two blocks");
+        check(allocations.front().block != allocations.back().block, test, "expected the last allocation in the second block");
+
+        // The second block empties and goes back to the device
+        const uint32_t secondBlock = allocations.back().block;
+        for (MemoryAllocation& allocation : allocations) {
+            if (allocation.block == secondBlock) {
+                allocator.free(allocation);
+            }
+        }
+        check(allocator.getStats().blockCount == 1 && device.getLiveCount() == 1, test, "empty block not released");
+
+        // The last block of a type is kept for the next allocation
+        for (MemoryAllocation& allocation : allocations) {
+            allocator.free(allocation);
+        }
+        check(allocator.getStats().blockCount == 1 && device.getLiveCount() == 1, test, "last block should be kept");
+
+        MemoryAllocation reused;
+        check(allocator.allocate(makeRequirements(1024, 256, DEVICE_LOCAL_TYPE), 0, reused), test, "allocation failed");
+        check(device.allocationCount == 2, test, "the kept block should be reused");
+        allocator.free(reused);
+    }
+    check(device.getLiveCount() == 0, test, "kept block not freed with the allocator");
+}
+
+} // namespace
+
+int main() {
+    testSubAllocation();
+    testDedicatedAllocation();
+    testAtomAlignment();
+    testBlockRelease();
+
+    if (failures > 0) {
+        std::cerr << failures << " MemoryAllocator checks failed" << std::endl;
+        return 1;
+    }
+    std::cout << "MemoryAllocator: all checks passed" << std::endl;
+    return 0;
+}